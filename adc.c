@@ -2,6 +2,7 @@
 #include "delay.h"          // Delay functions
 #include <LPC21xx.h>        // LPC21xx register definitions
 #include "adc_defines.h"    // ADC related macro definitions
+#include "adc.h"            // ADC function declarations
 
 /*----------------------------------------------------
   Array to select ADC channel pins
@@ -20,6 +21,19 @@ u32 adcChSel[4] =
     AIN3_PIN_0_30
 };
 
+/*----------------------------------------------------
+  Burst acquisition
+
+  In BURST mode the converter cycles through the
+  selected channels by itself. ADC_ISR stores every
+  result in the ring of its channel; adcCount[ch] is
+  the number of samples taken so far and also gives
+  the write position (count % ADC_RING_SIZE).
+----------------------------------------------------*/
+static volatile u16 adcRing[4][ADC_RING_SIZE];
+static volatile u32 adcCount[4];
+static u8 adcBurst = 0;
+
 /*----------------------------------------------------
   Init_ADC()
 
@@ -52,6 +66,14 @@ void Init_ADC(u32 chNo)
 ----------------------------------------------------*/
 void Read_ADC(u32 chNo, f32 *eAR, u32 *adcDVal)
 {
+    // Burst running: use the newest sample, no conversion
+    if(adcBurst)
+    {
+        *adcDVal = ADCLatest(chNo);
+        *eAR = *adcDVal * (3.3 / 1023);
+        return;
+    }
+
     // Clear channel selection bits (lower 8 bits)
     ADCR &= 0xFFFFFF00;
 
@@ -73,4 +95,145 @@ void Read_ADC(u32 chNo, f32 *eAR, u32 *adcDVal)
     // Formula: Voltage = (Digital Value  Vref) / 1023
     // Here Vref = 3.3V
     *eAR = *adcDVal * (3.3 / 1023);
+}
+
+/*----------------------------------------------------
+  ADC_ISR()
+
+  One conversion done. Reading ADDR clears DONE (and
+  the interrupt).
+----------------------------------------------------*/
+void ADC_ISR(void) __irq
+{
+    u32 dr = ADDR;
+    u32 ch = (dr >> CHN_BITS) & 7;
+
+    if(ch < 4)
+    {
+        adcRing[ch][adcCount[ch] & (ADC_RING_SIZE-1)] = (dr >> DIGITAL_DATA_BITS) & 1023;
+        adcCount[ch]++;
+    }
+
+    VICVectAddr = 0;        // End of interrupt
+}
+
+/*----------------------------------------------------
+  ADCStartBurst()
+
+  Starts continuous conversion of the channels in
+  chMask (bit n = AINn, n < 4). Returns once every
+  channel has its first sample.
+----------------------------------------------------*/
+void ADCStartBurst(u32 chMask)
+{
+    u32 ch, ready;
+
+    ADCStopBurst();
+
+    for(ch = 0; ch < 4; ch++)
+    {
+        adcCount[ch] = 0;
+        if((chMask >> ch) & 1)
+        {
+            PINSEL1 &= ~(adcChSel[ch]);
+            PINSEL1 |= adcChSel[ch];
+        }
+    }
+
+    VICIntSelect &= ~(1<<ADC_VIC_CHNO);
+    VICVectAddr3 = (u32)ADC_ISR;
+    VICVectCntl3 = (1<<5) | ADC_VIC_CHNO;
+    VICIntEnable = (1<<ADC_VIC_CHNO);
+
+    // START must be 000 in burst mode; CLKS = 000 (11 clocks, 10 bits)
+    ADCR = (chMask & 0x0F) | (ADC_BURST_CLKDIV << CLKDIV_BITS) |
+           (1 << BURST_BIT) | (1 << PDN_BIT);
+    adcBurst = 1;
+
+    do
+    {
+        delay_us(100);
+        ready = 1;
+        for(ch = 0; ch < 4; ch++)
+            if(((chMask >> ch) & 1) && adcCount[ch] == 0)
+                ready = 0;
+    } while(!ready);
+}
+
+/*----------------------------------------------------
+  ADCStopBurst()
+
+  Back to software-started conversions (Read_ADC).
+----------------------------------------------------*/
+void ADCStopBurst(void)
+{
+    if(!adcBurst)
+        return;
+
+    ADCR &= ~(1 << BURST_BIT);
+    VICIntEnClr = (1<<ADC_VIC_CHNO);
+    (void)ADDR;             // Drop a pending result
+    adcBurst = 0;
+}
+
+/*----------------------------------------------------
+  ADCLatest() / ADCSampleCount()
+
+  Newest raw result (0-1023) of a channel, and how
+  many samples it has had since ADCStartBurst().
+----------------------------------------------------*/
+u32 ADCLatest(u32 chNo)
+{
+    u32 n = adcCount[chNo];
+
+    return n ? adcRing[chNo][(n-1) & (ADC_RING_SIZE-1)] : 0;
+}
+
+u32 ADCSampleCount(u32 chNo)
+{
+    return adcCount[chNo];
+}
+
+/*----------------------------------------------------
+  ADCWindow()
+
+  Copies the newest n samples of a channel, oldest
+  first, into dst. n is limited to ADC_RING_SIZE and
+  the samples available. If the ISR laps the copy it
+  is retried. Returns the number of samples copied.
+----------------------------------------------------*/
+u32 ADCWindow(u32 chNo, u16 *dst, u32 n)
+{
+    u32 end, i;
+
+    if(n > ADC_RING_SIZE)
+        n = ADC_RING_SIZE;
+
+    do
+    {
+        end = adcCount[chNo];
+        if(n > end)
+            n = end;
+        for(i = 0; i < n; i++)
+            dst[i] = adcRing[chNo][(end - n + i) & (ADC_RING_SIZE-1)];
+    } while(adcCount[chNo] - end > ADC_RING_SIZE - n);   // Overwritten meanwhile
+
+    return n;
+}
+
+/*----------------------------------------------------
+  ADCAverage()
+
+  Mean of the newest n samples (raw counts).
+----------------------------------------------------*/
+u32 ADCAverage(u32 chNo, u32 n)
+{
+    u16 buf[ADC_RING_SIZE];
+    u32 i, sum = 0;
+
+    n = ADCWindow(chNo, buf, n);
+    for(i = 0; i < n; i++)
+        sum += buf[i];
+
+    return n ? sum / n : 0;
 }
\ No newline at end of file
@@ -1,3 +1,10 @@
 #include "types.h"
 void Init_ADC(u32);
-void Read_ADC(u32 chNo,f32 *eAR,u32 *adcDVal);
\ No newline at end of file
+void Read_ADC(u32 chNo,f32 *eAR,u32 *adcDVal);
+
+void ADCStartBurst(u32 chMask);
+void ADCStopBurst(void);
+u32 ADCLatest(u32 chNo);
+u32 ADCSampleCount(u32 chNo);
+u32 ADCWindow(u32 chNo, u16 *dst, u32 n);
+u32 ADCAverage(u32 chNo, u32 n);
\ No newline at end of file
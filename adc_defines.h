@@ -11,6 +11,16 @@
 #define DIGITAL_DATA_BITS 6
 #define DONE_BIT 31
 
+// Burst mode acquisition (see ADCStartBurst)
+#define BURST_BIT 16
+#define CHN_BITS 24            // ADDR: channel of the result
+#define ADC_BURST_CLKDIV 255   // 15 MHz / 256 = 58.6 kHz, 11 clocks per conversion
+#define ADC_BURST_CHANNELS 0x0F  // AIN0..AIN3 (adcChSel)
+#define ADC_RING_SIZE 64       // samples kept per channel (power of 2)
+
+#define ADC_VIC_CHNO 18
+#define ADC_VIC_SLOT 3
+
 #define AIN0_PIN_0_27 0x00400000
 #define AIN1_PIN_0_28 0x01000000
 #define AIN2_PIN_0_29 0x04000000
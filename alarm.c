@@ -0,0 +1,252 @@
+#include <LPC21xx.h>        // LPC21xx register definitions
+#include "types.h"          // Custom data types
+#include "timer_defines.h"  // TIMER0_VIC_CHNO
+#include "chan.h"           // ChanRead(), set points
+#include "rtc.h"            // RTCStampMs()
+#include "logbuf.h"         // RAM log
+#include "data_logger.h"    // BUZ
+#include "alarm.h"          // Alarm engine
+
+/*----------------------------------------------------
+  Alarm engine
+
+  AlarmCheck() runs from the sampler tick (Timer0
+  MR1, every 10 ms) whatever the logging period, so
+  a crossing reaches the buzzer and the log within
+  one tick of the filtered value getting there; the
+  old AlarmTask only saw the 250 ms SampleTask value.
+
+  A condition is raised at the threshold and cleared
+  hyst away from it. Raising one appends an [ALERT]
+  record (LOG_T_ALARM, flags = conditions present);
+  the last one clearing appends a clear record.
+
+    IDLE --raise--> ACTIVE --ACK--> ACKED
+                      |               |
+                 clear, latch       clear
+                      v               v
+                   LATCHED --ACK--> IDLE
+
+  A new condition raised while ACKED sounds again.
+  The buzzer is on in ACTIVE and LATCHED.
+
+  The rate of change is the difference over the last
+  ALM_RATE_WIN_S seconds, taken once a second.
+----------------------------------------------------*/
+#define ALM_TICKS_S     100     // Sampler ticks per second
+
+static alarm_cfg_t almCfg[CHAN_COUNT];
+static alarm_ch_t almCh[CHAN_COUNT];
+static s32 almHist[CHAN_COUNT][ALM_RATE_WIN_S];    // Once a second
+static u8 almHistN;                     // Valid entries
+static u8 almHistPos;
+static u8 almTick;
+static u8 almBuz;                       // Buzzer output as driven
+
+/*----------------------------------------------------
+  AlarmInit()
+
+  Low threshold off, 0.5 C (5 mV) hysteresis, no
+  rate limit, not latched. Buzzer off.
+----------------------------------------------------*/
+void AlarmInit(void)
+{
+    u8 ch;
+
+    for(ch = 0; ch < CHAN_COUNT; ch++)
+    {
+        almCfg[ch].low = ALM_LOW_OFF;
+        almCfg[ch].hyst = 5;
+        almCfg[ch].rateMax = 0;
+        almCfg[ch].latch = 0;
+        almCh[ch].state = ALM_S_IDLE;
+        almCh[ch].cond = 0;
+        almCh[ch].rate = 0;
+        almCh[ch].events = 0;
+    }
+    almHistN = almHistPos = almTick = 0;
+    almBuz = 0;
+    IOCLR0 = (1<<BUZ);
+}
+
+/*----------------------------------------------------
+  AlarmRecord()
+
+  Appends the alarm record of a channel: the value
+  and the conditions now present (0 = cleared).
+----------------------------------------------------*/
+static void AlarmRecord(u8 ch, s32 v, u8 cond)
+{
+    log_rec_t r;
+
+    r.time  = RTCStampMs(&r.ms);
+    r.value = v;
+    r.ch    = LOG_T_ALARM | ch;
+    r.flags = cond;
+    LogAppend(&r);
+}
+
+/*----------------------------------------------------
+  AlarmEval()
+
+  New conditions of one channel from its value, with
+  hysteresis on the way out.
+----------------------------------------------------*/
+static u8 AlarmEval(u8 ch, s32 v)
+{
+    const alarm_cfg_t *c = &almCfg[ch];
+    s32 sp = ChanCfg(ch)->sp, r = almCh[ch].rate;
+    u8 cond = almCh[ch].cond;
+
+    if(v >= sp)
+        cond |= ALM_HIGH;
+    else if(v < sp - c->hyst)
+        cond &= ~ALM_HIGH;
+
+    if(c->low == ALM_LOW_OFF)
+        cond &= ~ALM_LOW;
+    else if(v <= c->low)
+        cond |= ALM_LOW;
+    else if(v > c->low + c->hyst)
+        cond &= ~ALM_LOW;
+
+    if(r < 0)
+        r = -r;
+    if(!c->rateMax || almHistN < ALM_RATE_WIN_S)
+        cond &= ~ALM_RATE;
+    else if(r >= c->rateMax)
+        cond |= ALM_RATE;
+    else if(r < c->rateMax - c->hyst)
+        cond &= ~ALM_RATE;
+
+    return cond;
+}
+
+/*----------------------------------------------------
+  AlarmCheck()
+
+  Sampler tick hook (interrupt context): reads every
+  channel in use, updates the states and drives the
+  buzzer.
+----------------------------------------------------*/
+void AlarmCheck(void)
+{
+    alarm_ch_t *a;
+    u8 ch, cond, buz = 0, second;
+    s32 v;
+
+    second = (++almTick >= ALM_TICKS_S);
+    if(second)
+        almTick = 0;
+
+    for(ch = 0, a = almCh; ch < CHAN_COUNT; ch++, a++)
+    {
+        if(ChanCfg(ch)->type == CHAN_T_OFF)
+            continue;
+        v = ChanRead(ch);
+
+        if(second)
+        {
+            if(almHistN == ALM_RATE_WIN_S)  // Oldest is ALM_RATE_WIN_S s back
+                a->rate = (v - almHist[ch][almHistPos]) * 60 / ALM_RATE_WIN_S;
+            almHist[ch][almHistPos] = v;
+        }
+
+        cond = AlarmEval(ch, v);
+        if(cond & ~a->cond)             // Something new raised
+        {
+            a->state = ALM_S_ACTIVE;
+            a->events++;
+            AlarmRecord(ch, v, cond);
+        }
+        else if(!cond && a->cond)       // Last one cleared
+        {
+            if(a->state == ALM_S_ACTIVE && almCfg[ch].latch)
+                a->state = ALM_S_LATCHED;
+            else if(a->state != ALM_S_LATCHED)
+                a->state = ALM_S_IDLE;
+            AlarmRecord(ch, v, 0);
+        }
+        a->cond = cond;
+
+        if(a->state == ALM_S_ACTIVE || a->state == ALM_S_LATCHED)
+            buz = 1;
+    }
+
+    if(second)
+    {
+        if(++almHistPos == ALM_RATE_WIN_S)
+            almHistPos = 0;
+        if(almHistN < ALM_RATE_WIN_S)
+            almHistN++;
+    }
+
+    if(buz != almBuz)
+    {
+        almBuz = buz;
+        if(buz)
+            IOSET0 = (1<<BUZ);          // Turn ON buzzer (Alert)
+        else
+            IOCLR0 = (1<<BUZ);          // Turn OFF buzzer
+    }
+}
+
+/*----------------------------------------------------
+  AlarmSet() / AlarmCfg() / AlarmChannel()
+
+  AlarmSet() replaces a channel's low threshold,
+  hysteresis, rate limit and latch. Returns 0 for an
+  invalid channel or a negative hysteresis/rate.
+----------------------------------------------------*/
+u8 AlarmSet(u8 ch, const alarm_cfg_t *cfg)
+{
+    if(ch >= CHAN_COUNT || cfg->hyst < 0 || cfg->rateMax < 0)
+        return 0;
+
+    VICIntEnClr = (1<<TIMER0_VIC_CHNO);     // Tick must not see half an update
+    almCfg[ch] = *cfg;
+    VICIntEnable = (1<<TIMER0_VIC_CHNO);
+    return 1;
+}
+
+const alarm_cfg_t *AlarmCfg(u8 ch)
+{
+    return &almCfg[ch];
+}
+
+const alarm_ch_t *AlarmChannel(u8 ch)
+{
+    return &almCh[ch];
+}
+
+/*----------------------------------------------------
+  AlarmAck()
+
+  Acknowledges every channel: ACTIVE ones are
+  silenced, LATCHED ones return to IDLE. The buzzer
+  follows on the next tick.
+----------------------------------------------------*/
+void AlarmAck(void)
+{
+    u8 ch;
+
+    VICIntEnClr = (1<<TIMER0_VIC_CHNO);
+    for(ch = 0; ch < CHAN_COUNT; ch++)
+    {
+        if(almCh[ch].state == ALM_S_ACTIVE)
+            almCh[ch].state = ALM_S_ACKED;
+        else if(almCh[ch].state == ALM_S_LATCHED)
+            almCh[ch].state = ALM_S_IDLE;
+    }
+    VICIntEnable = (1<<TIMER0_VIC_CHNO);
+}
+
+/*----------------------------------------------------
+  AlarmBuzzer()
+
+  1 while the buzzer is sounding.
+----------------------------------------------------*/
+u8 AlarmBuzzer(void)
+{
+    return almBuz;
+}
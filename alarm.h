@@ -0,0 +1,56 @@
+#ifndef ALARM_H
+#define ALARM_H
+
+#include "types.h"
+#include "chan.h"
+
+/*----------------------------------------------------
+  Alarm engine
+
+  Checked on every sampler tick (10 ms) for each
+  channel in use, in the interrupt. The high threshold
+  is the channel set point (chan.c); low threshold,
+  hysteresis and rate limit are per channel here, in
+  the value units of the channel (0.1 C or mV; the
+  rate per minute).
+----------------------------------------------------*/
+
+// Conditions; also the flags of an LOG_T_ALARM record
+#define ALM_HIGH        (1<<0)  // value >= set point
+#define ALM_LOW         (1<<1)  // value <= low threshold
+#define ALM_RATE        (1<<2)  // |rate| >= rate limit
+
+// States
+#define ALM_S_IDLE      0       // no condition
+#define ALM_S_ACTIVE    1       // condition present, buzzer on
+#define ALM_S_ACKED     2       // condition present, silenced
+#define ALM_S_LATCHED   3       // condition gone, buzzer on until ACK
+
+#define ALM_LOW_OFF     (-0x7FFFFFFF - 1)   // low threshold not checked
+#define ALM_RATE_WIN_S  10      // rate-of-change window
+
+typedef struct
+{
+    s32 low;            // Low threshold, ALM_LOW_OFF = off
+    s32 hyst;           // Hysteresis on every condition
+    s32 rateMax;        // Per minute, 0 = off
+    u8  latch;          // Keep sounding after the condition clears
+} alarm_cfg_t;
+
+typedef struct
+{
+    u8  state;          // ALM_S_*
+    u8  cond;           // ALM_* present
+    s32 rate;           // Per minute, over ALM_RATE_WIN_S
+    u32 events;         // Conditions raised
+} alarm_ch_t;
+
+void AlarmInit(void);
+void AlarmCheck(void);
+u8 AlarmSet(u8 ch, const alarm_cfg_t *);
+const alarm_cfg_t *AlarmCfg(u8 ch);
+const alarm_ch_t *AlarmChannel(u8 ch);
+void AlarmAck(void);
+u8 AlarmBuzzer(void);
+
+#endif
@@ -0,0 +1,175 @@
+#include "types.h"          // Custom data types
+#include "lm35.h"           // LM35DeciFrac(), LM35SetCal()
+#include "lm35_defines.h"   // LM35_CAL_UNITY, LM35_Q
+#include "filter.h"         // FilterSet(), FilterRead()
+#include "sampler.h"        // SamplerSetPeriod()
+#include "chan.h"           // Channel table
+
+/*----------------------------------------------------
+  Default channel table
+
+  Four LM35s; AIN0 is logged once a minute, the others
+  are acquired (LCD/alarm) but not logged until given
+  a period (SET PERIOD).
+----------------------------------------------------*/
+static const chan_cfg_t chanDefault[CHAN_COUNT] =
+{
+    // name    type        filter           par  gain            off  sp   period
+    { "AIN0",  CHAN_T_LM35, FILT_OVERSAMPLE, 2,  LM35_CAL_UNITY, 0,   400, 60000 },
+    { "AIN1",  CHAN_T_LM35, FILT_OVERSAMPLE, 2,  LM35_CAL_UNITY, 0,   400, 0 },
+    { "AIN2",  CHAN_T_LM35, FILT_OVERSAMPLE, 2,  LM35_CAL_UNITY, 0,   400, 0 },
+    { "AIN3",  CHAN_T_LM35, FILT_OVERSAMPLE, 2,  LM35_CAL_UNITY, 0,   400, 0 },
+};
+
+// Set point limits per type, value units
+static const s32 spMin[] = { 0, -550, 0 };
+static const s32 spMax[] = { 0, 1500, 3300 };
+
+static chan_cfg_t chanCfg[CHAN_COUNT];
+static s32 chanLatest[CHAN_COUNT];
+
+/*----------------------------------------------------
+  ChanInit()
+
+  Loads the default table and sets up the filter and
+  calibration of every channel. Call before
+  SamplerInit(), which takes the periods from here.
+----------------------------------------------------*/
+void ChanInit(void)
+{
+    u8 ch;
+
+    for(ch = 0; ch < CHAN_COUNT; ch++)
+    {
+        chanCfg[ch] = chanDefault[ch];
+        FilterSet(ch, chanCfg[ch].filter, chanCfg[ch].filtParam);
+        LM35SetCal(ch, chanCfg[ch].gainQ16, chanCfg[ch].offset);
+        chanLatest[ch] = 0;
+    }
+}
+
+/*----------------------------------------------------
+  ChanCfg() / ChanMask()
+
+  Table entry of a channel; ADC channel mask of the
+  inputs in use (ADCStartBurst()).
+----------------------------------------------------*/
+const chan_cfg_t *ChanCfg(u8 ch)
+{
+    return &chanCfg[ch];
+}
+
+u32 ChanMask(void)
+{
+    u32 m = 0;
+    u8 ch;
+
+    for(ch = 0; ch < CHAN_COUNT; ch++)
+        if(chanCfg[ch].type != CHAN_T_OFF)
+            m |= 1 << ch;
+    return m;
+}
+
+/*----------------------------------------------------
+  ChanSetPeriod() / ChanSetSp() / ChanSetScale()
+
+  Change one field of a channel. Return 0 for an
+  unused channel or a value out of range.
+----------------------------------------------------*/
+u8 ChanSetPeriod(u8 ch, u32 periodMs)
+{
+    if(ch >= CHAN_COUNT || chanCfg[ch].type == CHAN_T_OFF ||
+       !SamplerSetPeriod(ch, periodMs))
+        return 0;
+    chanCfg[ch].periodMs = periodMs;
+    return 1;
+}
+
+u8 ChanSetSp(u8 ch, s32 sp)
+{
+    if(ch >= CHAN_COUNT || chanCfg[ch].type == CHAN_T_OFF ||
+       sp < spMin[chanCfg[ch].type] || sp > spMax[chanCfg[ch].type])
+        return 0;
+    chanCfg[ch].sp = sp;
+    return 1;
+}
+
+u8 ChanSetScale(u8 ch, s32 gainQ16, s32 offset)
+{
+    // Below 4.0 the LM35 products stay within 32 bits
+    if(ch >= CHAN_COUNT || gainQ16 <= 0 || gainQ16 >= 4 * LM35_CAL_UNITY)
+        return 0;
+    chanCfg[ch].gainQ16 = gainQ16;
+    chanCfg[ch].offset = offset;
+    LM35SetCal(ch, gainQ16, offset);
+    return 1;
+}
+
+/*----------------------------------------------------
+  ChanUnitDiv()
+
+  Value units per displayed unit: 10 for 0.1 C, 1
+  for mV. Commands and the menu take whole units.
+----------------------------------------------------*/
+u8 ChanUnitDiv(u8 ch)
+{
+    return chanCfg[ch].type == CHAN_T_LM35 ? 10 : 1;
+}
+
+/*----------------------------------------------------
+  ChanRead()
+
+  Current value of a channel from its filter, in the
+  units of its type; 0 for an unused channel. Reads
+  have no side effects on the filter (FilterTick()
+  advances it), so tasks and the sampler may both
+  call it.
+----------------------------------------------------*/
+s32 ChanRead(u8 ch)
+{
+    const chan_cfg_t *c = &chanCfg[ch];
+    u32 q4;
+
+    switch(c->type)
+    {
+        case CHAN_T_LM35:
+            return LM35DeciFrac(FilterRead(ch), FILT_FRAC_BITS, ch, 'C');
+
+        case CHAN_T_MV:
+            // Q4 counts * 3300/1023, then the channel scale
+            q4 = FilterRead(ch);
+            return (s32)(((q4 * 3300 / 1023 >> FILT_FRAC_BITS) * c->gainQ16 +
+                          (1L << (LM35_Q - 1))) >> LM35_Q) + c->offset;
+    }
+    return 0;
+}
+
+/*----------------------------------------------------
+  ChanAcquire() / ChanLatest()
+
+  Reads every channel in use in one pass (SampleTask)
+  for the LCD, the alarm and STATUS; the newest
+  values until the next pass.
+----------------------------------------------------*/
+void ChanAcquire(void)
+{
+    u8 ch;
+
+    for(ch = 0; ch < CHAN_COUNT; ch++)
+        chanLatest[ch] = ChanRead(ch);
+}
+
+s32 ChanLatest(u8 ch)
+{
+    return chanLatest[ch];
+}
+
+/*----------------------------------------------------
+  ChanOverSp()
+
+  1 if value is at or above the channel's set point.
+----------------------------------------------------*/
+u8 ChanOverSp(u8 ch, s32 value)
+{
+    return chanCfg[ch].type != CHAN_T_OFF && value >= chanCfg[ch].sp;
+}
@@ -0,0 +1,47 @@
+#ifndef CHAN_H
+#define CHAN_H
+
+#include "types.h"
+
+/*----------------------------------------------------
+  Channel table
+
+  One entry per analog input AIN0..AIN3: the sensor
+  name and type, its scale (calibration), set point
+  and sampling period. Values are s32 in the units of
+  the type: 0.1 C for an LM35, mV for a plain voltage.
+----------------------------------------------------*/
+#define CHAN_COUNT      4
+#define CHAN_NAME_MAX   8
+
+// Sensor types
+#define CHAN_T_OFF      0       // Input not used, not acquired
+#define CHAN_T_LM35     1       // 0.1 C
+#define CHAN_T_MV       2       // mV, 0..3300
+
+typedef struct
+{
+    char name[CHAN_NAME_MAX + 1];
+    u8   type;          // CHAN_T_*
+    u8   filter;        // FILT_* ahead of the conversion
+    u8   filtParam;
+    s32  gainQ16;       // Scale: value * gain + offset
+    s32  offset;        // In value units
+    s32  sp;            // Set point, value units
+    u32  periodMs;      // Sampler period, 0 = not logged
+} chan_cfg_t;
+
+void ChanInit(void);
+const chan_cfg_t *ChanCfg(u8 ch);
+u32 ChanMask(void);
+u8 ChanSetPeriod(u8 ch, u32 periodMs);
+u8 ChanSetSp(u8 ch, s32 sp);
+u8 ChanSetScale(u8 ch, s32 gainQ16, s32 offset);
+u8 ChanUnitDiv(u8 ch);
+
+s32 ChanRead(u8 ch);
+void ChanAcquire(void);
+s32 ChanLatest(u8 ch);
+u8 ChanOverSp(u8 ch, s32 value);
+
+#endif
@@ -0,0 +1,608 @@
+#include "types.h"          // Custom data types
+#include "uart.h"           // RX ring, TX functions, baud rate
+#include "rtc.h"            // Set / get time and date
+#include "logbuf.h"         // RAM log
+#include "flashlog.h"       // Flash log
+#include "sched.h"          // SchedIdleMs(), SchedReport()
+#include "data_logger.h"    // curTemp, DisplayUART*(), DispUARTValue()
+#include "dump.h"           // DUMP
+#include "sampler.h"        // Sampling counters
+#include "chan.h"           // Channel table
+#include "alarm.h"          // Alarm states, ACK
+#include "stats.h"          // Interval statistics
+#include "logpolicy.h"      // Logging policy, counters
+#include "cmd.h"            // CMD_LINE_MAX
+
+/*----------------------------------------------------
+  Command protocol
+
+  One command per line (CR and/or LF), words split by
+  blanks, case-insensitive. Every command answers with
+  one line starting "OK" or "ERR":
+
+    GET SP | RATE | TIME       SP 40 / RATE 60 / TIME ...
+    GET SAMPLER                ticks, lateness, per channel
+                               period/taken/missed/in use
+    GET TASKS                  idle ms, per task runs and
+                               runtime max/avg (us), late
+    GET CH <ch>                channel table entry and value
+    GET ALARM                  per channel state, conditions
+                               and rate of change per minute
+    GET STATS <ch>             open minute, hour and day:
+                               count mean sd min max over-SP s
+    GET LOG                    per channel policy, samples
+                               taken/logged and compression
+    SET SP [<ch>] <sp>         C (LM35) or mV; CH0 if no ch
+    SET ALARM <ch> <lo>,<hyst>,<rate>,<latch>
+                               raw units (0.1 C or mV); lo
+                               signed or OFF, the rate per
+                               minute, 0 = off
+    SET RATE <0..86400>        CH0 seconds between records
+    SET PERIOD <ch> <ms>       0 (off) or 10..86400000 in
+                               steps of 10
+    SET RAW <ch> <0|1>         log every sample, or only the
+                               interval statistics
+    SET DEADBAND <ch> <band>,<heartbeat s>
+    SET ADAPTIVE <ch> <band>,<min ms>,<max ms>
+                               logging policy, band in raw
+                               units (0.1 C or mV)
+    SET TIME <hh:mm:ss>
+    SET DATE <dd/mm/yyyy>      also sets the day of week
+    SET BAUD <1200..230400>    after the OK has been sent
+    STATUS                     one line of counters
+    ACK                        acknowledge every alarm
+    DUMP [<rec>]               records as "D ..." lines
+    DUMP BIN [<rec>]           records as binary frames
+
+  CmdTask() is a scheduler task: it only takes the
+  bytes the UART ISR has already received, and a
+  dump is sent a few records per run (see dump.c) so
+  that it never waits on the UART. Received bytes
+  are left in the RX ring while a binary frame is
+  half sent, so replies (and DUMP restarts) come
+  between frames.
+----------------------------------------------------*/
+#define BAUD_MIN    1200
+#define BAUD_MAX    230400
+
+static s8  cmdLine[CMD_LINE_MAX];
+static u8  cmdLen;
+static u8  cmdTooLong;
+static u32 cmdBaud;         // Baud rate to switch to once TX is idle
+
+/*----------------------------------------------------
+  NextWord()
+
+  Returns the next blank-separated word of *p and
+  terminates it; empty string at the end of line.
+----------------------------------------------------*/
+static s8 *NextWord(s8 **p)
+{
+    s8 *w;
+
+    while(**p == ' ')
+        (*p)++;
+    w = *p;
+    while(**p && **p != ' ')
+        (*p)++;
+    if(**p)
+        *(*p)++ = 0;
+    return w;
+}
+
+static u8 Same(const s8 *a, const char *b)
+{
+    while(*a && *a == *b)
+    {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+/*----------------------------------------------------
+  ParseFields()
+
+  Parses n decimal fields separated by sep ("12:05:00"
+  with sep ':' and n = 3). Returns 0 on any error.
+----------------------------------------------------*/
+static u8 ParseFields(const s8 *s, s8 sep, u8 n, u32 *v)
+{
+    u8 i, digits;
+
+    for(i = 0; i < n; i++)
+    {
+        v[i] = 0;
+        for(digits = 0; *s >= '0' && *s <= '9'; s++, digits++)
+            v[i] = v[i] * 10 + (*s - '0');
+        if(!digits || digits > 9)
+            return 0;
+        if(i < n - 1 && *s++ != sep)
+            return 0;
+    }
+    return *s == 0;
+}
+
+static void Reply(const char *s)
+{
+    UARTTxStr((s8 *)s);
+    UARTTxStr("\n\r");
+}
+
+/*----------------------------------------------------
+  CmdSampler()
+
+  GET SAMPLER body: tick count, ticks lost to long
+  interrupt-off stalls, worst and mean lateness in us,
+  then for every channel the period set (ms), samples
+  taken, deadlines missed and the period in use (ms,
+  differs while the adaptive policy has changed it).
+----------------------------------------------------*/
+static void CmdSampler(void)
+{
+    const sample_stats_t *s = SamplerStats();
+    const sample_ch_t *c;
+    u8 ch;
+
+    UARTTxStr("OK SAMPLER TICKS ");
+    UARTTxU32(s->ticks);
+    UARTTxStr(" LOST ");
+    UARTTxU32(s->lostTicks);
+    UARTTxStr(" LATE ");
+    UARTTxU32(s->lateMaxUs);
+    UARTTxChar('/');
+    UARTTxU32(s->ticks ? s->lateSumUs / s->ticks : 0);
+    for(ch = 0; ch < SAMPLE_CHANNELS; ch++)
+    {
+        c = SamplerChannel(ch);
+        UARTTxStr(" CH");
+        UARTTxChar('0' + ch);
+        UARTTxChar(' ');
+        UARTTxU32(c->periodMs);
+        UARTTxChar('/');
+        UARTTxU32(c->taken);
+        UARTTxChar('/');
+        UARTTxU32(c->missed);
+        UARTTxChar('/');
+        UARTTxU32(c->curMs);
+    }
+}
+
+/*----------------------------------------------------
+  CmdChannel()
+
+  GET CH body: name, type, current value, set point,
+  period (ms) and scale (gain Q16, offset).
+----------------------------------------------------*/
+static void CmdChannel(u8 ch)
+{
+    static const char *typeName[] = { "OFF", "LM35", "MV" };
+    const chan_cfg_t *c = ChanCfg(ch);
+
+    UARTTxStr("OK CH ");
+    UARTTxChar('0' + ch);
+    UARTTxChar(' ');
+    UARTTxStr((s8 *)c->name);
+    UARTTxChar(' ');
+    UARTTxStr((s8 *)typeName[c->type]);
+    UARTTxChar(' ');
+    DispUARTValue(ch, ChanLatest(ch));
+    UARTTxStr(" SP ");
+    DispUARTValue(ch, c->sp);
+    UARTTxStr(" PERIOD ");
+    UARTTxU32(c->periodMs);
+    UARTTxStr(" GAIN ");
+    UARTTxU32(c->gainQ16);
+    UARTTxStr(" OFFSET ");
+    UARTTxDeci(c->offset * 10 / ChanUnitDiv(ch));
+}
+
+/*----------------------------------------------------
+  CmdAlarm()
+
+  GET ALARM body: per channel the state, conditions
+  present (H high, L low, R rate, '-' not) and the
+  rate of change per minute in display units.
+----------------------------------------------------*/
+static void CmdAlarm(void)
+{
+    static const char *stateName[] = { "IDLE", "ACTIVE", "ACKED", "LATCHED" };
+    const alarm_ch_t *a;
+    u8 ch;
+
+    UARTTxStr("OK ALARM");
+    for(ch = 0; ch < CHAN_COUNT; ch++)
+    {
+        a = AlarmChannel(ch);
+        UARTTxStr(" CH");
+        UARTTxChar('0' + ch);
+        UARTTxChar(' ');
+        UARTTxStr((s8 *)stateName[a->state]);
+        UARTTxChar(' ');
+        UARTTxChar(a->cond & ALM_HIGH ? 'H' : '-');
+        UARTTxChar(a->cond & ALM_LOW ? 'L' : '-');
+        UARTTxChar(a->cond & ALM_RATE ? 'R' : '-');
+        UARTTxChar(' ');
+        UARTTxDeci(a->rate * 10 / ChanUnitDiv(ch));
+    }
+}
+
+/*----------------------------------------------------
+  CmdStats()
+
+  GET STATS body: for the minute, hour and day still
+  open, "M|H|D <count> <mean> <sd> <min> <max> <over>"
+  with values in display units and the time at or
+  over SP in seconds; "M 0" when it has no samples.
+----------------------------------------------------*/
+static void CmdStats(u8 ch)
+{
+    static const char spanName[STAT_SPANS] = { 'M', 'H', 'D' };
+    stat_rec_t s;
+    u8 span, div = ChanUnitDiv(ch);
+
+    UARTTxStr("OK STATS CH");
+    UARTTxChar('0' + ch);
+    for(span = 0; span < STAT_SPANS; span++)
+    {
+        UARTTxChar(' ');
+        UARTTxChar(spanName[span]);
+        UARTTxChar(' ');
+        if(!StatsCurrent(ch, span, &s))
+        {
+            UARTTxChar('0');
+            continue;
+        }
+        UARTTxU32(s.count);
+        UARTTxChar(' ');
+        UARTTxDeci(s.mean * 10 / div);
+        UARTTxChar(' ');
+        UARTTxDeci(s.sd * 10 / div);
+        UARTTxChar(' ');
+        UARTTxDeci(s.min * 10 / div);
+        UARTTxChar(' ');
+        UARTTxDeci(s.max * 10 / div);
+        UARTTxChar(' ');
+        UARTTxU32(s.overS);
+    }
+}
+
+/*----------------------------------------------------
+  CmdLog()
+
+  GET LOG body: per channel the policy, samples taken
+  and logged, and the compression: samples a fixed
+  rate would have logged (the fastest period for
+  ADAPTIVE) per sample logged.
+----------------------------------------------------*/
+static void CmdLog(void)
+{
+    static const char *modeName[] = { "ALL", "NONE", "DEADBAND", "ADAPTIVE" };
+    const policy_cnt_t *c;
+    u8 ch;
+
+    UARTTxStr("OK LOG");
+    for(ch = 0; ch < CHAN_COUNT; ch++)
+    {
+        c = PolicyCounters(ch);
+        UARTTxStr(" CH");
+        UARTTxChar('0' + ch);
+        UARTTxChar(' ');
+        UARTTxStr((s8 *)modeName[PolicyCfg(ch)->mode]);
+        UARTTxChar(' ');
+        UARTTxU32(c->taken);
+        UARTTxChar('/');
+        UARTTxU32(c->logged);
+        UARTTxChar(' ');
+        if(c->logged)
+            UARTTxDeci(c->fullRate * 10 / c->logged);
+        else
+            UARTTxChar('-');
+    }
+}
+
+/*----------------------------------------------------
+  CmdPolicy()
+
+  Sets a channel's logging policy; 0 if invalid.
+----------------------------------------------------*/
+static u8 CmdPolicy(u32 ch, u8 mode, u32 band, u32 minMs, u32 maxMs)
+{
+    log_policy_t p;
+
+    if(ch >= CHAN_COUNT || band > 0xFFFF)
+        return 0;
+    p.mode = mode;
+    p.band = band;
+    p.minMs = minMs;
+    p.maxMs = maxMs;
+    return PolicySet(ch, &p);
+}
+
+/*----------------------------------------------------
+  ParseLow()
+
+  Leading "<lo>," field of SET ALARM: a signed value
+  or OFF (ALM_LOW_OFF). On success *s is moved past
+  the comma; returns 0 on any error.
+----------------------------------------------------*/
+static u8 ParseLow(s8 **s, s32 *low)
+{
+    s8 *p = *s, *f = *s;
+    u32 v;
+    u8 neg = (*f == '-');
+
+    while(*p && *p != ',')
+        p++;
+    if(!*p)
+        return 0;
+    *p = 0;
+    if(Same(f, "OFF"))
+        *low = ALM_LOW_OFF;
+    else if(ParseFields(f + neg, 0, 1, &v))
+        *low = neg ? -(s32)v : (s32)v;
+    else
+    {
+        *p = ',';
+        return 0;
+    }
+    *s = p + 1;
+    return 1;
+}
+
+/*----------------------------------------------------
+  CmdAlarmSet()
+
+  Sets a channel's alarm thresholds; 0 if invalid
+  (AlarmSet() rejects what does not fit its s32
+  fields as a negative hysteresis or rate).
+----------------------------------------------------*/
+static u8 CmdAlarmSet(u32 ch, s32 low, u32 hyst, u32 rateMax, u32 latch)
+{
+    alarm_cfg_t a;
+
+    if(ch >= CHAN_COUNT)
+        return 0;
+    a.low = low;
+    a.hyst = hyst;
+    a.rateMax = rateMax;
+    a.latch = latch;
+    return AlarmSet(ch, &a);
+}
+
+/*----------------------------------------------------
+  CmdGet() / CmdSet()
+----------------------------------------------------*/
+static void CmdGet(s8 *what, s8 *arg)
+{
+    rtc_time_t t;
+    u32 ch;
+
+    if(*arg && !Same(what, "CH") && !Same(what, "STATS"))
+    {
+        Reply("ERR ARG");
+        return;
+    }
+    if(Same(what, "SP"))
+    {
+        UARTTxStr("OK SP ");
+        UARTTxU32(ChanCfg(0)->sp / ChanUnitDiv(0));
+    }
+    else if(Same(what, "CH") && ParseFields(arg, 0, 1, &ch) && ch < CHAN_COUNT)
+        CmdChannel(ch);
+    else if(Same(what, "STATS") && ParseFields(arg, 0, 1, &ch) && ch < CHAN_COUNT)
+        CmdStats(ch);
+    else if(Same(what, "RATE"))
+    {
+        UARTTxStr("OK RATE ");
+        UARTTxU32(SamplerChannel(0)->periodMs / 1000);
+    }
+    else if(Same(what, "SAMPLER"))
+        CmdSampler();
+    else if(Same(what, "TASKS"))
+    {
+        UARTTxStr("OK TASKS IDLE ");
+        UARTTxU32(SchedIdleMs());
+        SchedReport();
+    }
+    else if(Same(what, "ALARM"))
+        CmdAlarm();
+    else if(Same(what, "LOG"))
+        CmdLog();
+    else if(Same(what, "TIME"))
+    {
+        UARTTxStr("OK TIME ");
+        RTCSnapshot(&t);
+        DisplayUARTTime(t.hour,t.min,t.sec);
+        DisplayUARTDate(t.dom,t.month,t.year);
+    }
+    else
+    {
+        Reply("ERR ARG");
+        return;
+    }
+    UARTTxStr("\n\r");
+}
+
+static void CmdSet(s8 *what, s8 *arg, s8 *arg2)
+{
+    rtc_time_t t;
+    s32 low;
+    u32 v[5];
+
+    if(Same(what, "SP") && !*arg2)  // CH0
+    {
+        arg2 = arg;
+        arg = (s8 *)"0";
+    }
+
+    if(Same(what, "PERIOD") && ParseFields(arg, 0, 1, v) &&
+       ParseFields(arg2, 0, 1, v + 1) && v[0] < CHAN_COUNT &&
+       ChanSetPeriod(v[0], v[1]))
+        ;
+    else if(Same(what, "RAW") && ParseFields(arg, 0, 1, v) &&
+            ParseFields(arg2, 0, 1, v + 1) && v[1] <= 1 &&
+            CmdPolicy(v[0], v[1] ? POLICY_ALL : POLICY_NONE, 0, 0, 0))
+        ;
+    else if(Same(what, "DEADBAND") && ParseFields(arg, 0, 1, v) &&
+            ParseFields(arg2, ',', 2, v + 1) && v[2] <= SAMPLE_PERIOD_MAX / 1000 &&
+            CmdPolicy(v[0], POLICY_DEADBAND, v[1], 0, v[2] * 1000))
+        ;
+    else if(Same(what, "ADAPTIVE") && ParseFields(arg, 0, 1, v) &&
+            ParseFields(arg2, ',', 3, v + 1) &&
+            CmdPolicy(v[0], POLICY_ADAPTIVE, v[1], v[2], v[3]))
+        ;
+    else if(Same(what, "SP") && ParseFields(arg, 0, 1, v) &&
+            ParseFields(arg2, 0, 1, v + 1) && v[0] < CHAN_COUNT &&
+            v[1] <= 10000 && ChanSetSp(v[0], v[1] * ChanUnitDiv(v[0])))
+        ;
+    else if(Same(what, "ALARM") && ParseFields(arg, 0, 1, v) &&
+            ParseLow(&arg2, &low) && ParseFields(arg2, ',', 3, v + 1) &&
+            v[3] <= 1 && CmdAlarmSet(v[0], low, v[1], v[2], v[3]))
+        ;
+    else if(*arg2)
+    {
+        Reply("ERR ARG");
+        return;
+    }
+    else if(Same(what, "RATE") && ParseFields(arg, 0, 1, v) &&
+            v[0] <= SAMPLE_PERIOD_MAX / 1000 && ChanSetPeriod(0, v[0] * 1000))
+        ;
+    else if(Same(what, "BAUD") && ParseFields(arg, 0, 1, v) &&
+            v[0] >= BAUD_MIN && v[0] <= BAUD_MAX)
+        cmdBaud = v[0];
+    else if(Same(what, "TIME") && ParseFields(arg, ':', 3, v) &&
+            v[0] <= 23 && v[1] <= 59 && v[2] <= 59)
+        SetRTCTimeInfo(v[0], v[1], v[2]);
+    else if(Same(what, "DATE") && ParseFields(arg, '/', 3, v) &&
+            v[2] >= 2000 && v[2] <= 2099 &&
+            v[0] >= 1 && v[0] <= RTCDaysInMonth(v[1], v[2]))
+    {
+        SetRTCDateInfo(v[0], v[1], v[2]);
+        SecondsToRTC(RTCToSeconds(v[2], v[1], v[0], 0, 0, 0), &t);
+        SetRTCDay(t.dow);           // 0 = Sunday as in the menu
+    }
+    else
+    {
+        Reply("ERR ARG");
+        return;
+    }
+    Reply("OK");
+}
+
+/*----------------------------------------------------
+  CmdStatus()
+----------------------------------------------------*/
+static void CmdStatus(void)
+{
+    u32 n;
+    u8 ch;
+
+    UARTTxStr("OK STATUS TEMP ");
+    UARTTxDeci(curTemp);
+    UARTTxStr(" SP ");
+    UARTTxU32(ChanCfg(0)->sp / ChanUnitDiv(0));
+    UARTTxStr(" RATE ");
+    UARTTxU32(SamplerChannel(0)->periodMs / 1000);
+    UARTTxStr(" RAM ");
+    UARTTxU32(LogHead() - LogOldest());
+    UARTTxStr(" FLASH ");
+    UARTTxU32(FlashLogEnd() - FlashLogFirst());
+    UARTTxStr(" LOST ");
+    UARTTxU32(LogOverwritten() + FlashLogLost());
+    UARTTxStr(" MISSED ");
+    for(ch = 0, n = 0; ch < SAMPLE_CHANNELS; ch++)
+        n += SamplerChannel(ch)->missed;
+    UARTTxU32(n);
+    UARTTxStr(" RXDROP ");
+    UARTTxU32(UARTRxDropped());
+    UARTTxStr(" TXDROP ");
+    UARTTxU32(UARTTxDropped());
+    UARTTxStr(" IDLE ");
+    UARTTxU32(SchedIdleMs());
+    UARTTxStr("\n\r");
+}
+
+/*----------------------------------------------------
+  CmdExec()
+----------------------------------------------------*/
+static void CmdExec(s8 *p)
+{
+    s8 *cmd = NextWord(&p);
+    s8 *a1 = NextWord(&p);
+    s8 *a2 = NextWord(&p);
+    s8 *a3 = NextWord(&p);
+    u8 mode = DUMP_TEXT;
+    u32 v = 0;
+
+    if(Same(cmd, "GET") && !*a3)
+        CmdGet(a1, a2);
+    else if(Same(cmd, "SET") && !*NextWord(&p))
+        CmdSet(a1, a2, a3);
+    else if(Same(cmd, "STATUS") && !*a1)
+        CmdStatus();
+    else if(Same(cmd, "ACK") && !*a1)
+    {
+        AlarmAck();
+        Reply("OK");
+    }
+    else if(Same(cmd, "DUMP"))
+    {
+        if(Same(a1, "BIN"))
+        {
+            mode = DUMP_BIN;
+            a1 = a2;
+            a2 = a3;
+        }
+        if(*a2 || (*a1 && !ParseFields(a1, 0, 1, &v)))
+        {
+            Reply("ERR ARG");
+            return;
+        }
+        DumpStart(*a1 ? v : FlashLogFirst(), mode);
+    }
+    else
+        Reply("ERR CMD");
+}
+
+/*----------------------------------------------------
+  CmdTask()
+
+  Assembles lines from the RX ring and runs them
+  (not while a dump frame is half sent); continues a
+  dump in progress and applies SET BAUD once the
+  reply has left the shift register.
+----------------------------------------------------*/
+void CmdTask(void)
+{
+    u8 ch;
+
+    if(cmdBaud && UARTTxIdle())
+    {
+        UARTSetBaud(cmdBaud);
+        cmdBaud = 0;
+    }
+
+    while(!DumpBusy() && UARTRxGet(&ch))
+    {
+        if(ch == '\r' || ch == '\n')
+        {
+            if(cmdTooLong)
+                Reply("ERR LONG");
+            else if(cmdLen)
+            {
+                cmdLine[cmdLen] = 0;
+                CmdExec(cmdLine);
+            }
+            cmdLen = 0;
+            cmdTooLong = 0;
+        }
+        else if(cmdLen < CMD_LINE_MAX - 1)
+            cmdLine[cmdLen++] = (ch >= 'a' && ch <= 'z') ? ch - 32 : ch;
+        else
+            cmdTooLong = 1;
+    }
+
+    if(!cmdBaud)
+        DumpStep();
+}
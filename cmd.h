@@ -0,0 +1,10 @@
+#ifndef CMD_H
+#define CMD_H
+
+#include "types.h"
+
+#define CMD_LINE_MAX  48    // Longest command line incl. terminator
+
+void CmdTask(void);
+
+#endif
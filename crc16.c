@@ -0,0 +1,27 @@
+#include "types.h"          // Custom data types
+#include "crc16.h"          // CRC16_INIT
+
+/*----------------------------------------------------
+  Crc16()
+
+  CRC-16/CCITT-FALSE, four bits per step from a
+  16-entry table (32 bytes of flash instead of 512).
+  Pass CRC16_INIT for the first chunk and the previous
+  result for the following ones.
+----------------------------------------------------*/
+static const u16 crcNib[16] =
+{
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+u16 Crc16(u16 crc, const u8 *p, u32 len)
+{
+    while(len--)
+    {
+        crc = (crc << 4) ^ crcNib[(crc >> 12) ^ (*p >> 4)];
+        crc = (crc << 4) ^ crcNib[(crc >> 12) ^ (*p & 0x0F)];
+        p++;
+    }
+    return crc;
+}
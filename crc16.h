@@ -0,0 +1,11 @@
+#ifndef CRC16_H
+#define CRC16_H
+
+#include "types.h"
+
+// CRC-16/CCITT-FALSE: poly 0x1021, init 0xFFFF, no reflection
+#define CRC16_INIT  0xFFFF
+
+u16 Crc16(u16 crc, const u8 *, u32 len);
+
+#endif
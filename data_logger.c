@@ -5,35 +5,118 @@
 #include "rtc.h"          // RTC functions
 #include "keyPd.h"        // Keypad functions
 #include "delay.h"        // Delay functions
+#include "adc_defines.h"  // ADC channel numbers
+#include "logbuf.h"       // RAM log ring
+#include "flashlog.h"     // Persistent log
+#include "dump.h"         // DumpActive()
+#include "sampler.h"      // SamplerSlackMs()
+#include "chan.h"         // Channel table
+#include "alarm.h"        // ALM_* conditions
+#include "stats.h"        // Interval summaries
+#include "fmt.h"          // Line formatting
 #include "data_logger.h"  // Data logger header
 
+s32 curTemp;              // Latest LM35 sample, 0.1 C (SampleTask)
+
 /*----------------------------------------------------
   Display RTC Temperature on LCD
+
+  now -> RTC time (RTCNow()) of this refresh
 ----------------------------------------------------*/
-void DispRTCTemp()
+void DispRTCTemp(u32 now)
 {
-    CmdLCD(0x8A);          // Move cursor to specific LCD position
-    CharLCD('T');          // Display 'T'
-    CharLCD(':');          // Display ':'
-    IntLCD(Read_LM35('C'));// Read LM35 temperature in Celsius & display
-    
-    CmdLCD(0x48);          // Go to CGRAM location
-    Degree();              // Create degree symbol
-    
-    CmdLCD(0x8E);          // Move cursor
-    CharLCD(1);            // Print custom degree symbol
-    CharLCD('C');          // Print 'C'
+    static s32 avg16;        // Running average (x16), updated once a second
+    static u32 avgTime;
+    static u8 avgInit = 0;
+    s32 t = curTemp;         // Sampled by SampleTask (0.1 C)
+
+    if (!avgInit)
+    {
+        avgInit = 1;
+        avg16 = t << 4;
+    }
+    else if (avgTime != now)
+        avg16 += ((t << 4) - avg16) / 16;   // ~16 s time constant
+    avgTime = now;
+
+    FbPosLCD(0x88);          // Alarm / trend indicators
+    FbCharLCD(ChanOverSp(CH0, t) ? GLYPH_BELL : ' ');
+    if ((t << 4) - avg16 >= 10 * 16)        // 1.0 C above the average
+        FbCharLCD(GLYPH_UP);
+    else if ((t << 4) - avg16 <= -10 * 16)
+        FbCharLCD(GLYPH_DOWN);
+    else
+        FbCharLCD(' ');
+
+    FbPosLCD(0x8A);          // Specific LCD position (shadow buffer)
+    FbDeciLCD(t, 4);         // "30.5", right-aligned in 4 cells
+
+    FbPosLCD(0x8E);          // Move position
+    FbCharLCD(GLYPH_DEGREE); // Custom degree symbol (loaded at InitLCD)
+    FbCharLCD('C');          // Print 'C'
+}
+
+/*----------------------------------------------------
+  FmtValue()
+
+  A channel value with its unit ("30.5C" for an
+  LM35, "1250mV" for a voltage), at most 9 bytes.
+----------------------------------------------------*/
+static u8 *FmtValue(u8 *p, u8 ch, s32 value)
+{
+    if(ChanCfg(ch)->type == CHAN_T_LM35)
+    {
+        p = FmtDeci(p, value);      // 0.1 C
+        *p++ = 0xB0;                // Degree symbol in ASCII
+        *p++ = 'C';
+        return p;
+    }
+    p = FmtS32(p, value);
+    *p++ = 'm';
+    *p++ = 'V';
+    return p;
+}
+
+/*----------------------------------------------------
+  FmtRTC()
+
+  "hh:mm:ss " of RTC seconds t.
+----------------------------------------------------*/
+static u8 *FmtRTC(u8 *p, u32 t)
+{
+    rtc_time_t c;
+
+    SecondsToRTC(t, &c);
+    p = FmtTime(p, c.hour, c.min, c.sec);
+    *p++ = ' ';
+    return p;
+}
+
+/*----------------------------------------------------
+  Send a channel value with its unit via UART
+----------------------------------------------------*/
+void DispUARTValue(u8 ch, s32 value)
+{
+    u8 a[16];
+
+    UARTTxBuf(a, FmtValue(a, ch, value) - a);
 }
 
 /*----------------------------------------------------
   Send Temperature via UART
+
+  ch -> channel; its latest value and name
 ----------------------------------------------------*/
-void DispUARTTemp(void)
+void DispUARTTemp(u8 ch)
 {
-    UARTTxStr(" Temp: ");           // Print label
-    UARTTxU32(Read_LM35('C'));      // Send temperature value
-    UARTTxChar(0xB0);               // Degree symbol in ASCII
-    UARTTxStr("C @ ");              // Print unit
+    u8 a[32], *p = a;
+
+    *p++ = ' ';
+    p = FmtStr(p, ChanCfg(ch)->name);   // Channel label
+    p = FmtStr(p, ": ");
+    p = FmtValue(p, ch, ChanLatest(ch));
+    p = FmtStr(p, " @ ");
+    UARTTxBuf(a, p - a);
 }
 
 /*----------------------------------------------------
@@ -41,16 +124,21 @@ void DispUARTTemp(void)
 ----------------------------------------------------*/
 void DisplayUARTTime(u32 hour, u32 minute, u32 second)
 {
-    // Convert digits to ASCII by adding 48
-    UARTTxChar((HOUR/10) + 48);
-    UARTTxChar((HOUR%10) + 48);
-    UARTTxChar(':');
-    UARTTxChar((MIN/10) + 48);
-    UARTTxChar((MIN%10) + 48);
-    UARTTxChar(':');
-    UARTTxChar((SEC/10) + 48);
-    UARTTxChar((SEC%10) + 48);
-    UARTTxChar(' ');
+    u8 a[9], *p = FmtTime(a, hour, minute, second);
+
+    *p++ = ' ';
+    UARTTxBuf(a, p - a);
+}
+
+/*----------------------------------------------------
+  Send Time via UART with milliseconds (hh:mm:ss.mmm)
+----------------------------------------------------*/
+void DisplayUARTTimeMs(u32 hour, u32 minute, u32 second, u32 ms)
+{
+    u8 a[13], *p = FmtTimeMs(a, hour, minute, second, ms);
+
+    *p++ = ' ';
+    UARTTxBuf(a, p - a);
 }
 
 /*----------------------------------------------------
@@ -58,13 +146,109 @@ void DisplayUARTTime(u32 hour, u32 minute, u32 second)
 ----------------------------------------------------*/
 void DisplayUARTDate(u32 date,u32 month,u32 year)
 {
-    UARTTxChar((date/10)+48);
-    UARTTxChar((date%10)+48);
-    UARTTxChar('/');
-    UARTTxChar((month/10)+48);
-    UARTTxChar((month%10)+48);
-    UARTTxChar('/');
-    UARTTxU32(year);        // Send full year
+    u8 a[10];
+
+    UARTTxBuf(a, FmtDate(a, date, month, year) - a);
+}
+
+/*----------------------------------------------------
+  RecLine()
+
+  Text line of one log record, at most FMT_LINE_MAX
+  bytes. Returns the end.
+----------------------------------------------------*/
+static u8 *RecLine(u8 *p, const log_rec_t *r)
+{
+    rtc_time_t c;
+    u8 ch = LOG_CH(r);
+
+    if(LOG_TYPE(r) == LOG_T_ALARM)
+        p = FmtStr(p, r->flags ? " [ALERT]" : " [CLEAR]");
+    *p++ = ' ';
+    p = FmtStr(p, ChanCfg(ch)->name);   // Channel id of the record
+    p = FmtStr(p, ": ");
+    p = FmtValue(p, ch, r->value);
+    p = FmtStr(p, " @ ");
+
+    SecondsToRTC(r->time, &c);
+    p = FmtTimeMs(p, c.hour, c.min, c.sec, r->ms);
+    *p++ = ' ';
+    p = FmtDate(p, c.dom, c.month, c.year);
+
+    if(LOG_TYPE(r) == LOG_T_ALARM)
+    {
+        if(r->flags & ALM_HIGH)
+            p = FmtStr(p, " HIGH");
+        if(r->flags & ALM_LOW)
+            p = FmtStr(p, " LOW");
+        if(r->flags & ALM_RATE)
+            p = FmtStr(p, " RATE");
+    }
+    else if(r->flags & LOG_F_OVER_SP)
+        p = FmtStr(p, " - OVER TEMP!");
+    return FmtStr(p, "\n\r");
+}
+
+/*----------------------------------------------------
+  StatLine()
+
+  Text line of one interval summary, at most
+  FMT_LINE_MAX bytes. Returns the end.
+----------------------------------------------------*/
+static u8 *StatLine(u8 *p, const stat_rec_t *s)
+{
+    static const char *spanName[STAT_SPANS] = { " 1m ", " 1h ", " 1d " };
+    rtc_time_t c;
+
+    p = FmtStr(p, " [STAT] ");
+    p = FmtStr(p, ChanCfg(s->ch)->name);
+    p = FmtStr(p, spanName[s->span]);
+    SecondsToRTC(s->start, &c);
+    p = FmtTime(p, c.hour, c.min, c.sec);
+    *p++ = ' ';
+    p = FmtDate(p, c.dom, c.month, c.year);
+
+    p = FmtStr(p, " n ");
+    p = FmtU32(p, s->count);
+    p = FmtStr(p, " mean ");
+    p = FmtValue(p, s->ch, s->mean);
+    p = FmtStr(p, " sd ");
+    p = FmtValue(p, s->ch, s->sd);
+    p = FmtStr(p, " min ");
+    p = FmtValue(p, s->ch, s->min);
+    *p++ = ' ';
+    p = FmtRTC(p, s->minTime);
+    p = FmtStr(p, "max ");
+    p = FmtValue(p, s->ch, s->max);
+    *p++ = ' ';
+    p = FmtRTC(p, s->maxTime);
+    p = FmtStr(p, "over ");
+    p = FmtU32(p, s->overS);
+    return FmtStr(p, " s\n\r");
+}
+
+/*----------------------------------------------------
+  Send one log record via UART (text line)
+
+  The line is built in one buffer and queued with a
+  single UARTTxBuf(), so it is never interleaved with
+  other output and takes the TX lock once.
+----------------------------------------------------*/
+void DispUARTRec(const log_rec_t *r)
+{
+    u8 line[FMT_LINE_MAX];
+
+    UARTTxBuf(line, RecLine(line, r) - line);
+}
+
+/*----------------------------------------------------
+  Send one interval summary via UART (text line)
+----------------------------------------------------*/
+void DispUARTStat(const stat_rec_t *s)
+{
+    u8 line[FMT_LINE_MAX];
+
+    UARTTxBuf(line, StatLine(line, s) - line);
 }
 
 /*----------------------------------------------------
@@ -72,12 +256,11 @@ void DisplayUARTDate(u32 date,u32 month,u32 year)
 ----------------------------------------------------*/
 void LCDDispInfo(void)
 {
-    CmdLCD(0x01);               // Clear LCD
-    delay_ms(2);
-    CmdLCD(0x80);               // First line
-    StrLCD("1.EDIT TIME INFO");
-    CmdLCD(0xC0);               // Second line
-    StrLCD("2.EDIT SP 3.EXIT"); 
+    ClearFbLCD();               // Clear shadow buffer
+    FbPosLCD(0x80);             // First line
+    FbStrLCD("1.EDIT TIME INFO");
+    FbPosLCD(0xC0);             // Second line
+    FbStrLCD("2.EDIT SP 3.EXIT"); 
 }
 
 /*----------------------------------------------------
@@ -92,190 +275,470 @@ void LCD_Menu(void)
     char menu1[] = {'H','M','S','D'};
     char menu2[] = {'M','Y','D','E'};
     
-    CmdLCD(pos[0]);
+    FbPosLCD(pos[0]);
     for(i=0;i<4;i++)
     {
-        IntLCD(i+1);           // Display option number
-        CharLCD('.');
-        CharLCD(menu1[i]);     // Display label
-        CharLCD(' ');
+        FbIntLCD(i+1);         // Display option number
+        FbCharLCD('.');
+        FbCharLCD(menu1[i]);   // Display label
+        FbCharLCD(' ');
     }
 
-    CmdLCD(pos[1]);
+    FbPosLCD(pos[1]);
     for(i=0;i<4;i++)
     {
-        IntLCD(i+5);
-        CharLCD('.');
-        CharLCD(menu2[i]);
-        CharLCD(' ');
+        FbIntLCD(i+5);
+        FbCharLCD('.');
+        FbCharLCD(menu2[i]);
+        FbCharLCD(' ');
     }
 }
 
 /*----------------------------------------------------
-  Edit Time and Date Function
+  Display Day Selection Menu
 ----------------------------------------------------*/
-void Edit_Time_Date(void)
+void LCD_DayMenu(void)
 {
-    u8 key;
-    s32 H,Mi,S,D,M,Y;
-    u8 weekday;
+    ClearFbLCD();
+    FbPosLCD(0x80);
+    FbStrLCD("0-S 1-M 2-T 3-W");
+    FbPosLCD(0xC0);
+    FbStrLCD("4-T 5-F 6-S");
+}
 
-    LCD_Menu();     // Show edit options
+/*====================================================
+  Tasks
 
-    while(1)
-    {
-        while(ColStat());      
-        delay_ms(10);
-        key=KeyVal();          // Read key
-        while(!ColStat());
+  Run by the scheduler (see sched.c and the task
+  table in data_logger_main.c). None of them may
+  wait: anything that used to block is now a state
+  kept between runs.
+====================================================*/
 
-        switch(key)
-        {
-            case 1:     // Edit Hour
-                CmdLCD(0x01);
-                StrLCD("Enter Hour:");
-                H = GetKeypadNumber();
-                if(H > 23) H = 23;   // Limit hour
-                HOUR=H;
-                break;
+/*----------------------------------------------------
+  SampleTask()
 
-            case 2:     // Edit Minute
-                CmdLCD(0x01);
-                StrLCD("Enter Minute:");
-                Mi = GetKeypadNumber();
-                if(Mi > 59) Mi = 59;
-                MIN=Mi;
-                break;
+  Acquires every channel in one pass (ChanAcquire());
+  CH0 is the reading shared by the other tasks.
+  The first run reports the boot time (Timer0 starts
+  at the top of main) and the records found in flash.
+----------------------------------------------------*/
+void SampleTask(void)
+{
+    static u8 booted = 0;
 
-            case 3:     // Edit Second
-                CmdLCD(0x01);
-                StrLCD("Enter Second:");
-                S = GetKeypadNumber();
-                if(S > 59) S = 59;
-                SEC=S;
-                break;
+    ChanAcquire();
+    curTemp = ChanLatest(CH0);
 
-            case 4:     // Edit Date
-                CmdLCD(0x01);
-                StrLCD("Enter Date:");
-                D = GetKeypadNumber();
-                if(D < 1 || D > 31) D = 1;
-                DOM=D;
-                break;
+    if(!booted)
+    {
+        booted = 1;
+        UARTTxStr(" [BOOT] first sample at ");
+        UARTTxU32(GetTickUs());
+        UARTTxStr(" us, ");
+        UARTTxU32(FlashLogEnd() - FlashLogFirst());
+        UARTTxStr(" records in flash\n\r");
+    }
+}
 
-            case 5:     // Edit Month
-                CmdLCD(0x01);
-                StrLCD("Enter Month:");
-                M = GetKeypadNumber();
-                if(M < 1 || M > 12) M = 1;
-                MONTH=M;
-                break;
+/*----------------------------------------------------
+  LogTask()
 
-            case 6:     // Edit Year
-                CmdLCD(0x01);
-                StrLCD("Enter Year:");
-                Y = GetKeypadNumber();
-                if(Y < 2000) Y = 2000;
-                YEAR=Y;
-                break;
+  Sends the records the sampler (sampler.c) has
+  logged since the last run as text lines, then the
+  interval summaries closed since (stats.c). A line
+  is formatted first and only queued if the TX ring
+  has room for all of it, so the task never waits in
+  UARTTxPut(); the rest go out on a later run. At
+  fast sampling rates the UART falls behind and the
+  lines of overwritten records are skipped.
+----------------------------------------------------*/
+void LogTask(void)
+{
+    static u32 txSeq = 0;       // UART text cursor in the log
+    static u32 statSeq = 0;     // and in the summaries
+    log_rec_t r;
+    stat_rec_t s;
+    u8 line[FMT_LINE_MAX];
+    u32 len;
 
-            case 7:     // Update Day Automatically
-                weekday = GetDayFromDate();
-                SetRTCDay(weekday);
-                CmdLCD(0x01);
-                StrLCD("Day Updated");
-                delay_ms(500);
-                break;
+    // UART text output is one consumer of the log; it
+    // waits while binary frames are on the line
+    if(txSeq < LogOldest())
+        txSeq = LogOldest();    // Fell behind; lines are lost
+    while(DumpActive() != DUMP_BIN && LogRead(txSeq, &r))
+    {
+        len = RecLine(line, &r) - line;
+        if(UARTTxFree() < len)
+            return;             // Summaries wait behind the records
+        UARTTxBuf(line, len);
+        txSeq++;
+    }
 
-            case 8:     // Save & Exit
-                CmdLCD(0x01);
-                StrLCD("Saved");
-                delay_ms(800);
-                return;
-        }
-        LCD_Menu();     // Show menu again
+    if(statSeq < StatsOldest())
+        statSeq = StatsOldest();
+    while(DumpActive() != DUMP_BIN && StatsRead(statSeq, &s))
+    {
+        len = StatLine(line, &s) - line;
+        if(UARTTxFree() < len)
+            break;
+        UARTTxBuf(line, len);
+        statSeq++;
     }
 }
 
 /*----------------------------------------------------
-  Take Multi-Digit Number from Keypad
+  FlashTask()
+
+  Moves logged records into the flash log. An erase
+  or program stalls the CPU, so it is only allowed
+  in the time left before the next sample is due,
+  less one sampler tick (the slack is counted in
+  whole ticks).
 ----------------------------------------------------*/
-u32 GetKeypadNumber(void)
+void FlashTask(void)
 {
-    u32 num = 0;
-    u8 key;
+    u32 slack = SamplerSlackMs();
 
-    while(1)
-    {
-        while(ColStat());
-        delay_ms(10);
-        key = KeyVal();
-        while(!ColStat());
+    FlashLogService(slack > SAMPLE_TICK_MS ? slack - SAMPLE_TICK_MS : 0);
+}
 
-        if(key <= 9)          // If digit pressed
-        {
-            num = (num * 10) + key;  // Form number
-            IntLCD(key);             // Display digit
-        }
-        else if(key == 10)    // Backspace
+/*----------------------------------------------------
+  DisplayTask()
+
+  Draws time, date, day and temperature into the
+  shadow buffer (unless the menu owns the LCD) and
+  flushes the changed cells. All fields come from one
+  RTC snapshot, so the screen never mixes two seconds.
+  Every other STAT_VIEW_S seconds the second line
+  shows the AIN0 hour so far, "28.1<30.5<32.0 h"
+  (min < mean < max), instead of the date.
+----------------------------------------------------*/
+#define STAT_VIEW_S  4
+
+void DisplayTask(void)
+{
+    rtc_time_t t;
+    stat_rec_t s;
+    u32 now;
+
+    if(MenuActive() == 0)
+    {
+        now = RTCSnapshot(&t);
+        DisplayRTCTime(t.hour,t.min,t.sec);
+        if(now / STAT_VIEW_S % 2 && StatsCurrent(CH0, STAT_HOUR, &s))
         {
-            if(num > 0)
-            {
-                num = num / 10;      
-                CmdLCD(0x10);        
-                CharLCD(' ');        
-                CmdLCD(0x10);        
-            }
+            FbPosLCD(0xC0);
+            FbDeciLCD(s.min, 4);
+            FbCharLCD('<');
+            FbDeciLCD(s.mean, 4);
+            FbCharLCD('<');
+            FbDeciLCD(s.max, 4);
+            FbStrLCD(" h");
         }
-        else if(key == 11)    // Enter
+        else
         {
-            return num;
+            FbPosLCD(0xC0);
+            FbStrLCD("                ");
+            DisplayRTCDate(t.dom,t.month,t.year);
+            DisplayRTCDay(t.dow);
         }
+        DispRTCTemp(now);
     }
+
+    FlushLCD();
 }
 
 /*----------------------------------------------------
-  Select Day from Menu
+  Menu state machine
+
+  Replaces the blocking Edit_Time_Date / Edit_SP /
+  GetKeypadNumber / GetDayFromDate loops. MenuTask()
+  is called every 10 ms and handles at most one
+  switch or key event per call. Keys come debounced
+  from the Timer1 scan in keypad.c.
 ----------------------------------------------------*/
-u8 GetDayFromDate(void)
+#define MENU_IDLE    0   // Normal display
+#define MENU_MAIN    1   // 1.EDIT TIME INFO / 2.EDIT SP 3.EXIT
+#define MENU_TIME    2   // Time/date field selection
+#define MENU_NUMBER  3   // Multi-digit entry
+#define MENU_DAY     4   // Day of week selection
+#define MENU_MSG     5   // Timed message, then menuNext
+
+#define NO_KEY       0xFF
+#define KEY_CLEAR    0xFE  // Backspace held: clear the entry
+#define NUM_DIGITS   4   // Longest entry (year)
+
+static u8 menuState = MENU_IDLE;
+static u8 menuNext;             // State after MENU_MSG
+static deadline_t menuMsgDl;    // MENU_MSG timeout
+static u8 numField;             // 0 = SP, 1..6 = time/date field
+static u8 numBuf[NUM_DIGITS+1]; // Digits typed so far
+static u8 numLen;
+
+// Prompts indexed by numField
+static u8 *const numPrompt[] =
 {
-    u8 key;
+    "Enter SP:", "Enter Hour:", "Enter Minute:", "Enter Second:",
+    "Enter Date:", "Enter Month:", "Enter Year:"
+};
 
-    CmdLCD(0x01);
-    CmdLCD(0x80);
-    StrLCD("0-S 1-M 2-T 3-W");
-    CmdLCD(0xC0);
-    StrLCD("4-T 5-F 6-S");
+/*----------------------------------------------------
+  SwPoll()
+
+  Returns 1 once per switch press, on release
+  (active low, debounced over two task periods).
+----------------------------------------------------*/
+static u8 SwPoll(void)
+{
+    static u8 cnt = 0;
 
-    while(1)
+    if(((IOPIN0>>SW)&1) == 0)   // Switch pressed
+    {
+        if(cnt < 2)
+            cnt++;
+        return 0;
+    }
+    if(cnt < 2)
     {
-        while(ColStat());
-        delay_ms(10);
-        key=KeyVal();
-        while(!ColStat());
+        cnt = 0;                // Bounce, ignore
+        return 0;
+    }
+    cnt = 0;
+    return 1;                   // Released after a stable press
+}
+
+/*----------------------------------------------------
+  KeyPoll()
+
+  Next press from the keypad event queue, NO_KEY if
+  none. Releases are dropped; a long press on
+  backspace (10) comes back as KEY_CLEAR.
+----------------------------------------------------*/
+static u8 KeyPoll(void)
+{
+    u8 ev;
 
-        if(key>=0 && key<=6)
-            return key;      // Return selected day
+    while(KeyGetEvent(&ev))
+    {
+        if(KEY_EVENT(ev) == KEY_PRESS)
+            return KEY_CODE(ev);
+        if(ev == (KEY_LONG | 10))
+            return KEY_CLEAR;
     }
+    return NO_KEY;
+}
+
+/*----------------------------------------------------
+  MenuNumberDraw()
+
+  Prompt and the digits typed so far.
+----------------------------------------------------*/
+static void MenuNumberDraw(void)
+{
+    ClearFbLCD();
+    FbPosLCD(0x80);
+    FbStrLCD(numPrompt[numField]);
+    FbStrLCD(numBuf);
 }
 
 /*----------------------------------------------------
-  Edit Set Point Temperature
+  MenuEnter()
+
+  Switches state and draws its screen.
 ----------------------------------------------------*/
-void Edit_SP(void)
+static void MenuEnter(u8 state)
 {
-    extern u32 SP;      // Access global SP
+    menuState = state;
 
-    CmdLCD(0x01);
-    while(!ColStat());  
-    delay_ms(200);   
+    switch(state)
+    {
+        case MENU_IDLE:   ClearFbLCD();    break;
+        case MENU_MAIN:   LCDDispInfo();   break;
+        case MENU_TIME:   LCD_Menu();      break;
+        case MENU_DAY:    LCD_DayMenu();   break;
+        case MENU_NUMBER:
+            numLen = 0;
+            numBuf[0] = '\0';
+            MenuNumberDraw();
+            break;
+    }
+}
 
-    StrLCD("Enter SP:");
-    SP=GetKeypadNumber();   // Get new SP value
+/*----------------------------------------------------
+  MenuNote()
 
-    if(SP>150) SP=150;      // Safety limit
+  Menu mode change on the UART, left out while a
+  binary dump is on the line (it would corrupt a
+  frame).
+----------------------------------------------------*/
+static void MenuNote(const char *s)
+{
+    if(DumpActive() != DUMP_BIN)
+        UARTTxStr((s8 *)s);
+}
+
+/*----------------------------------------------------
+  MenuMsg()
+
+  Shows a message for ms milliseconds, then enters
+  state next.
+----------------------------------------------------*/
+static void MenuMsg(u8 *msg, u32 ms, u8 next)
+{
+    ClearFbLCD();
+    FbPosLCD(0x80);
+    FbStrLCD(msg);
+
+    menuNext = next;
+    DeadlineSetMs(&menuMsgDl, ms);
+    menuState = MENU_MSG;
+}
+
+/*----------------------------------------------------
+  MenuStore()
+
+  Applies a finished number entry. The clock goes
+  through the rtc.c setters, which also drop the
+  sub-second lock (RTCStampMs()).
+----------------------------------------------------*/
+static void MenuStore(u32 num)
+{
+    rtc_time_t t;
+
+    RTCSnapshot(&t);
+    switch(numField)
+    {
+        case 0:     // Set Point (CH0)
+            if(num > 150) num = 150;   // Safety limit
+            ChanSetSp(CH0, num * 10);
+            MenuMsg("SP Saved", 1000, MENU_MAIN);
+            return;
+
+        case 1: if(num > 23) num = 23;              SetRTCTimeInfo(num, t.min, t.sec);    break;
+        case 2: if(num > 59) num = 59;              SetRTCTimeInfo(t.hour, num, t.sec);   break;
+        case 3: if(num > 59) num = 59;              SetRTCTimeInfo(t.hour, t.min, num);   break;
+        case 4: if(num < 1 || num > RTCDaysInMonth(t.month, t.year)) num = 1;
+                                                    SetRTCDateInfo(num, t.month, t.year); break;
+        case 5: if(num < 1 || num > 12) num = 1;    SetRTCDateInfo(t.dom, num, t.year);   break;
+        case 6: if(num < 2000) num = 2000;          SetRTCDateInfo(t.dom, t.month, num);  break;
+    }
+    MenuEnter(MENU_TIME);       // Show menu again
+}
+
+/*----------------------------------------------------
+  MenuActive()
+
+  1 while the menu owns the LCD.
+----------------------------------------------------*/
+u8 MenuActive(void)
+{
+    return menuState != MENU_IDLE;
+}
+
+/*----------------------------------------------------
+  MenuTask()
+
+  Switch opens the menu; keys drive the state
+  machine. Screens are flushed here so key echo
+  does not wait for DisplayTask.
+----------------------------------------------------*/
+void MenuTask(void)
+{
+    u8 key;
+    u8 i;
+    u32 num;
+
+    if(menuState == MENU_IDLE)
+    {
+        if(SwPoll())
+            MenuEnter(MENU_MAIN);   // Show menu (1.Edit 2.SP 3.Exit)
+        else
+            return;
+    }
+    else if(menuState == MENU_MSG)
+    {
+        if(DeadlineExpired(&menuMsgDl))
+            MenuEnter(menuNext);
+        else
+            return;
+    }
+    else if((key = KeyPoll()) != NO_KEY)
+    {
+        switch(menuState)
+        {
+            case MENU_MAIN:
+                if(key == 1)            // Edit Time/Date
+                {
+                    MenuNote(" ***Time Editing Mode Activated***\n\r");
+                    MenuEnter(MENU_TIME);
+                }
+                else if(key == 2)       // Edit Set Point
+                {
+                    MenuNote(" ***SP Editing Mode Activated***\n\r");
+                    numField = 0;
+                    MenuEnter(MENU_NUMBER);
+                }
+                else if(key == 3)       // Exit Menu
+                {
+                    MenuNote(" ***Editing Mode DeActivated***\n\r");
+                    MenuEnter(MENU_IDLE);
+                }
+                break;
+
+            case MENU_TIME:
+                if(key >= 1 && key <= 6)        // Edit a field
+                {
+                    numField = key;
+                    MenuEnter(MENU_NUMBER);
+                }
+                else if(key == 7)               // Select day
+                    MenuEnter(MENU_DAY);
+                else if(key == 8)               // Save & Exit
+                    MenuMsg("Saved", 800, MENU_MAIN);
+                break;
+
+            case MENU_NUMBER:
+                if(key <= 9)                    // Digit
+                {
+                    if(numLen < NUM_DIGITS)
+                    {
+                        numBuf[numLen++] = key + '0';
+                        numBuf[numLen] = '\0';
+                    }
+                }
+                else if(key == 10)              // Backspace
+                {
+                    if(numLen > 0)
+                        numBuf[--numLen] = '\0';
+                }
+                else if(key == KEY_CLEAR)       // Backspace held
+                {
+                    numLen = 0;
+                    numBuf[0] = '\0';
+                }
+                else if(key == 11)              // Enter
+                {
+                    num = 0;
+                    for(i = 0; i < numLen; i++)
+                        num = (num * 10) + (numBuf[i] - '0');
+                    MenuStore(num);
+                    break;
+                }
+                MenuNumberDraw();
+                break;
+
+            case MENU_DAY:
+                if(key <= 6)
+                {
+                    SetRTCDay(key);
+                    MenuMsg("Day Updated", 500, MENU_TIME);
+                }
+                break;
+        }
+    }
+    else
+        return;
 
-    CmdLCD(0x01);
-    StrLCD("SP Saved");
-    delay_ms(1000);
+    FlushLCD();
 }
\ No newline at end of file
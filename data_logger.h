@@ -1,19 +1,30 @@
 #include "types.h"
+#include "logbuf.h"
+#include "stats.h"
 #define FN1 0 
 #define SW 4     
 #define BUZ 25
 
 void DisplayUARTTime(u32, u32, u32);
+void DisplayUARTTimeMs(u32, u32, u32, u32);
 void DisplayUARTDate(u32, u32, u32);
 
-void DispRTCTemp(void);
-void DispUARTTemp(void);
+void DispRTCTemp(u32);
+void DispUARTValue(u8, s32);
+void DispUARTTemp(u8);
+void DispUARTRec(const log_rec_t *);
+void DispUARTStat(const stat_rec_t *);
 
 void LCDDispInfo(void);
 void LCD_Menu(void);
+void LCD_DayMenu(void);
 
-void Edit_Time_Date(void);
-void Edit_SP(void);
+extern s32 curTemp;     // Latest LM35 sample, 0.1 C
 
-u32 GetKeypadNumber(void);
-u8 GetDayFromDate(void);
+// Scheduler tasks
+void SampleTask(void);
+void LogTask(void);
+void DisplayTask(void);
+void MenuTask(void);
+void FlashTask(void);
+u8 MenuActive(void);
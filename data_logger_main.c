@@ -1,4 +1,4 @@
-#include <lpc21xx.h>       // LPC21xx register definitions
+#include <LPC21xx.h>       // LPC21xx register definitions
 
 #include "pin_connect.h"   // Pin configuration functions
 #include "delay.h"         // Delay functions
@@ -10,25 +10,47 @@
 #include "lcd.h"           // LCD functions
 #include "keyPd.h"         // Keypad functions
 #include "data_logger.h"   // Data logger functions
+#include "sched.h"         // Cooperative scheduler
+#include "filter.h"        // ADC filter stage
+#include "flashlog.h"      // Persistent log
+#include "cmd.h"           // UART command protocol
+#include "sampler.h"       // Sampling scheduler
+#include "chan.h"          // Channel table
+#include "alarm.h"         // Alarm engine
+#include "stats.h"         // Interval statistics
+#include "logpolicy.h"     // Logging policy
 
-// Global Variables
-u32 SP = 40;               // Set Point temperature (default 40C)
-u8 key;                    // To store keypad key value
-s32 hour, min, sec;        // Time variables
-s32 date, month, year;     // Date variables
-s32 day;                   // Day variable
-static u8 flag = 0;        // Used to avoid multiple execution at sec = 59
+// -------- Task Table --------
+// Lower prio runs first when several tasks are due on the same tick.
+static task_t tasks[] =
+{
+    // name      body         period ms  prio
+    { "sample",  SampleTask,  250,       0 },
+    { "log",     LogTask,     100,       1 },
+    { "menu",    MenuTask,    10,        2 },
+    { "lcd",     DisplayTask, 100,       3 },
+    { "cmd",     CmdTask,     10,        4 },
+    { "flash",   FlashTask,   100,       5 },
+};
 
 int main()
 {
-    int edit_flag = 0;     // Used to control menu mode
+    u8 rtcKept;
 
     // -------- Initialization Section --------
+    InitTimebase();        // Timer0: 1 us counter + 1 ms tick
     InitUART();            // Initialize UART
-    RTC_Init();            // Initialize RTC
-    Init_ADC(CH0);         // Initialize ADC Channel 0
+    rtcKept = RTC_Init();  // Initialize RTC (keeps a running clock)
+    ChanInit();            // Channel table: names, filters, scale, SP
+    ADCStartBurst(ChanMask());           // Inputs in use sampled by the ADC ISR
+    LogInit();             // Empty RAM log
+    FlashLogInit();        // Find the end of the flash log
+    AlarmInit();           // Thresholds; buzzer driven from the sampler tick
+    StatsInit();           // Minute/hour/day summaries of every sample
+    PolicyInit();          // Every sample logged until told otherwise
+    SamplerInit();         // Channel periods on Timer0 MR1
     InitLCD();             // Initialize LCD
-    KeyPdInit();           // Initialize Keypad
+    KeyScanInit();         // Keypad + Timer1 5 ms scan
     
     CfgPinFunc(0, SW, FN1);   // Configure Switch pin
     CfgPinFunc(0, BUZ, FN1);  // Configure Buzzer pin
@@ -37,109 +59,17 @@ int main()
     IODIR0 |= (1<<BUZ);    // Make Buzzer as output
     
     // -------- Set Initial RTC Time & Date --------
-    SetRTCTimeInfo(11,51,1);      // Set time: 11:51:01
-    SetRTCDateInfo(03,01,2026);   // Set date: 03/01/2026
-    SetRTCDay(1);                 // Set day
-
-    while (1) 
+    // Only when the clock was not running: after a plain
+    // reset it still holds the time the log was written in
+    if(!rtcKept)
     {
-        // -------- Display RTC Time on LCD --------
-        GetRTCTimeInfo(&hour,&min,&sec);
-        DisplayRTCTime(hour,min,sec);
-        
-        // -------- Display RTC Date on LCD --------
-        GetRTCDateInfo(&date,&month,&year);
-        DisplayRTCDate(date,month,year);
-        
-        // -------- Display Day --------
-        GetRTCDay(&day);
-        DisplayRTCDay(day);
-        
-        // -------- Display Temperature --------
-        DispRTCTemp();
-        
-        // -------- Every 59th Second Action --------
-        if(sec == 59 && flag == 0)
-        {
-            flag = 1;   // Prevent repeated execution
-
-            // If temperature is below Set Point
-            if(Read_LM35('C') < SP)
-            {
-                IOCLR0 = (1<<BUZ);      // Turn OFF buzzer
-                DispUARTTemp();         // Send temperature via UART
-            
-                GetRTCTimeInfo(&hour,&min,&sec);
-                DisplayUARTTime(hour,min,sec);
-            
-                GetRTCDateInfo(&date,&month,&year);
-                DisplayUARTDate(date,month,year);
-            
-                UARTTxStr("\n\r"); 
-            }
-            
-            // If temperature is equal or above Set Point
-            if(Read_LM35('C') >= SP)
-            {
-                IOSET0 = (1<<BUZ);      // Turn ON buzzer (Alert)
-                DispUARTTemp();
-            
-                GetRTCTimeInfo(&hour,&min,&sec);
-                DisplayUARTTime(hour,min,sec);
-            
-                GetRTCDateInfo(&date,&month,&year);
-                DisplayUARTDate(date,month,year);
-                
-                UARTTxStr(" - OVER TEMP!\n\r");
-            }   
-        }
-
-        // Reset flag when second changes
-        if(sec != 59)
-            flag = 0;
-
-        // -------- Switch Press Detection --------
-        if(((IOPIN0>>SW)&1) == 0)   // If switch pressed (active low)
-        {
-            delay_ms(10);           // Debounce delay
-            while(((IOPIN0>>SW)&1) == 0);   // Wait until switch release
-
-            edit_flag = 1;          // Enter menu mode
-            LCDDispInfo();          // Show menu (1.Edit 2.SP 3.Exit)
-
-            // -------- MENU LOOP --------
-            while(edit_flag)
-            {
-                while(ColStat());       // Wait for key press
-                delay_ms(10);
-                key = KeyVal();         // Read key
-                while(!ColStat());      // Wait for key release
-
-                // Option 1: Edit Time/Date
-                if(key == 1)
-                {
-                    UARTTxStr(" ***Time Editing Mode Activated***\n\r");
-                    Edit_Time_Date();   // Press 8 to return
-                    LCDDispInfo();      // Show menu again
-                }
-
-                // Option 2: Edit Set Point
-                else if(key == 2)
-                {
-                    UARTTxStr(" ***SP Editing Mode Activated***\n\r");
-                    Edit_SP();
-                    LCDDispInfo();
-                }
-
-                // Option 3: Exit Menu
-                else if(key == 3)
-                {
-                    edit_flag = 0;      // Exit menu
-                    UARTTxStr(" ***Editing Mode DeActivated***\n\r");
-                    CmdLCD(0x01);       // Clear LCD
-                    delay_ms(10);
-                }
-            }
-        }
+        SetRTCTimeInfo(11,51,1);      // Set time: 11:51:01
+        SetRTCDateInfo(03,01,2026);   // Set date: 03/01/2026
+        SetRTCDay(1);                 // Set day
     }
+
+    // -------- Run Tasks (never returns) --------
+    SchedInit(tasks, sizeof(tasks)/sizeof(tasks[0]));
+    SchedRun();
+    return 0;
 }
\ No newline at end of file
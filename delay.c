@@ -1,15 +1,180 @@
+#include <LPC21xx.h>         // LPC21xx register definitions
+#include "types.h"           // Custom data types (u32 etc.)
+#include "timer_defines.h"   // Timer0 timebase macros
+#include "delay.h"           // Delay / deadline declarations
+
+/*----------------------------------------------------
+  Timebase
+
+  Timer0 runs free at 1 MHz (T0TC = microseconds since
+  InitTimebase). MR0 is moved forward by 1000 on every
+  match, giving a 1 ms interrupt that counts tickMs
+  without ever resetting T0TC. MR1 does the same for
+  one periodic hook (TimebasePeriodic()).
+----------------------------------------------------*/
+static volatile u32 tickMs = 0;
+static u8 tbRunning = 0;
+static u32 mr1Period;
+static void (*mr1Fn)(u32);
+
+/*----------------------------------------------------
+  Timer0_ISR()
+
+  1 ms tick. Catches up on ticks missed while
+  interrupts were off (IAP erase stalls the CPU for
+  hundreds of ms), otherwise MR0 would be left behind
+  TC until the counter wraps.
+----------------------------------------------------*/
+void Timer0_ISR(void) __irq
+{
+    u32 ir = T0IR;
+    u32 due;
+
+    if(ir & IR_MR0)
+    {
+        do
+        {
+            tickMs++;
+            T0MR0 += MS_TICK_US;    // Next tick, TC keeps running
+        } while((s32)(T0TC - T0MR0) >= 0);
+        T0IR = IR_MR0;          // Clear MR0 interrupt flag
+    }
+
+    if(ir & IR_MR1)
+    {
+        // The hook gets the time it was due; it works out
+        // its own lateness and any periods skipped here
+        due = T0MR1;
+        do
+            T0MR1 += mr1Period;
+        while((s32)(T0TC - T0MR1) >= 0);
+        T0IR = IR_MR1;
+        mr1Fn(due);
+    }
+
+    VICVectAddr = 0;        // End of interrupt
+}
+
+/*----------------------------------------------------
+  InitTimebase()
+
+  Starts Timer0 as a 1 us free-running counter with a
+  1 ms match interrupt. Called by main(); the delay
+  functions also call it on first use.
+----------------------------------------------------*/
+void InitTimebase(void)
+{
+    T0TCR = TCR_RESET;          // Stop and reset
+    T0PR  = T0_PR_VAL;          // PCLK / 15 = 1 MHz
+    T0MR0 = MS_TICK_US;
+    T0MCR = MCR_MR0I;           // Interrupt only, no reset
+    T0IR  = 0xFF;               // Clear pending flags
+
+    VICIntSelect &= ~(1<<TIMER0_VIC_CHNO);
+    VICVectAddr0 = (u32)Timer0_ISR;
+    VICVectCntl0 = (1<<5) | TIMER0_VIC_CHNO;
+    VICIntEnable = (1<<TIMER0_VIC_CHNO);
+
+    T0TCR = TCR_ENABLE;         // Start counting
+    tbRunning = 1;
+}
+
+/*----------------------------------------------------
+  TimebasePeriodic()
+
+  Calls fn from the Timer0 interrupt every periodUs
+  microseconds (first call one period from now), on
+  MR1. Ticks missed while interrupts were off are
+  not replayed: fn is called once, late, and can
+  tell from dueUs how late. periodUs 0 stops it.
+----------------------------------------------------*/
+void TimebasePeriodic(u32 periodUs, void (*fn)(u32 dueUs))
+{
+    if (!tbRunning)
+        InitTimebase();
+
+    T0MCR &= ~MCR_MR1I;
+    T0IR = IR_MR1;
+    if (!periodUs)
+        return;
+
+    mr1Period = periodUs;
+    mr1Fn = fn;
+    T0MR1 = T0TC + periodUs;
+    T0MCR |= MCR_MR1I;
+}
+
+/*----------------------------------------------------
+  GetTickUs() / GetTickMs()
+
+  Monotonic microseconds (wraps after ~71 min) and
+  milliseconds since InitTimebase().
+----------------------------------------------------*/
+u32 GetTickUs(void)
+{
+    return T0TC;
+}
+
+u32 GetTickMs(void)
+{
+    return tickMs;
+}
+
+/*----------------------------------------------------
+  delay_us() / delay_ms() / delay_s()
+
+  Busy-wait against T0TC, so the length no longer
+  depends on the compiler or flash wait states.
+----------------------------------------------------*/
 void delay_us(unsigned int tdly)
 {
-	tdly*=12;
-	while(tdly--);
+    u32 start;
+
+    if (!tbRunning)
+        InitTimebase();
+
+    start = T0TC;
+    while ((u32)(T0TC - start) < tdly);
 }
+
 void delay_ms(unsigned int tdly)
-{	
-	tdly*=12000;	
-	while(tdly--);
+{
+    while (tdly--)
+        delay_us(1000);
 }
+
 void delay_s(unsigned int tdly)
 {
-	tdly*=12000000;
-	while(tdly--);
+    while (tdly--)
+        delay_ms(1000);
+}
+
+/*----------------------------------------------------
+  DeadlineSetUs() / DeadlineSetMs()
+
+  Arm a deadline len microseconds / milliseconds
+  from now.
+----------------------------------------------------*/
+void DeadlineSetUs(deadline_t *d, u32 len)
+{
+    if (!tbRunning)
+        InitTimebase();
+
+    d->start = T0TC;
+    d->len = len;
+}
+
+void DeadlineSetMs(deadline_t *d, u32 len)
+{
+    DeadlineSetUs(d, len * 1000);
+}
+
+/*----------------------------------------------------
+  DeadlineExpired()
+
+  Returns 1 once the deadline has passed.
+----------------------------------------------------*/
+u8 DeadlineExpired(deadline_t *d)
+{
+    return (u32)(T0TC - d->start) >= d->len;
 }
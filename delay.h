@@ -1,3 +1,32 @@
+#ifndef DELAY_H
+#define DELAY_H
+
+#include "types.h"
+
+/*----------------------------------------------------
+  deadline_t
+
+  Non-blocking timeout: set it once, then ask
+  DeadlineExpired() from a polling loop or task.
+  Spans up to 2^32 us (about 71 minutes).
+----------------------------------------------------*/
+typedef struct
+{
+    u32 start;    // T0TC when the deadline was set
+    u32 len;      // length in microseconds
+} deadline_t;
+
+void InitTimebase(void);
+u32 GetTickUs(void);
+u32 GetTickMs(void);
+void TimebasePeriodic(u32 periodUs, void (*fn)(u32 dueUs));
+
 void delay_us(unsigned int);
 void delay_ms(unsigned int);
-void delay_s(unsigned int);
\ No newline at end of file
+void delay_s(unsigned int);
+
+void DeadlineSetUs(deadline_t *, u32);
+void DeadlineSetMs(deadline_t *, u32);
+u8 DeadlineExpired(deadline_t *);
+
+#endif
@@ -0,0 +1,367 @@
+#include "types.h"          // Custom data types
+#include "uart_defines.h"   // UART_TX_BUF_SIZE
+#include "uart.h"           // TX ring
+#include "fmt.h"            // Line formatting
+#include "crc16.h"          // Frame CRC
+#include "logbuf.h"         // RAM log
+#include "flashlog.h"       // Flash log
+#include "dump.h"           // Modes, frame layout
+
+/*----------------------------------------------------
+  Log dump
+
+  Sends the flash log from a record number on, then
+  the newer records still only in RAM (numbered on
+  from the flash log, staged ones included), either
+  as text lines
+  or as binary frames. DumpStep() is called from a
+  task and only queues what the TX ring can take, so
+  it never waits on the UART.
+
+  Binary frames are packed into a buffer (flash
+  records decompressed on the way) and SLIP-escaped
+  into the TX ring a chunk at a time. A receiver that
+  loses a frame asks again with "DUMP BIN <rec>".
+
+  Each complete flash sector is checked against its
+  trailer CRC (FlashLogCheck()) before its first
+  record goes out; the records of a sector that
+  fails are skipped, leaving a gap in the numbers,
+  and counted in "OK DUMP <n> BAD <skipped>".
+----------------------------------------------------*/
+#define PH_IDLE   0
+#define PH_FLASH  1
+#define PH_RAM    2
+#define PH_DONE   3
+
+static u8  dMode;           // DUMP_TEXT / DUMP_BIN, 0 = idle
+static u8  dPhase;
+static u32 dRec;            // Next record number to send
+static u32 dSeq;            // PH_RAM: next RAM log sequence
+static u32 dRamRec;         // PH_RAM: number of the record at dSeq
+static u32 dCount;          // Records sent
+static u32 dBad;            // Records skipped, sector CRC failed
+static u32 dSectSeq;        // Sequence of the last sector that passed
+
+// Binary frame being sent
+static u8  fHdr[DUMP_HDR_BYTES];
+static u32 fLen, fPos;      // fPos counts header + data + CRC bytes
+static u16 fCrc;
+static u8  fBusy;
+static u8  fData[DUMP_FRAME_RECS * LOG_REC_BYTES];
+
+/*----------------------------------------------------
+  DumpStart()
+
+  Starts (or restarts) a dump at record rec. Callers
+  wait for DumpBusy() to clear so that a frame being
+  sent is not cut off.
+----------------------------------------------------*/
+void DumpStart(u32 rec, u8 mode)
+{
+    dMode = mode;
+    dPhase = PH_FLASH;
+    dRec = rec;
+    dCount = 0;
+    dBad = 0;
+    dSectSeq = 0;
+    fBusy = 0;
+}
+
+/*----------------------------------------------------
+  DumpActive()
+----------------------------------------------------*/
+u8 DumpActive(void)
+{
+    return dMode;
+}
+
+/*----------------------------------------------------
+  DumpBusy()
+
+  A binary frame is partly in the TX ring: anything
+  else queued now would land inside it.
+----------------------------------------------------*/
+u8 DumpBusy(void)
+{
+    return fBusy;
+}
+
+/*----------------------------------------------------
+  FlashBad()
+
+  1 if record rec is in a complete sector that fails
+  its CRC; next is then the first record after it.
+  A sector that passes is not checked again.
+----------------------------------------------------*/
+static u8 FlashBad(u32 rec, u32 *next)
+{
+    u8 s = FlashLogSector(rec);
+    const fl_index_t *e;
+
+    if(s == FL_SECTORS)
+        return 0;               // Staged, or gone: FlashLogRead() decides
+    e = FlashLogIndex(s);
+    if(e->seq == dSectSeq || e->blocks != FL_BLOCKS)
+        return 0;               // Checked, or no trailer yet
+    if(!FlashLogCheck(s))
+    {
+        *next = e->rec + e->count;
+        return 1;
+    }
+    dSectSeq = e->seq;
+    return 0;
+}
+
+/*----------------------------------------------------
+  EnterRam()
+
+  Switches to the RAM log at the first record the
+  flash log does not hold (FlashLogTail()), by
+  sequence number, so records of the same second on
+  both sides are neither skipped nor sent twice.
+----------------------------------------------------*/
+static void EnterRam(void)
+{
+    dRamRec = FlashLogTail(&dSeq);
+    dPhase = PH_RAM;
+}
+
+/*----------------------------------------------------
+  NextRam()
+
+  Next RAM record to send (number >= dRec); its
+  number is dRamRec - 1. Records overwritten before
+  they were sent are skipped with their numbers, so
+  the numbering has a gap there. Returns 0 when the
+  RAM log has no more.
+----------------------------------------------------*/
+static u8 NextRam(log_rec_t *r)
+{
+    for(;;)
+    {
+        if(dSeq < LogOldest())
+        {
+            dRamRec += LogOldest() - dSeq;  // Overwritten: numbers go on
+            dSeq = LogOldest();
+        }
+        if(!LogRead(dSeq, r))
+        {
+            if(dSeq < LogOldest())
+                continue;       // Overwritten while reading
+            return 0;
+        }
+        dSeq++;
+        if(dRamRec++ >= dRec)
+            return 1;
+    }
+}
+
+/*----------------------------------------------------
+  TextStep()
+
+  One "D" line per record while the ring is less
+  than half full.
+----------------------------------------------------*/
+static void TextStep(void)
+{
+    log_rec_t r;
+    u8 got, line[FMT_LINE_MAX], *p;
+    u32 next;
+
+    while(dPhase != PH_DONE && UARTTxPending() < UART_TX_BUF_SIZE / 2)
+    {
+        if(dPhase == PH_FLASH)
+        {
+            if(dRec < FlashLogFirst())
+                dRec = FlashLogFirst();     // Sector reused meanwhile
+            if(FlashBad(dRec, &next))
+            {
+                dBad += next - dRec;
+                dRec = next;
+                continue;
+            }
+            got = FlashLogRead(dRec, &r);
+            if(!got)
+            {
+                EnterRam();
+                continue;
+            }
+        }
+        else if(!(got = NextRam(&r)))
+        {
+            dPhase = PH_DONE;
+            break;
+        }
+        else
+            dRec = dRamRec - 1;
+
+        p = FmtStr(line, "D ");
+        p = FmtU32(p, dRec++);
+        *p++ = ' ';
+        p = FmtU32(p, r.time);
+        *p++ = '.';
+        p = FmtPad(p, r.ms, 3);
+        *p++ = ' ';
+        p = FmtDeci(p, r.value);
+        *p++ = ' ';
+        p = FmtU32(p, r.ch);
+        *p++ = ' ';
+        p = FmtU32(p, r.flags);
+        p = FmtStr(p, "\n\r");
+        UARTTxBuf(line, p - line);
+        dCount++;
+    }
+}
+
+/*----------------------------------------------------
+  NextFrame()
+
+  Sets up the next binary frame: a batch of flash
+  records, a batch of RAM records, or the END frame.
+  A frame's records are numbered on from its header
+  without gaps; a RAM frame ends before one.
+----------------------------------------------------*/
+static void NextFrame(void)
+{
+    log_rec_t r;
+    u32 n = 0, next;
+    u8 type = DUMP_F_RECS;
+
+    if(dPhase == PH_FLASH)
+    {
+        if(dRec < FlashLogFirst())
+            dRec = FlashLogFirst();
+        while(FlashBad(dRec, &next))
+        {
+            dBad += next - dRec;
+            dRec = next;
+        }
+        while(n < DUMP_FRAME_RECS && !FlashBad(dRec + n, &next) &&
+              FlashLogRead(dRec + n, &r))
+            LogPack(&r, fData + LOG_REC_BYTES * n++);
+        if(!n)
+            EnterRam();
+    }
+    if(dPhase == PH_RAM)
+    {
+        while(n < DUMP_FRAME_RECS && NextRam(&r))
+        {
+            if(!n)
+                dRec = dRamRec - 1;
+            else if(dRamRec - 1 != dRec + n)
+            {
+                dSeq--;         // After a gap: starts the next frame
+                dRamRec--;
+                break;
+            }
+            LogPack(&r, fData + LOG_REC_BYTES * n++);
+        }
+        if(!n)
+        {
+            type = DUMP_F_END;
+            dPhase = PH_DONE;
+        }
+    }
+
+    fHdr[0] = type;
+    fHdr[1] = dRec;
+    fHdr[2] = dRec >> 8;
+    fHdr[3] = dRec >> 16;
+    fHdr[4] = dRec >> 24;
+    fHdr[5] = n;
+    fLen = n * LOG_REC_BYTES;
+    fPos = 0;
+    fCrc = CRC16_INIT;
+    fBusy = 1;
+    dRec += n;
+    dCount += n;
+}
+
+/*----------------------------------------------------
+  BinStep()
+
+  Queues SLIP-escaped frame bytes while the ring has
+  room; a frame may span several calls. No new frame
+  is started while received bytes wait, so that the
+  command task gets a gap between frames to reply in.
+----------------------------------------------------*/
+static void BinStep(void)
+{
+    u8 out[32], b;
+    u32 len = 0, room = UARTTxFree();
+
+    while(room >= 2 + sizeof(out))
+    {
+        if(!fBusy)
+        {
+            if(dPhase == PH_DONE || UARTRxAvail())
+                break;
+            NextFrame();
+            out[len++] = SLIP_END;
+        }
+
+        if(fPos < DUMP_HDR_BYTES)
+            b = fHdr[fPos];
+        else if(fPos < DUMP_HDR_BYTES + fLen)
+            b = fData[fPos - DUMP_HDR_BYTES];
+        else if(fPos == DUMP_HDR_BYTES + fLen)
+            b = fCrc;
+        else
+            b = fCrc >> 8;
+        if(fPos < DUMP_HDR_BYTES + fLen)
+            fCrc = Crc16(fCrc, &b, 1);
+
+        if(b == SLIP_END || b == SLIP_ESC)
+        {
+            out[len++] = SLIP_ESC;
+            b = (b == SLIP_END) ? SLIP_ESC_END : SLIP_ESC_ESC;
+        }
+        out[len++] = b;
+
+        if(++fPos == DUMP_HDR_BYTES + fLen + 2)
+        {
+            out[len++] = SLIP_END;
+            fBusy = 0;
+        }
+        if(len > sizeof(out) - 4)
+        {
+            UARTTxBuf(out, len);
+            room -= len;
+            len = 0;
+        }
+    }
+    if(len)
+        UARTTxBuf(out, len);
+}
+
+/*----------------------------------------------------
+  DumpStep()
+
+  Continues the dump; reports "OK DUMP <n>" at the
+  end (after the END frame in binary mode), with
+  " BAD <k>" if sectors failed their CRC.
+----------------------------------------------------*/
+void DumpStep(void)
+{
+    if(!dMode)
+        return;
+
+    if(dMode == DUMP_TEXT)
+        TextStep();
+    else
+        BinStep();
+
+    if(dPhase == PH_DONE && !fBusy)
+    {
+        UARTTxStr("OK DUMP ");
+        UARTTxU32(dCount);
+        if(dBad)
+        {
+            UARTTxStr(" BAD ");
+            UARTTxU32(dBad);
+        }
+        UARTTxStr("\n\r");
+        dMode = 0;
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef DUMP_H
+#define DUMP_H
+
+#include "types.h"
+
+// Dump modes (DumpActive() returns 0 when idle)
+#define DUMP_TEXT   1       // "D <rec> <time> <0.1 C> <ch> <flags>" lines
+#define DUMP_BIN    2       // SLIP framed binary
+
+/*----------------------------------------------------
+  Binary frame (between SLIP_END bytes, escaped)
+
+    type   u8       DUMP_F_RECS or DUMP_F_END
+    rec    u32 LE   number of the first record (END:
+                    the next one to ask for)
+    count  u8       records in this frame
+    data   count x LOG_REC_BYTES (LogPack())
+    crc    u16 LE   CRC16 of type..data
+----------------------------------------------------*/
+#define DUMP_F_RECS       0x01
+#define DUMP_F_END        0x02
+#define DUMP_FRAME_RECS   16
+#define DUMP_HDR_BYTES    6
+
+#define SLIP_END          0xC0
+#define SLIP_ESC          0xDB
+#define SLIP_ESC_END      0xDC
+#define SLIP_ESC_ESC      0xDD
+
+void DumpStart(u32 rec, u8 mode);
+void DumpStep(void);
+u8 DumpActive(void);
+u8 DumpBusy(void);
+
+#endif
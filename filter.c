@@ -0,0 +1,203 @@
+#include <LPC21xx.h>        // VIC registers
+#include "types.h"          // Custom data types
+#include "timer_defines.h"  // TIMER0_VIC_CHNO
+#include "adc.h"            // Raw samples (burst ring / Read_ADC)
+#include "adc_defines.h"    // ADC_RING_SIZE
+#include "filter.h"         // Filter types
+
+/*----------------------------------------------------
+  Filter stage
+
+  Sits between the raw 10-bit ADC counts and the LM35
+  conversion. Each channel has one filter; all of
+  them are integer only and return counts in Q4 so
+  that oversampling can hand on its extra bits.
+
+  Samples come from the ADC burst ring when it is
+  running, otherwise from Read_ADC conversions.
+
+  The IIR has state, so it advances in one context
+  only: FilterTick() on the sampler interrupt. Its
+  FilterRead() returns the output of the last tick
+  and can be called from anywhere without moving the
+  filter along.
+----------------------------------------------------*/
+#define IIR_FRAC 8          // IIR state kept in Q8
+
+typedef struct
+{
+    u8  type;
+    u8  param;
+    s32 iir;                // FILT_IIR: state, counts in Q8
+    u32 seen;               // FILT_IIR: burst samples already taken in
+    u8  primed;             // FILT_IIR: state valid
+    volatile u32 out;       // FILT_IIR: output of the last tick, Q4
+} filt_t;
+
+static filt_t filt[4];
+
+/*----------------------------------------------------
+  FilterSet()
+
+  Selects the filter of a channel (see filter.h) and
+  clamps param to what the filter supports.
+----------------------------------------------------*/
+void FilterSet(u32 ch, u8 type, u8 param)
+{
+    if(ch >= 4)
+        return;
+
+    switch(type)
+    {
+        case FILT_OVERSAMPLE:
+            if(param > 3) param = 3;
+            break;
+        case FILT_MOVAVG:
+            if(param < 1) param = 1;
+            if(param > FILT_MAX_N) param = FILT_MAX_N;
+            break;
+        case FILT_MEDIAN:
+            if(param > FILT_MAX_K) param = FILT_MAX_K;
+            param |= 1;                     // Odd
+            break;
+        case FILT_IIR:
+            if(param > 8) param = 8;
+            break;
+        default:
+            type = FILT_NONE;
+    }
+
+    VICIntEnClr = (1<<TIMER0_VIC_CHNO);     // Tick must not see half an update
+    filt[ch].type = type;
+    filt[ch].param = param;
+    filt[ch].primed = 0;
+    VICIntEnable = (1<<TIMER0_VIC_CHNO);
+}
+
+/*----------------------------------------------------
+  FiltSamples()
+
+  Newest n raw samples of a channel, oldest first.
+  Returns how many were available.
+----------------------------------------------------*/
+static u32 FiltSamples(u32 ch, u16 *buf, u32 n)
+{
+    u32 i, val;
+    f32 eAR;
+
+    if(ADCSampleCount(ch))
+        return ADCWindow(ch, buf, n);
+
+    for(i = 0; i < n; i++)                  // No burst: convert now
+    {
+        Read_ADC(ch, &eAR, &val);
+        buf[i] = val;
+    }
+    return n;
+}
+
+/*----------------------------------------------------
+  Median()
+
+  Insertion sort of k values, middle one.
+----------------------------------------------------*/
+static u32 Median(u16 *v, u32 k)
+{
+    u32 i, j;
+    u16 x;
+
+    for(i = 1; i < k; i++)
+    {
+        x = v[i];
+        for(j = i; j > 0 && v[j-1] > x; j--)
+            v[j] = v[j-1];
+        v[j] = x;
+    }
+    return v[k/2];
+}
+
+/*----------------------------------------------------
+  FilterTick()
+
+  Sampler tick hook (interrupt context): feeds every
+  FILT_IIR channel the burst samples taken since the
+  last tick (at most a ring; one conversion without
+  the burst) and stores its output for FilterRead().
+----------------------------------------------------*/
+void FilterTick(void)
+{
+    filt_t *f;
+    u16 buf[ADC_RING_SIZE];
+    u32 ch, n, i, cnt;
+
+    for(ch = 0; ch < 4; ch++)
+    {
+        f = &filt[ch];
+        if(f->type != FILT_IIR)
+            continue;
+
+        cnt = ADCSampleCount(ch);
+        n = cnt ? cnt - f->seen : 1;
+        if(n > ADC_RING_SIZE)
+            n = ADC_RING_SIZE;
+        if(!f->primed)
+            n = 1;
+        n = FiltSamples(ch, buf, n);
+        for(i = 0; i < n; i++)
+        {
+            if(!f->primed)
+            {
+                f->iir = (s32)buf[i] << IIR_FRAC;
+                f->primed = 1;
+            }
+            else
+                f->iir += (((s32)buf[i] << IIR_FRAC) - f->iir) >> f->param;
+        }
+        f->seen = cnt;
+        f->out = (f->iir + (1 << (IIR_FRAC - FILT_FRAC_BITS - 1))) >> (IIR_FRAC - FILT_FRAC_BITS);
+    }
+}
+
+/*----------------------------------------------------
+  FilterRead()
+
+  Filtered value of a channel, raw counts in Q4
+  (0 .. 1023*16). FILT_IIR gives the last tick's
+  output, or the newest sample before the first tick.
+----------------------------------------------------*/
+u32 FilterRead(u32 ch)
+{
+    filt_t *f = &filt[ch];
+    u16 buf[FILT_MAX_N];
+    u32 n, i, sum = 0;
+
+    switch(f->type)
+    {
+        case FILT_OVERSAMPLE:               // 4^k samples -> k extra bits
+            n = FiltSamples(ch, buf, 1UL << (2 * f->param));
+            for(i = 0; i < n; i++)
+                sum += buf[i];
+            if(n < (1UL << (2 * f->param))) // Not enough history yet
+                return n ? (sum << FILT_FRAC_BITS) / n : 0;
+            return (sum >> f->param) << (FILT_FRAC_BITS - f->param);
+
+        case FILT_MOVAVG:
+            n = FiltSamples(ch, buf, f->param);
+            for(i = 0; i < n; i++)
+                sum += buf[i];
+            return n ? (sum << FILT_FRAC_BITS) / n : 0;
+
+        case FILT_MEDIAN:
+            n = FiltSamples(ch, buf, f->param);
+            return n ? Median(buf, (n - 1) | 1) << FILT_FRAC_BITS : 0;
+
+        case FILT_IIR:
+            if(f->primed)
+                return f->out;
+            // Fall through: not ticked yet
+
+        default:
+            n = FiltSamples(ch, buf, 1);
+            return n ? (u32)buf[0] << FILT_FRAC_BITS : 0;
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include "types.h"
+
+// Filter types (FilterSet)
+#define FILT_NONE        0   // newest sample
+#define FILT_OVERSAMPLE  1   // param k: sum 4^k samples, keep k extra bits (k <= 3)
+#define FILT_MOVAVG      2   // param N: mean of the newest N samples
+#define FILT_MEDIAN      3   // param K: median of the newest K samples (odd)
+#define FILT_IIR         4   // param s: y += (x - y) / 2^s, every sample
+
+#define FILT_FRAC_BITS   4   // FilterRead() returns counts in Q4 (x16)
+#define FILT_MAX_N       64  // longest window (ADC_RING_SIZE)
+#define FILT_MAX_K       9   // longest median
+
+void FilterSet(u32 ch, u8 type, u8 param);
+void FilterTick(void);
+u32 FilterRead(u32 ch);
+
+#endif
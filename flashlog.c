@@ -0,0 +1,696 @@
+#include <LPC21xx.h>        // LPC21xx register definitions
+#include "types.h"          // Custom data types
+#include "iap_defines.h"    // FLASH_BASE_PTR, sector addresses
+#include "iap.h"            // Erase / program
+#include "delay.h"          // deadline_t
+#include "crc16.h"          // Sector CRC
+#include "logbuf.h"         // RAM log (source of records)
+#include "logcodec.h"       // Compressed blocks
+#include "flashlog.h"       // Layout
+
+/*----------------------------------------------------
+  Persistent log
+
+  Records are moved from the RAM log into flash by
+  FlashLogService(), one IAP operation per call and
+  only if it fits the time budget the caller grants.
+  Both erase and program stall the CPU with interrupts
+  off, so the caller places them between samples.
+
+  Record numbers run on across sectors and every
+  block header holds the number of its first record,
+  so a record keeps its number until its sector is
+  erased. Sectors are reused round robin, which
+  spreads the erases evenly (wear leveling); each
+  header carries the sector's erase count.
+
+  Boot never walks the records: complete sectors are
+  described by their trailer, and in the sector being
+  filled only the block headers are read and the last
+  block is checked and decoded. The journal copy of
+  the block that was being staged is decoded and
+  staged again on the first FlashLogService().
+----------------------------------------------------*/
+#define FL_NONE        0xFF
+#define FL_SECT_ADDR(i) FLASH_SECTOR_ADDR(FL_FIRST_SECTOR + (i))
+#define FL_PTR(i)       (FLASH_BASE_PTR + FL_SECT_ADDR(i))
+#define FL_BLK(i, b)    (FL_PTR(i) + BlockOff(b))
+#define FL_SLOT(j)      (FL_PTR(FL_JRNL) + (j) * FL_BLOCK)
+
+static u32 flBlockW[FL_BLOCK / 4];      // Staging block (word aligned for IAP)
+#define flBlock ((u8 *)flBlockW)
+
+static fl_index_t flIdx[FL_SECTORS];    // Sparse index, one entry per sector
+static u8  flCur = FL_NONE;             // Sector being filled
+static u8  flClosed;                    // flCur takes no more records
+static u32 flCurSeq = 0;                // Its header sequence (0 = none yet)
+static codec_enc_t flEnc;               // Block being staged in flBlock
+static u32 flStaged;                    // Records in it
+static u8  flFull;                      // It takes no more
+static u32 flStagedLast;                // Time of the last staged record
+static u32 flCopied;                    // Staged records in the journal
+static u32 flCopyFirst;                 // Time of the first one not
+static deadline_t flStageDl;            // FL_STAGE_S after it
+static u8  flJrnlNext;                  // Next blank journal slot
+static u8  flJrnlRestore;               // Newest copy not looked at yet
+static u32 flSrc;                       // Next RAM log sequence to store
+static u32 flLost;                      // RAM records overwritten before stored
+
+static codec_dec_t flRd;                // Read cursor: decoding block
+static u8  flRdSect = FL_NONE;          //   flRdBlk of sector flRdSect
+static u8  flRdBlk;                     //   (FL_RD_STAGED: flBlock with
+static u32 flRdRec;                     //   flRdStaged records), next
+static u32 flRdStaged;                  //   record is number flRdRec
+
+#define FL_RD_STAGED    FL_BLOCKS
+
+/*----------------------------------------------------
+  Little-endian u32 from flash
+----------------------------------------------------*/
+static u32 Rd32(const u8 *p)
+{
+    return p[0] | ((u32)p[1] << 8) | ((u32)p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static void Wr32(u8 *p, u32 v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+/*----------------------------------------------------
+  CheckOk()
+
+  Headers and trailers are four words whose XOR is
+  all ones; erased or torn ones fail.
+----------------------------------------------------*/
+static u8 CheckOk(const u8 *p)
+{
+    return (Rd32(p) ^ Rd32(p + 4) ^ Rd32(p + 8) ^ Rd32(p + 12)) == 0xFFFFFFFF;
+}
+
+/*----------------------------------------------------
+  HdrSeq()
+
+  Sequence number of sector i, 0 if its header is
+  not valid.
+----------------------------------------------------*/
+static u32 HdrSeq(u32 i)
+{
+    const u8 *h = FL_PTR(i);
+
+    if(Rd32(h) != FL_MAGIC || !CheckOk(h))
+        return 0;
+    return Rd32(h + 4);
+}
+
+/*----------------------------------------------------
+  FlashLogErases()
+
+  Erase count of log sector i as stored in its header.
+----------------------------------------------------*/
+u32 FlashLogErases(u32 i)
+{
+    return HdrSeq(i) ? Rd32(FL_PTR(i) + 8) : 0;
+}
+
+/*----------------------------------------------------
+  Blank()
+
+  1 if len bytes at p were never programmed.
+----------------------------------------------------*/
+static u8 Blank(const u8 *p, u32 len)
+{
+    while(len--)
+        if(*p++ != 0xFF)
+            return 0;
+    return 1;
+}
+
+/*----------------------------------------------------
+  BlockOff() / BlockSize()
+
+  Offset in its sector and size of codec block b:
+  block 0 starts after the header, the last one ends
+  at the trailer.
+----------------------------------------------------*/
+static u32 BlockOff(u32 b)
+{
+    return b ? b * FL_BLOCK : FL_HDR_SIZE;
+}
+
+static u32 BlockSize(u32 b)
+{
+    return ((b == FL_BLOCKS - 1) ? FL_TRL_OFF : (b + 1) * FL_BLOCK) - BlockOff(b);
+}
+
+/*----------------------------------------------------
+  IndexSector()
+
+  Builds the index entry of sector i. Returns 1 if
+  the sector takes no more records: it is complete,
+  or its last block is torn (power lost while it was
+  programmed), which cannot be programmed over.
+
+  Without a trailer the programmed blocks are found
+  by a binary search on their headers, then only the
+  last one is checked (CRC, and the block after it
+  still blank) and decoded for the time of the last
+  record. The same is done for a trailer whose count
+  (low half of its third word, the CRC is the high
+  half) is out of range or disagrees with the block
+  headers; the sector then has no CRC to pass.
+----------------------------------------------------*/
+static u8 IndexSector(u32 i)
+{
+    fl_index_t *e = &flIdx[i];
+    const u8 *t = FL_PTR(i) + FL_TRL_OFF;
+    const u8 *b;
+    codec_dec_t d;
+    log_rec_t r;
+    u32 lo, hi, mid, w, n;
+
+    e->seq = HdrSeq(i);
+    e->rec = e->first = e->last = 0;
+    e->count = e->crc = 0;
+    e->blocks = 0;
+    if(!e->seq)
+        return 1;
+
+    if(CheckOk(t))
+    {
+        w = Rd32(t + 8);
+        n = w & 0xFFFF;
+        b = FL_BLK(i, FL_BLOCKS - 1);
+        if(n >= FL_BLOCKS && n <= FL_SECTOR_RECS &&
+           n == CodecRec(b) + CodecCount(b) - CodecRec(FL_BLK(i, 0)))
+        {
+            e->rec   = CodecRec(FL_BLK(i, 0));
+            e->first = Rd32(t);
+            e->last  = Rd32(t + 4);
+            e->count = n;
+            e->crc   = w >> 16;
+            e->blocks = FL_BLOCKS;
+            return 1;
+        }
+    }
+
+    lo = 0;
+    hi = FL_BLOCKS;
+    while(lo < hi)                      // lo = programmed blocks
+    {
+        mid = (lo + hi) / 2;
+        if(Blank(FL_BLK(i, mid), CODEC_HDR_BYTES))
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    e->blocks = (lo && !CodecCheck(FL_BLK(i, lo - 1), BlockSize(lo - 1))) ? lo - 1 : lo;
+
+    if(e->blocks)
+    {
+        b = FL_BLK(i, e->blocks - 1);
+        e->rec   = CodecRec(FL_BLK(i, 0));
+        e->count = CodecRec(b) + CodecCount(b) - e->rec;
+        e->first = CodecTime(FL_BLK(i, 0));
+        CodecOpen(&d, b, BlockSize(e->blocks - 1));
+        while(CodecGet(&d, &r))
+            e->last = r.time;
+    }
+    if(e->blocks < lo || lo == FL_BLOCKS)
+        return 1;
+    return !Blank(FL_PTR(i) + lo * FL_BLOCK, FL_BLOCK);
+}
+
+/*----------------------------------------------------
+  FlashLogInit()
+
+  Builds the index and picks the newest sector as the
+  write head. A sector without a good block numbers
+  on from the newest record.
+----------------------------------------------------*/
+void FlashLogInit(void)
+{
+    u32 i, end = 0;
+    u8 closed;
+
+    flCur = FL_NONE;
+    flCurSeq = 0;
+    flClosed = 1;
+    for(i = 0; i < FL_SECTORS; i++)
+    {
+        closed = IndexSector(i);
+        if(flIdx[i].seq > flCurSeq)
+        {
+            flCurSeq = flIdx[i].seq;
+            flCur = i;
+            flClosed = closed;
+        }
+        if(flIdx[i].blocks && flIdx[i].rec + flIdx[i].count > end)
+            end = flIdx[i].rec + flIdx[i].count;
+    }
+    for(i = 0; i < FL_SECTORS; i++)
+        if(!flIdx[i].blocks)
+            flIdx[i].rec = end;
+
+    for(flJrnlNext = FL_JRNL_SLOTS; flJrnlNext && Blank(FL_SLOT(flJrnlNext - 1), FL_BLOCK); flJrnlNext--)
+        ;
+    flJrnlRestore = (flJrnlNext != 0);
+
+    flStaged = 0;
+    flCopied = 0;
+    flFull = 0;
+    flRdSect = FL_NONE;
+    flSrc = LogHead();          // Only records logged from now on
+    flLost = 0;
+}
+
+/*----------------------------------------------------
+  FlashLogIndex()
+
+  Index entry of log sector i (0..FL_SECTORS-1).
+----------------------------------------------------*/
+const fl_index_t *FlashLogIndex(u32 i)
+{
+    return &flIdx[i];
+}
+
+/*----------------------------------------------------
+  ClearBlock()
+----------------------------------------------------*/
+static void ClearBlock(void)
+{
+    u32 i;
+
+    if(flRdBlk == FL_RD_STAGED)
+        flRdSect = FL_NONE;             // Cursor was decoding the block
+    for(i = 0; i < FL_BLOCK / 4; i++)
+        flBlockW[i] = 0xFFFFFFFF;
+    flStaged = 0;
+    flCopied = 0;
+    flFull = 0;
+}
+
+/*----------------------------------------------------
+  StartSector()
+
+  Erases the next sector round robin and stages its
+  header at the start of block 0. A sector that is
+  still blank (erased, but rebooted before its first
+  block went in) is reused without another erase.
+----------------------------------------------------*/
+static u8 StartSector(void)
+{
+    u8 next = (flCur == FL_NONE) ? 0 : (flCur + 1) % FL_SECTORS;
+    u32 erases = FlashLogErases(next) + 1;
+    u32 rec = FlashLogEnd();
+
+    if(flRdSect == next)
+        flRdSect = FL_NONE;             // Cursor must not read the erase
+    if(IAPBlankCheck(FL_FIRST_SECTOR + next, FL_FIRST_SECTOR + next) != IAP_CMD_SUCCESS &&
+       IAPErase(FL_FIRST_SECTOR + next, FL_FIRST_SECTOR + next) != IAP_CMD_SUCCESS)
+        return 0;
+
+    flCur = next;
+    flCurSeq++;
+    flClosed = 0;
+    flIdx[next].seq = flCurSeq;
+    flIdx[next].rec = rec;
+    flIdx[next].first = flIdx[next].last = 0;
+    flIdx[next].count = flIdx[next].crc = 0;
+    flIdx[next].blocks = 0;
+
+    ClearBlock();
+    Wr32(flBlock + 0, FL_MAGIC);
+    Wr32(flBlock + 4, flCurSeq);
+    Wr32(flBlock + 8, erases);
+    Wr32(flBlock + 12, ~(FL_MAGIC ^ flCurSeq ^ erases));
+    return 1;
+}
+
+/*----------------------------------------------------
+  StageTrailer()
+
+  Completes the last block of a sector with the
+  trailer. The CRC covers the blocks already in flash
+  and the one staged here.
+----------------------------------------------------*/
+static void StageTrailer(void)
+{
+    fl_index_t *e = &flIdx[flCur];
+    u8 *t = flBlock + (FL_TRL_OFF % FL_BLOCK);
+    u32 w;
+    u16 crc;
+
+    crc = Crc16(CRC16_INIT, FL_PTR(flCur) + FL_HDR_SIZE, (FL_BLOCKS - 1) * FL_BLOCK - FL_HDR_SIZE);
+    crc = Crc16(crc, flBlock, FL_TRL_OFF % FL_BLOCK);
+    w = (e->count + flStaged) | ((u32)crc << 16);
+
+    Wr32(t + 0, e->first);
+    Wr32(t + 4, flStagedLast);
+    Wr32(t + 8, w);
+    Wr32(t + 12, ~(e->first ^ flStagedLast ^ w));
+    e->crc = crc;
+}
+
+/*----------------------------------------------------
+  Stage()
+
+  Adds record r to the staging block of sector entry
+  e. 0 if the block takes no more (full, or r is
+  before its base: the clock was set back).
+----------------------------------------------------*/
+static u8 Stage(fl_index_t *e, const log_rec_t *r)
+{
+    if(!flStaged)
+        CodecStart(&flEnc, flBlock + BlockOff(e->blocks) % FL_BLOCK,
+                   BlockSize(e->blocks), e->rec + e->count);
+    if(!CodecPut(&flEnc, r))
+        return 0;
+    if(e->count + flStaged == 0)
+        e->first = r->time;
+    if(flStaged == flCopied)
+    {
+        flCopyFirst = r->time;
+        DeadlineSetMs(&flStageDl, FL_STAGE_S * 1000);
+    }
+    flStagedLast = r->time;
+    flStaged++;
+    return 1;
+}
+
+/*----------------------------------------------------
+  JrnlRestore()
+
+  Stages the records of the newest journal copy that
+  is the next block of sector entry e again, once
+  after boot. A copy torn by a power loss fails its
+  CRC and the one before it is taken.
+----------------------------------------------------*/
+static void JrnlRestore(fl_index_t *e)
+{
+    codec_dec_t d;
+    log_rec_t r;
+    u32 off = BlockOff(e->blocks) % FL_BLOCK, size = BlockSize(e->blocks);
+    u8 j;
+
+    flJrnlRestore = 0;
+    for(j = flJrnlNext; j; j--)
+        if(CodecCheck(FL_SLOT(j - 1) + off, size) &&
+           CodecRec(FL_SLOT(j - 1) + off) == e->rec + e->count)
+            break;
+    if(!j)
+        return;
+
+    CodecOpen(&d, FL_SLOT(j - 1) + off, size);
+    while(CodecGet(&d, &r) && Stage(e, &r))
+        ;
+    flCopied = flStaged;
+}
+
+/*----------------------------------------------------
+  FlashLogService()
+
+  Compresses new RAM log records into the staging
+  block and performs at most one erase or program,
+  only if its stall fits in budgetMs. Call it from a
+  low-priority task.
+
+  The block is programmed when the codec fills it.
+  Until then it is copied to the journal when a
+  record comes FL_STAGE_S or more after the oldest
+  one not copied (by its time stamp) or once
+  FL_STAGE_S has passed on Timer0, so a quiet channel
+  is saved too. The journal is erased when full and
+  nothing staged is left in it.
+----------------------------------------------------*/
+void FlashLogService(u32 budgetMs)
+{
+    fl_index_t *e;
+    log_rec_t r;
+
+    // A full (or missing) sector needs a fresh one first
+    if(flCur == FL_NONE || flClosed)
+    {
+        if(budgetMs >= FL_ERASE_MS)
+            StartSector();
+        return;
+    }
+    e = &flIdx[flCur];
+    if(flJrnlRestore && !flStaged)
+        JrnlRestore(e);
+
+    if(flJrnlNext == FL_JRNL_SLOTS && !flStaged && budgetMs >= FL_ERASE_MS)
+    {
+        if(IAPErase(FL_FIRST_SECTOR + FL_JRNL, FL_FIRST_SECTOR + FL_JRNL) == IAP_CMD_SUCCESS)
+            flJrnlNext = 0;
+        return;
+    }
+
+    // Stage records into the current block
+    if(flSrc < LogOldest())
+    {
+        flLost += LogOldest() - flSrc;
+        flSrc = LogOldest();
+    }
+    while(!flFull && LogRead(flSrc, &r))
+    {
+        if(!Stage(e, &r))
+        {
+            flFull = 1;
+            break;
+        }
+        flSrc++;
+    }
+
+    // Copy a block that is not full to the journal
+    if(!flFull && flStaged > flCopied &&
+       (flStagedLast - flCopyFirst >= FL_STAGE_S || DeadlineExpired(&flStageDl)))
+    {
+        if(flJrnlNext == FL_JRNL_SLOTS)
+            flFull = 1;                 // No slot left: program it as it is
+        else if(budgetMs >= FL_PROG_MS)
+        {
+            CodecEnd(&flEnc);
+            if(IAPCopy(FL_SECT_ADDR(FL_JRNL) + flJrnlNext++ * FL_BLOCK, flBlockW, FL_BLOCK) == IAP_CMD_SUCCESS)
+                flCopied = flStaged;
+            return;
+        }
+    }
+
+    // Program once the block is complete
+    if(!flFull || budgetMs < FL_PROG_MS)
+        return;
+
+    CodecEnd(&flEnc);
+    if(e->blocks == FL_BLOCKS - 1)
+        StageTrailer();
+
+    if(IAPCopy(FL_SECT_ADDR(flCur) + e->blocks * FL_BLOCK, flBlockW, FL_BLOCK) != IAP_CMD_SUCCESS)
+        return;                         // Retried on the next call
+
+    e->count += flStaged;
+    e->last = flStagedLast;
+    e->blocks++;
+    flClosed = (e->blocks == FL_BLOCKS);
+    ClearBlock();
+}
+
+/*----------------------------------------------------
+  SeekStaged()
+
+  Seek() in the staging block. Its header is
+  completed (CodecEnd()) for the decoder; the cursor
+  starts over whenever records were added, since a
+  run tag it has passed may have grown.
+----------------------------------------------------*/
+static u8 SeekStaged(u32 recNo)
+{
+    log_rec_t r;
+    u32 rec;
+
+    if(flCur == FL_NONE || !flStaged)
+        return 0;
+    rec = flIdx[flCur].rec + flIdx[flCur].count;
+    if(recNo < rec || recNo - rec >= flStaged)
+        return 0;
+
+    if(flRdBlk != FL_RD_STAGED || flRdSect != flCur || flRdStaged != flStaged ||
+       flRdRec > recNo)
+    {
+        CodecEnd(&flEnc);
+        CodecOpen(&flRd, flEnc.buf, flEnc.size);
+        flRdSect = flCur;
+        flRdBlk = FL_RD_STAGED;
+        flRdStaged = flStaged;
+        flRdRec = rec;
+    }
+    while(flRdRec < recNo && CodecGet(&flRd, &r))
+        flRdRec++;
+    return flRdRec == recNo;
+}
+
+/*----------------------------------------------------
+  FlashLogSector()
+
+  Log sector holding programmed record recNo, or
+  FL_SECTORS if none does (staged, or not stored).
+----------------------------------------------------*/
+u8 FlashLogSector(u32 recNo)
+{
+    u8 i;
+
+    for(i = 0; i < FL_SECTORS; i++)
+        if(flIdx[i].seq && recNo >= flIdx[i].rec && recNo - flIdx[i].rec < flIdx[i].count)
+            break;
+    return i;
+}
+
+/*----------------------------------------------------
+  Seek()
+
+  Puts the read cursor on record recNo: the sector
+  from the index, the block from the block headers,
+  then decoding on from the cursor if it is already
+  in that block before recNo (reading in order), else
+  from the start of the block. Records not in flash
+  yet are looked for in the staging block. 0 if not
+  stored.
+----------------------------------------------------*/
+static u8 Seek(u32 recNo)
+{
+    log_rec_t r;
+    u8 i = FlashLogSector(recNo), b;
+
+    if(i == FL_SECTORS)
+        return SeekStaged(recNo);
+
+    for(b = flIdx[i].blocks - 1; CodecRec(FL_BLK(i, b)) > recNo; b--)
+        ;
+    if(flRdSect != i || flRdBlk != b || flRdRec > recNo)
+    {
+        CodecOpen(&flRd, FL_BLK(i, b), BlockSize(b));
+        flRdSect = i;
+        flRdBlk = b;
+        flRdRec = CodecRec(FL_BLK(i, b));
+    }
+    while(flRdRec < recNo && CodecGet(&flRd, &r))
+        flRdRec++;
+    return flRdRec == recNo;
+}
+
+/*----------------------------------------------------
+  FlashLogRead()
+
+  Reads stored record recNo, programmed or staged.
+  Returns 0 if the flash log does not hold it (not
+  staged yet, or its sector reused).
+----------------------------------------------------*/
+u8 FlashLogRead(u32 recNo, log_rec_t *r)
+{
+    if(!Seek(recNo) || !CodecGet(&flRd, r))
+    {
+        flRdSect = FL_NONE;
+        return 0;
+    }
+    flRdRec++;
+    return 1;
+}
+
+/*----------------------------------------------------
+  FlashLogFind()
+
+  Number of the first stored record with a time at
+  or after time (FlashLogEnd() if there is none).
+  The index picks the sector, the block headers the
+  block, and only that block is decoded.
+----------------------------------------------------*/
+u32 FlashLogFind(u32 time)
+{
+    codec_dec_t d;
+    log_rec_t r;
+    u8 i, b, best = FL_NONE;
+    u32 rec;
+
+    for(i = 0; i < FL_SECTORS; i++)
+    {
+        if(!flIdx[i].count || flIdx[i].last < time)
+            continue;
+        if(best == FL_NONE || flIdx[i].seq < flIdx[best].seq)
+            best = i;
+    }
+    if(best == FL_NONE)
+        return FlashLogEnd();
+
+    for(b = 1; b < flIdx[best].blocks && CodecTime(FL_BLK(best, b)) < time; b++)
+        ;
+    b--;                                // Last block starting before time
+    CodecOpen(&d, FL_BLK(best, b), BlockSize(b));
+    for(rec = CodecRec(FL_BLK(best, b)); CodecGet(&d, &r) && r.time < time; rec++)
+        ;
+    return rec;
+}
+
+/*----------------------------------------------------
+  FlashLogCheck()
+
+  Recomputes the CRC of a complete sector and compares
+  it with its trailer. Boot does not do this; dumps
+  (dump.c) call it once per sector they enter.
+----------------------------------------------------*/
+u8 FlashLogCheck(u32 i)
+{
+    const fl_index_t *e = &flIdx[i];
+
+    if(e->blocks != FL_BLOCKS)
+        return 0;
+    return Crc16(CRC16_INIT, FL_PTR(i) + FL_HDR_SIZE, FL_TRL_OFF - FL_HDR_SIZE) == e->crc;
+}
+
+/*----------------------------------------------------
+  FlashLogFirst() / FlashLogEnd()
+
+  Oldest record number in flash, and one past the
+  newest.
+----------------------------------------------------*/
+u32 FlashLogFirst(void)
+{
+    u8 i, oldest = FL_NONE;
+
+    for(i = 0; i < FL_SECTORS; i++)
+        if(flIdx[i].seq && (oldest == FL_NONE || flIdx[i].seq < flIdx[oldest].seq))
+            oldest = i;
+    return (oldest == FL_NONE) ? 0 : flIdx[oldest].rec;
+}
+
+u32 FlashLogEnd(void)
+{
+    return flCurSeq ? flIdx[flCur].rec + flIdx[flCur].count : 0;
+}
+
+/*----------------------------------------------------
+  FlashLogTail()
+
+  Number of the first record the flash log does not
+  hold yet (programmed or staged), and in seq the RAM
+  log sequence of that record: where a reader hands
+  over from FlashLogRead() to LogRead().
+----------------------------------------------------*/
+u32 FlashLogTail(u32 *seq)
+{
+    *seq = flSrc;
+    return FlashLogEnd() + flStaged;
+}
+
+/*----------------------------------------------------
+  FlashLogLost()
+
+  Records the RAM log overwrote before they could be
+  stored (flash writes starved of budget).
+----------------------------------------------------*/
+u32 FlashLogLost(void)
+{
+    return flLost;
+}
@@ -0,0 +1,80 @@
+#ifndef FLASHLOG_H
+#define FLASHLOG_H
+
+#include "types.h"
+#include "logbuf.h"
+#include "logcodec.h"
+
+/*----------------------------------------------------
+  Flash log layout
+
+  FL_SECTORS 4 KB sectors used as a circular log,
+  then one journal sector. Each log sector starts with a 16-byte header (magic,
+  sequence number, erase count, check word) and ends
+  with a 16-byte trailer written with its last block
+  (first and last time, count, CRC16, check word).
+  Each FL_BLOCK in between (less the header or the
+  trailer) is one compressed block (logcodec.h),
+  staged in RAM and programmed whole once it is full.
+  A flash line takes one program only, so a block is
+  not programmed part full to save it: FL_STAGE_S
+  after its oldest record not copied yet, the staging
+  block is copied into the next FL_BLOCK slot of the
+  journal, and boot stages the newest copy again. A
+  power loss costs at most FL_STAGE_S. Only when the
+  journal is full is a block programmed part full,
+  after which the journal is erased. Staged records
+  can be read before they are programmed.
+----------------------------------------------------*/
+#define FL_FIRST_SECTOR     22
+#define FL_SECTORS          4
+#define FL_JRNL             FL_SECTORS  // Journal sector, after the log
+#define FL_SECTOR_SIZE      4096
+#define FL_BLOCK            256
+#define FL_HDR_SIZE         16
+#define FL_TRL_SIZE         16
+#define FL_TRL_OFF          (FL_SECTOR_SIZE - FL_TRL_SIZE)
+#define FL_BLOCKS           (FL_SECTOR_SIZE / FL_BLOCK)
+#define FL_MAGIC            0x33474F4C  // "LOG3": compressed blocks
+#define FL_JRNL_SLOTS       (FL_SECTOR_SIZE / FL_BLOCK)
+#define FL_STAGE_S          3600        // Longest a record waits for a copy (< 71 min)
+#define FL_SECTOR_RECS      (FL_BLOCKS * CODEC_MAX_RECS) // Most a sector holds (u16)
+
+// Worst-case CPU stall of one operation (interrupts off)
+#define FL_ERASE_MS         400
+#define FL_PROG_MS          2
+
+/*----------------------------------------------------
+  fl_index_t
+
+  RAM index entry of one sector, built at boot from
+  the header and trailer (or, for the sector being
+  filled, its last programmed block) and kept up to
+  date as blocks are programmed. crc is 0 until the
+  sector is complete.
+----------------------------------------------------*/
+typedef struct
+{
+    u32 seq;        // Header sequence, 0 = unused sector
+    u32 rec;        // Number of the first record
+    u32 first;      // Time of the first record
+    u32 last;       // Time of the last record
+    u16 count;      // Records programmed
+    u16 crc;        // CRC16 of all blocks (from the trailer)
+    u8  blocks;     // Blocks programmed
+} fl_index_t;
+
+void FlashLogInit(void);
+void FlashLogService(u32 budgetMs);
+u8 FlashLogRead(u32 recNo, log_rec_t *);
+u32 FlashLogFind(u32 time);
+u32 FlashLogFirst(void);
+u32 FlashLogEnd(void);
+u32 FlashLogTail(u32 *seq);
+const fl_index_t *FlashLogIndex(u32 sector);
+u8 FlashLogSector(u32 recNo);
+u8 FlashLogCheck(u32 sector);
+u32 FlashLogErases(u32 sector);
+u32 FlashLogLost(void);
+
+#endif
@@ -0,0 +1,183 @@
+#include "types.h"          // Custom data types
+#include "fmt.h"            // Formatter interface
+
+/*----------------------------------------------------
+  Number formatting
+
+  The ARM7 has no divide instruction: every / and %
+  by a variable is a library call of ~40 cycles, and
+  the old digit loops did both per digit. Here digits
+  come two at a time from a 200-byte table, and the
+  divisions by 10 and 100 are one long multiply by
+  the reciprocal (exact for any 32-bit value).
+----------------------------------------------------*/
+static const char fmtPairs[200] =
+    "00010203040506070809" "10111213141516171819"
+    "20212223242526272829" "30313233343536373839"
+    "40414243444546474849" "50515253545556575859"
+    "60616263646566676869" "70717273747576777879"
+    "80818283848586878889" "90919293949596979899";
+
+static u32 Div10(u32 v)
+{
+    return (u32)(((unsigned long long)v * 0xCCCCCCCDULL) >> 35);
+}
+
+static u32 Div100(u32 v)
+{
+    return (u32)(((unsigned long long)v * 0x51EB851FULL) >> 37);
+}
+
+/* Two digits of v (0..99) */
+static u8 *Pair(u8 *p, u32 v)
+{
+    p[0] = fmtPairs[2 * v];
+    p[1] = fmtPairs[2 * v + 1];
+    return p + 2;
+}
+
+/*----------------------------------------------------
+  FmtStr()
+----------------------------------------------------*/
+u8 *FmtStr(u8 *p, const char *s)
+{
+    while(*s)
+        *p++ = *s++;
+    return p;
+}
+
+/*----------------------------------------------------
+  FmtPad()
+
+  v in exactly digits digits, zero padded (v must be
+  below 10^digits).
+----------------------------------------------------*/
+u8 *FmtPad(u8 *p, u32 v, u8 digits)
+{
+    u8 *e = p + digits;
+    u32 q;
+
+    for( ; digits >= 2; digits -= 2)
+    {
+        q = Div100(v);
+        Pair(p + digits - 2, v - q * 100);
+        v = q;
+    }
+    if(digits)
+        *p = '0' + v - Div10(v) * 10;
+    return e;
+}
+
+/*----------------------------------------------------
+  FmtU32() / FmtS32()
+
+  Decimal without leading zeros.
+----------------------------------------------------*/
+u8 *FmtU32(u8 *p, u32 v)
+{
+    u8 tmp[10], *t = tmp + sizeof(tmp);
+    u32 q;
+
+    while(v >= 100)                 // Pairs from the right
+    {
+        q = Div100(v);
+        t -= 2;
+        Pair(t, v - q * 100);
+        v = q;
+    }
+    if(v >= 10)
+    {
+        t -= 2;
+        Pair(t, v);
+    }
+    else
+        *--t = '0' + v;
+
+    while(t < tmp + sizeof(tmp))
+        *p++ = *t++;
+    return p;
+}
+
+u8 *FmtS32(u8 *p, s32 v)
+{
+    if(v < 0)
+    {
+        *p++ = '-';
+        return FmtU32(p, -v);
+    }
+    return FmtU32(p, v);
+}
+
+/*----------------------------------------------------
+  FmtDeci()
+
+  Tenths with one fraction digit (305 -> "30.5").
+----------------------------------------------------*/
+u8 *FmtDeci(u8 *p, s32 deci)
+{
+    u32 mag = deci < 0 ? -deci : deci;
+    u32 ip = Div10(mag);
+
+    if(deci < 0)
+        *p++ = '-';
+    p = FmtU32(p, ip);
+    *p++ = '.';
+    *p++ = '0' + mag - ip * 10;
+    return p;
+}
+
+/*----------------------------------------------------
+  FmtF32()
+
+  Six digits after the point, truncated: the fraction
+  is scaled to millionths with one multiply and
+  printed as a fixed-point integer.
+----------------------------------------------------*/
+u8 *FmtF32(u8 *p, f32 v)
+{
+    u32 ip, frac;
+
+    if(v < 0)
+    {
+        *p++ = '-';
+        v = -v;
+    }
+    ip = v;
+    frac = (v - ip) * 1000000.0f;
+    if(frac > 999999)               // Rounding of the float multiply
+        frac = 999999;
+    p = FmtU32(p, ip);
+    *p++ = '.';
+    return FmtPad(p, frac, 6);
+}
+
+/*----------------------------------------------------
+  FmtTime() / FmtTimeMs() / FmtDate()
+
+  "hh:mm:ss", "hh:mm:ss.mmm" and "dd/mm/yyyy" from
+  RTC fields.
+----------------------------------------------------*/
+u8 *FmtTime(u8 *p, u32 hour, u32 minute, u32 second)
+{
+    p = Pair(p, hour);
+    *p++ = ':';
+    p = Pair(p, minute);
+    *p++ = ':';
+    return Pair(p, second);
+}
+
+u8 *FmtTimeMs(u8 *p, u32 hour, u32 minute, u32 second, u32 ms)
+{
+    p = FmtTime(p, hour, minute, second);
+    *p++ = '.';
+    return FmtPad(p, ms, 3);
+}
+
+u8 *FmtDate(u8 *p, u32 date, u32 month, u32 year)
+{
+    p = Pair(p, date);
+    *p++ = '/';
+    p = Pair(p, month);
+    *p++ = '/';
+    return FmtPad(p, year, 4);
+}
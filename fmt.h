@@ -0,0 +1,27 @@
+#ifndef FMT_H
+#define FMT_H
+
+#include "types.h"
+
+/*----------------------------------------------------
+  Text formatting
+
+  Each function writes at p and returns the end, so a
+  whole line is built by chaining calls into one
+  buffer and queued with a single UARTTxBuf() (or
+  copied to the LCD shadow buffer). Nothing is NUL
+  terminated.
+----------------------------------------------------*/
+#define FMT_LINE_MAX    160     // Longest text line ([STAT], 146)
+
+u8 *FmtStr(u8 *p, const char *s);
+u8 *FmtU32(u8 *p, u32 v);
+u8 *FmtS32(u8 *p, s32 v);
+u8 *FmtPad(u8 *p, u32 v, u8 digits);
+u8 *FmtDeci(u8 *p, s32 deci);
+u8 *FmtF32(u8 *p, f32 v);
+u8 *FmtTime(u8 *p, u32 hour, u32 minute, u32 second);
+u8 *FmtTimeMs(u8 *p, u32 hour, u32 minute, u32 second, u32 ms);
+u8 *FmtDate(u8 *p, u32 date, u32 month, u32 year);
+
+#endif
@@ -0,0 +1,90 @@
+#include <LPC21xx.h>        // LPC21xx register definitions
+#include "types.h"          // Custom data types
+#include "iap_defines.h"    // IAP entry and command codes
+#include "iap.h"            // IAP declarations
+
+/*----------------------------------------------------
+  IAPCall()
+
+  Calls the boot ROM. Flash can not be read while it
+  is erased or programmed, and the exception vectors
+  live in flash, so every interrupt is masked for the
+  duration and restored afterwards.
+----------------------------------------------------*/
+static u32 IAPCall(u32 *cmd)
+{
+    u32 res[5];
+    u32 irq;
+
+    irq = VICIntEnable;             // Save enabled sources
+    VICIntEnClr = 0xFFFFFFFF;
+    IAP_ENTRY(cmd, res);
+    VICIntEnable = irq;             // Restore
+
+    return res[0];
+}
+
+/*----------------------------------------------------
+  IAPPrepare() / IAPErase() / IAPBlankCheck()
+
+  Sector operations; return the IAP status code
+  (IAP_CMD_SUCCESS = 0).
+----------------------------------------------------*/
+u32 IAPPrepare(u32 first, u32 last)
+{
+    u32 cmd[5];
+
+    cmd[0] = IAP_PREPARE;
+    cmd[1] = first;
+    cmd[2] = last;
+    return IAPCall(cmd);
+}
+
+u32 IAPErase(u32 first, u32 last)
+{
+    u32 cmd[5];
+    u32 st;
+
+    if((st = IAPPrepare(first, last)) != IAP_CMD_SUCCESS)
+        return st;
+
+    cmd[0] = IAP_ERASE;
+    cmd[1] = first;
+    cmd[2] = last;
+    cmd[3] = IAP_CCLK_KHZ;
+    return IAPCall(cmd);
+}
+
+u32 IAPBlankCheck(u32 first, u32 last)
+{
+    u32 cmd[5];
+
+    cmd[0] = IAP_BLANK_CHECK;
+    cmd[1] = first;
+    cmd[2] = last;
+    return IAPCall(cmd);
+}
+
+/*----------------------------------------------------
+  IAPCopy()
+
+  Programs size bytes (256/512/1024/4096) from a
+  word-aligned RAM buffer to a 256-byte aligned flash
+  address inside one sector.
+----------------------------------------------------*/
+u32 IAPCopy(u32 dst, const void *src, u32 size)
+{
+    u32 cmd[5];
+    u32 sec, st;
+
+    sec = 22 + ((dst - FLASH_SECTOR_ADDR(22)) >> 12);   // 4 KB sectors only
+    if((st = IAPPrepare(sec, sec)) != IAP_CMD_SUCCESS)
+        return st;
+
+    cmd[0] = IAP_COPY;
+    cmd[1] = dst;
+    cmd[2] = (u32)src;
+    cmd[3] = size;
+    cmd[4] = IAP_CCLK_KHZ;
+    return IAPCall(cmd);
+}
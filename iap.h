@@ -0,0 +1,11 @@
+#ifndef IAP_H
+#define IAP_H
+
+#include "types.h"
+
+u32 IAPPrepare(u32 first, u32 last);
+u32 IAPErase(u32 first, u32 last);
+u32 IAPCopy(u32 dst, const void *src, u32 size);
+u32 IAPBlankCheck(u32 first, u32 last);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef IAP_DEFINES_H
+#define IAP_DEFINES_H
+
+#include "types.h"
+
+// IAP entry (Thumb) in the boot block; the host build
+// maps both of these onto its flash model
+#ifndef IAP_ENTRY
+#define IAP_ENTRY ((void (*)(u32 *, u32 *))0x7FFFFFF1)
+#endif
+#ifndef FLASH_BASE_PTR
+#define FLASH_BASE_PTR ((const u8 *)0)
+#endif
+
+// IAP commands
+#define IAP_PREPARE      50
+#define IAP_COPY         51
+#define IAP_ERASE        52
+#define IAP_BLANK_CHECK  53
+
+#define IAP_CMD_SUCCESS  0
+
+#define IAP_CCLK_KHZ     60000   // CCLK for erase/program timing
+
+// LPC2148: sectors 22..26 are the 4 KB ones below the boot block
+#define FLASH_SECTOR_ADDR(n) (0x78000 + ((n) - 22) * 0x1000)
+
+#endif
@@ -3,3 +3,14 @@ void KeyPdInit(void);
 u8 ColStat(void);
 u8 KeyVal(void);
 
+// Events from the Timer1 scan: KEY_EVENT(ev) | key value (0..15)
+#define KEY_PRESS    0x40
+#define KEY_RELEASE  0x80
+#define KEY_LONG     0xC0
+#define KEY_EVENT(ev) ((ev) & 0xC0)
+#define KEY_CODE(ev)  ((ev) & 0x0F)
+
+void KeyScanInit(void);
+u8 KeyGetEvent(u8 *);
+u32 KeyEventsDropped(void);
+
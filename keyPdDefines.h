@@ -8,6 +8,12 @@
 #define C1 21
 #define C2 22
 #define C3 23//p1.23
+
+// Timer1 matrix scan
+#define KEY_SCAN_US        5000  // scan period (5 ms)
+#define KEY_DEBOUNCE_SCANS 4     // stable scans before a change counts (20 ms)
+#define KEY_LONG_SCANS     160   // held scans before KEY_LONG (800 ms)
+#define KEY_QUEUE_SIZE     16    // event queue (power of 2)
 u8 LUT[][4]={0,1,2,3,
 	           4,5,6,7,
 						 8,9,10,11,
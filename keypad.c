@@ -1,5 +1,7 @@
 #include <LPC21xx.h>        // LPC21xx register definitions
-#include "KeyPdDefines.h"   // Row, Column and LUT definitions
+#include "keyPdDefines.h"   // Row, Column and LUT definitions
+#include "timer_defines.h"  // Timer1 scan timing
+#include "keyPd.h"          // Key event codes
 
 /*----------------------------------------------------
   KeyPdInit()
@@ -104,4 +106,170 @@ colcheck:
 
     // Return key value using Look-Up Table
     return (LUT[row_val][col_val]);
+}
+
+
+/*----------------------------------------------------
+  Timer1 matrix scan
+
+  Every KEY_SCAN_US the ISR drives each row low in
+  turn and reads the columns into a 16-bit map
+  (bit n = key value n). Each key has its own
+  debounce counter; debounced presses, releases and
+  long presses go into keyQ for the UI.
+
+  The ISR is the only writer of keyQHead and
+  KeyGetEvent() the only writer of keyQTail, so the
+  queue needs no locking.
+
+  ColStat()/KeyVal() drive the same rows and must not
+  be used once the scan is running.
+----------------------------------------------------*/
+#define ALL_ROWS ((1<<R0)|(1<<R1)|(1<<R2)|(1<<R3))
+
+static volatile u8 keyQ[KEY_QUEUE_SIZE];
+static volatile u8 keyQHead = 0, keyQTail = 0;
+static volatile u32 keyQDropped = 0;
+
+static u16 keyState = 0;    // Debounced key map
+static u16 keyPend = 0;     // Keys with a debounce count running
+static u8 keyCnt[16];       // Scans the raw state has differed
+static u16 keyHeld[16];     // Scans held since the press
+
+/*----------------------------------------------------
+  KeyQPut()
+
+  Queues one event; drops it if the queue is full.
+----------------------------------------------------*/
+static void KeyQPut(u8 ev)
+{
+    u8 next = (keyQHead + 1) & (KEY_QUEUE_SIZE - 1);
+
+    if (next == keyQTail)
+    {
+        keyQDropped++;
+        return;
+    }
+    keyQ[keyQHead] = ev;
+    keyQHead = next;
+}
+
+/*----------------------------------------------------
+  KeyScanMatrix()
+
+  Raw state of all 16 keys, bit n set = key value n
+  pressed. Leaves all rows LOW.
+----------------------------------------------------*/
+static u16 KeyScanMatrix(void)
+{
+    u16 map = 0;
+    u8 r, c, cols;
+
+    for (r = 0; r < 4; r++)
+    {
+        IOSET1 = ALL_ROWS;              // All rows HIGH
+        IOCLR1 = (1<<(R0+r));           // Drive row r LOW
+        cols = (IOPIN1 >> C0) & 0x0F;   // Pressed column reads LOW
+
+        for (c = 0; c < 4; c++)
+            if (((cols >> c) & 1) == 0)
+                map |= (1<<LUT[r][c]);
+    }
+    IOCLR1 = ALL_ROWS;                  // Back to idle (rows LOW)
+
+    return map;
+}
+
+/*----------------------------------------------------
+  Timer1_ISR()
+
+  Scan tick: debounce every key and queue events.
+----------------------------------------------------*/
+void Timer1_ISR(void) __irq
+{
+    u16 raw = KeyScanMatrix();
+    u16 bit;
+    u8 k;
+
+    // Nothing pressed, nothing pending: the common case
+    if ((raw | keyState | keyPend) != 0)
+    {
+        for (k = 0; k < 16; k++)
+        {
+            bit = (1<<k);
+            if ((raw ^ keyState) & bit)         // Differs from debounced
+            {
+                keyPend |= bit;
+                if (++keyCnt[k] >= KEY_DEBOUNCE_SCANS)
+                {
+                    keyState ^= bit;            // Accept the change
+                    keyPend &= ~bit;
+                    keyCnt[k] = 0;
+                    keyHeld[k] = 0;
+                    KeyQPut(((keyState & bit) ? KEY_PRESS : KEY_RELEASE) | k);
+                }
+            }
+            else
+            {
+                keyPend &= ~bit;                // Bounce, start over
+                keyCnt[k] = 0;
+                if ((keyState & bit) && keyHeld[k] < KEY_LONG_SCANS)
+                    if (++keyHeld[k] == KEY_LONG_SCANS)
+                        KeyQPut(KEY_LONG | k);
+            }
+        }
+    }
+
+    T1IR = IR_MR0;          // Clear MR0 interrupt flag
+    VICVectAddr = 0;        // End of interrupt
+}
+
+/*----------------------------------------------------
+  KeyScanInit()
+
+  Keypad pins plus Timer1 at 1 MHz, reset and
+  interrupt on MR0 every KEY_SCAN_US.
+----------------------------------------------------*/
+void KeyScanInit(void)
+{
+    KeyPdInit();
+
+    T1TCR = TCR_RESET;              // Stop and reset
+    T1PR  = T0_PR_VAL;              // PCLK / 15 = 1 MHz
+    T1MR0 = KEY_SCAN_US - 1;        // TC resets after the match count
+    T1MCR = MCR_MR0I | MCR_MR0R;
+    T1IR  = 0xFF;                   // Clear pending flags
+
+    VICIntSelect &= ~(1<<TIMER1_VIC_CHNO);
+    VICVectAddr2 = (u32)Timer1_ISR;
+    VICVectCntl2 = (1<<5) | TIMER1_VIC_CHNO;
+    VICIntEnable = (1<<TIMER1_VIC_CHNO);
+
+    T1TCR = TCR_ENABLE;             // Start scanning
+}
+
+/*----------------------------------------------------
+  KeyGetEvent()
+
+  Takes the oldest key event. Returns 0 when the
+  queue is empty.
+----------------------------------------------------*/
+u8 KeyGetEvent(u8 *ev)
+{
+    if (keyQTail == keyQHead)
+        return 0;
+
+    *ev = keyQ[keyQTail];
+    keyQTail = (keyQTail + 1) & (KEY_QUEUE_SIZE - 1);
+    return 1;
+}
+
+/*----------------------------------------------------
+  KeyEventsDropped()
+
+  Events lost to a full queue.
+----------------------------------------------------*/
+u32 KeyEventsDropped(void)
+{
+    return keyQDropped;
 }
\ No newline at end of file
@@ -1,13 +1,93 @@
 #include <LPC21xx.h>   // LPC21xx register definitions
-#include "delay.h"     // delay_ms function
+#include "delay.h"     // delay_ms function, deadline_t
 #include "types.h"     // Custom data types (u8, s32 etc.)
-#include "macros.h"    // WRITEBYTE macro
 #include "lcd.h"       // LCD function declarations
+#include "fmt.h"       // Number formatting
 
 #define LCD_DAT 0xFF   // LCD data lines connected to P0.16  P0.23
 #define RS  12         // P0.12 ? Register Select
 #define RW  13         // P0.13 ? Read/Write
 #define EN  14         // P0.14 ? Enable
+#define BF  23         // P0.23 = D7 ? Busy flag when reading
+
+// Data bus write through the set/clear registers: a
+// read-modify-write of IOPIN0 would also rewrite the
+// other P0 outputs (the buzzer is driven from the
+// sampler interrupt)
+#define BUS_LCD(v)  (IOCLR0 = (u32)(~(v) & LCD_DAT) << 16, \
+                     IOSET0 = (u32)((v) & LCD_DAT) << 16)
+
+/*----------------------------------------------------
+  LCD_BUSY_POLL
+
+  1 -> wait on the HD44780 busy flag (RW must be wired)
+  0 -> fixed 2 ms + 5 ms delay around every byte
+  If the busy flag never clears within
+  LCD_BUSY_TIMEOUT_US the driver falls back to the
+  fixed delays for good.
+----------------------------------------------------*/
+#ifndef LCD_BUSY_POLL
+#define LCD_BUSY_POLL 1
+#endif
+#define LCD_BUSY_TIMEOUT_US 3000
+
+#if LCD_BUSY_POLL
+static u8 lcdNoBusy = 0;        // busy flag unusable, use fixed delays
+#endif
+
+/*----------------------------------------------------
+  Shadow framebuffer
+
+  lcdFb holds what the display code wants on the
+  2x16 panel, lcdShown what has actually been sent.
+  FlushLCD() transfers only the cells that differ.
+  Direct writes (CharLCD into DDRAM) make lcdShown
+  unknown, so the next flush repaints every cell.
+----------------------------------------------------*/
+static u8 lcdFb[2][16];
+static u8 lcdShown[2][16];
+static u8 lcdShownValid = 0;
+static u8 lcdCgMode = 0;        // address counter points into CGRAM
+static u8 fbRow = 0, fbCol = 0; // buffered write position
+
+/*----------------------------------------------------
+  Custom glyph registry
+
+  One 5x8 pattern per CGRAM slot, uploaded once by
+  InitLCD(). Display code only writes the slot number
+  (GLYPH_xxx in lcd.h); lcdGlyphRes has a bit set for
+  every slot whose pattern is loaded in the panel.
+----------------------------------------------------*/
+static const u8 lcdGlyphs[8][8] =
+{
+    {0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x10},   // 0: bar, 1 column
+    {0x07,0x05,0x07,0x00,0x00,0x00,0x00,0x00},   // 1: degree
+    {0x04,0x0E,0x0E,0x0E,0x1F,0x00,0x04,0x00},   // 2: alarm bell
+    {0x04,0x0E,0x15,0x04,0x04,0x04,0x04,0x00},   // 3: trend up
+    {0x04,0x04,0x04,0x04,0x15,0x0E,0x04,0x00},   // 4: trend down
+    {0x18,0x18,0x18,0x18,0x18,0x18,0x18,0x18},   // 5: bar, 2 columns
+    {0x1C,0x1C,0x1C,0x1C,0x1C,0x1C,0x1C,0x1C},   // 6: bar, 3 columns
+    {0x1E,0x1E,0x1E,0x1E,0x1E,0x1E,0x1E,0x1E}    // 7: bar, 4 columns
+};
+static u8 lcdGlyphRes = 0;      // bit n = CGRAM slot n loaded
+
+/*----------------------------------------------------
+  ResetCmdLCD()
+
+  Writes a command of the power-on reset sequence.
+  The busy flag cannot be read until the function
+  set is done, so these use the datasheet delays
+  only and never poll.
+----------------------------------------------------*/
+static void ResetCmdLCD(u8 cmd, u32 waitMs)
+{
+    IOCLR0 = (1<<RS) | (1<<RW);   // Instruction, write
+    BUS_LCD(cmd);
+    IOSET0 = (1<<EN);
+    delay_us(1);                  // Enable pulse width (>= 450 ns)
+    IOCLR0 = (1<<EN);
+    delay_ms(waitMs);
+}
 
 /*----------------------------------------------------
   InitLCD()
@@ -19,23 +99,25 @@ void InitLCD(void)
     // Configure LCD pins as output
     IODIR0 |= ((LCD_DAT << 16) | (1<<RS) | (1<<RW) | (1<<EN));
 
-    delay_ms(20);       // Initial LCD power-on delay
+    delay_ms(20);       // Initial LCD power-on delay (> 15 ms)
 
     // LCD initialization sequence (8-bit mode)
-    CmdLCD(0x30);
-    delay_ms(5);
-
-    CmdLCD(0x30);
-    delay_ms(1);
-
-    CmdLCD(0x30);
-    delay_ms(1);
+    ResetCmdLCD(0x30, 5);   // > 4.1 ms
+    ResetCmdLCD(0x30, 1);   // > 100 us
+    ResetCmdLCD(0x30, 1);
+    ResetCmdLCD(0x38, 1);   // 8-bit mode, 2 lines, 5x7 matrix
 
-    CmdLCD(0x38);  // 8-bit mode, 2 lines, 5x7 matrix
+#if LCD_BUSY_POLL
+    lcdNoBusy = 0;          // Busy flag readable from here on
+#endif
     CmdLCD(0x10);  // Cursor move
     CmdLCD(0x01);  // Clear display
     CmdLCD(0x06);  // Entry mode (increment cursor)
     CmdLCD(0x0F);  // Display ON, cursor ON, blinking ON
+
+    lcdGlyphRes = 0;   // CGRAM content is undefined after power-up
+    LoadGlyphsLCD();   // Upload all custom characters once
+    ClearFbLCD();      // Shadow buffer starts blank
 }
 
 /*----------------------------------------------------
@@ -46,8 +128,24 @@ void InitLCD(void)
 ----------------------------------------------------*/
 void CmdLCD(u8 cmd)
 {
+    u8 r, c;
+
     IOCLR0 = (1<<RS);   // RS = 0 (command mode)
     DispLCD(cmd);       // Send command
+
+    // Keep track of the panel state for the shadow buffer
+    if ((cmd & 0xC0) == 0x40)
+        lcdCgMode = 1;          // Set CGRAM address
+    else if (cmd >= 0x80 || cmd == 0x01 || cmd == 0x02 || cmd == 0x03)
+        lcdCgMode = 0;          // Set DDRAM address / clear / home
+
+    if (cmd == 0x01)            // Clear: panel is known to be blank
+    {
+        for (r = 0; r < 2; r++)
+            for (c = 0; c < 16; c++)
+                lcdShown[r][c] = ' ';
+        lcdShownValid = 1;
+    }
 }
 
 /*----------------------------------------------------
@@ -57,17 +155,72 @@ void CmdLCD(u8 cmd)
 ----------------------------------------------------*/
 void DispLCD(u8 val)
 {
+#if LCD_BUSY_POLL
+    if (!lcdNoBusy)
+        WaitBusyLCD();        // Returns as soon as the LCD is ready
+#endif
+
     IOCLR0 = (1<<RW);         // RW = 0 (Write mode)
 
-    WRITEBYTE(IOPIN0,16,val); // Send 8-bit data to P0.16P0.23
+    BUS_LCD(val);             // Send 8-bit data to P0.16P0.23
 
     IOSET0 = (1<<EN);         // Enable = 1
+
+#if LCD_BUSY_POLL
+    if (!lcdNoBusy)
+    {
+        delay_us(1);          // Enable pulse width (>= 450 ns)
+        IOCLR0 = (1<<EN);     // Enable = 0 (Latch data)
+        return;               // Next byte polls the busy flag
+    }
+#endif
+
     delay_ms(2);
 
     IOCLR0 = (1<<EN);         // Enable = 0 (Latch data)
     delay_ms(5);
 }
 
+#if LCD_BUSY_POLL
+/*----------------------------------------------------
+  WaitBusyLCD()
+
+  Reads the busy flag (D7 with RS = 0, RW = 1) until
+  the controller is ready. RS is restored for the
+  byte that follows. On timeout the driver switches
+  to the fixed delays.
+----------------------------------------------------*/
+void WaitBusyLCD(void)
+{
+    u32 rs = IOPIN0 & (1<<RS);    // Register select wanted by caller
+    deadline_t timeout;
+    u8 busy;
+
+    IODIR0 &= ~(LCD_DAT << 16);   // Data lines as input
+    IOCLR0 = (1<<RS);             // Instruction register
+    IOSET0 = (1<<RW);             // RW = 1 (Read mode)
+
+    DeadlineSetUs(&timeout, LCD_BUSY_TIMEOUT_US);
+    do
+    {
+        IOSET0 = (1<<EN);
+        delay_us(1);              // Data valid after tDDR
+        busy = (IOPIN0 >> BF) & 1;
+        IOCLR0 = (1<<EN);
+    } while (busy && !DeadlineExpired(&timeout));
+
+    IOCLR0 = (1<<RW);             // Back to write mode
+    IODIR0 |= (LCD_DAT << 16);    // Data lines as output
+    IOSET0 = rs;
+
+    if (busy)
+    {
+        lcdNoBusy = 1;            // No answer: use fixed delays
+        delay_ms(5);
+    }
+}
+#endif
+
 /*----------------------------------------------------
   CharLCD()
 
@@ -78,6 +231,9 @@ void CharLCD(u8 dat)
 {
     IOSET0 = (1<<RS);   // RS = 1 (data mode)
     DispLCD(dat);       // Send character
+
+    if (!lcdCgMode)
+        lcdShownValid = 0;  // DDRAM changed behind the shadow buffer
 }
 
 /*----------------------------------------------------
@@ -98,30 +254,10 @@ void StrLCD(u8 *ptr)
 ----------------------------------------------------*/
 void IntLCD(s32 num)
 {
-    u8 a[10];   // Temporary array to store digits
-    s8 i = 0;
-
-    if(num == 0)
-        CharLCD('0');
-    else
-    {
-        if(num < 0)
-        {
-            num = -num;
-            CharLCD('-');
-        }
-
-        // Convert number to ASCII (reverse order)
-        while(num > 0)
-        {
-            a[i++] = (num % 10) + 48;
-            num = num / 10;
-        }
+    u8 a[11], *p, *e = FmtS32(a, num);
 
-        // Print digits in correct order
-        for(--i; i >= 0; i--)
-            CharLCD(a[i]);
-    }
+    for(p = a; p < e; p++)
+        CharLCD(*p);
 }
 
 /*----------------------------------------------------
@@ -140,4 +276,213 @@ void Degree(void)
     {
         CharLCD(a[i]);
     }
+}
+
+/*----------------------------------------------------
+  FbPosLCD()
+
+  Sets the buffered write position using the same
+  DDRAM address command as CmdLCD (0x80 = line 1,
+  0xC0 = line 2, plus column).
+----------------------------------------------------*/
+void FbPosLCD(u8 pos)
+{
+    fbRow = (pos & 0x40) ? 1 : 0;
+    fbCol = pos & 0x0F;
+}
+
+/*----------------------------------------------------
+  FbCharLCD()
+
+  Writes one character into the shadow buffer.
+  Characters past column 15 are dropped.
+----------------------------------------------------*/
+void FbCharLCD(u8 dat)
+{
+    if (fbCol < 16)
+        lcdFb[fbRow][fbCol++] = dat;
+}
+
+/*----------------------------------------------------
+  FbStrLCD()
+
+  Writes a string into the shadow buffer.
+----------------------------------------------------*/
+void FbStrLCD(u8 *ptr)
+{
+    while(*ptr != '\0')
+        FbCharLCD(*ptr++);
+}
+
+/*----------------------------------------------------
+  FbBufLCD()
+
+  Writes len characters (formatted with fmt.c) into
+  the shadow buffer.
+----------------------------------------------------*/
+void FbBufLCD(const u8 *buf, u32 len)
+{
+    while(len--)
+        FbCharLCD(*buf++);
+}
+
+/*----------------------------------------------------
+  FbIntLCD()
+
+  Writes a signed integer into the shadow buffer.
+----------------------------------------------------*/
+void FbIntLCD(s32 num)
+{
+    u8 a[11];
+
+    FbBufLCD(a, FmtS32(a, num) - a);
+}
+
+/*----------------------------------------------------
+  FlushLCD()
+
+  Sends the cells of the shadow buffer that differ
+  from the panel. Each run of changed cells costs one
+  cursor command plus one data write per cell.
+----------------------------------------------------*/
+void FlushLCD(void)
+{
+    u8 r, c;
+
+    for (r = 0; r < 2; r++)
+    {
+        c = 0;
+        while (c < 16)
+        {
+            if (lcdShownValid && lcdFb[r][c] == lcdShown[r][c])
+            {
+                c++;
+                continue;
+            }
+
+            CmdLCD((r ? 0xC0 : 0x80) + c);   // start of a dirty run
+            while (c < 16 && !(lcdShownValid && lcdFb[r][c] == lcdShown[r][c]))
+            {
+                IOSET0 = (1<<RS);
+                DispLCD(lcdFb[r][c]);
+                lcdShown[r][c] = lcdFb[r][c];
+                c++;
+            }
+        }
+    }
+    lcdShownValid = 1;
+}
+
+/*----------------------------------------------------
+  FbDeciLCD()
+
+  Writes tenths (305 -> "30.5") right-aligned in a
+  field of width cells. The tenth is dropped when the
+  value would not fit otherwise.
+----------------------------------------------------*/
+void FbDeciLCD(s32 deci, u8 width)
+{
+    u32 mag = deci < 0 ? -deci : deci;
+    u8 a[13], *p = a, *e;
+
+    if(deci < 0)
+        *p++ = '-';
+    e = FmtDeci(p, mag);
+    if(e - a > width)               // Round to whole degrees
+        e = FmtU32(p, (mag + 5) / 10);
+    for(p = a + width; p > e; p--)
+        FbCharLCD(' ');
+    FbBufLCD(a, e - a);
+}
+
+/*----------------------------------------------------
+  ClearFbLCD()
+
+  Blanks the shadow buffer (panel updates on flush).
+----------------------------------------------------*/
+void ClearFbLCD(void)
+{
+    u8 r, c;
+
+    for (r = 0; r < 2; r++)
+        for (c = 0; c < 16; c++)
+            lcdFb[r][c] = ' ';
+}
+
+/*----------------------------------------------------
+  LoadGlyphsLCD()
+
+  Uploads every registry glyph in one CGRAM pass
+  (address auto-increments over the 64 bytes).
+----------------------------------------------------*/
+void LoadGlyphsLCD(void)
+{
+    u8 g, r;
+
+    CmdLCD(0x40);               // CGRAM address 0
+    for (g = 0; g < 8; g++)
+        for (r = 0; r < 8; r++)
+            CharLCD(lcdGlyphs[g][r]);
+    CmdLCD(0x80);               // Back to DDRAM
+    lcdGlyphRes = 0xFF;
+}
+
+/*----------------------------------------------------
+  GlyphLCD()
+
+  Returns the character code for a registry glyph,
+  uploading its pattern first if the slot is not
+  resident.
+----------------------------------------------------*/
+u8 GlyphLCD(u8 slot)
+{
+    u8 r;
+
+    slot &= 7;
+    if (!(lcdGlyphRes & (1 << slot)))
+    {
+        CmdLCD(0x40 | (slot << 3));
+        for (r = 0; r < 8; r++)
+            CharLCD(lcdGlyphs[slot][r]);
+        CmdLCD(0x80);
+        lcdGlyphRes |= (1 << slot);
+    }
+    return slot;
+}
+
+/*----------------------------------------------------
+  FbBarLCD()
+
+  Draws a horizontal bar graph into the shadow buffer
+  at pos, cells characters wide, filled in proportion
+  value / max with 5 steps per character.
+----------------------------------------------------*/
+void FbBarLCD(u8 pos, u8 cells, u32 value, u32 max)
+{
+    static const u8 part[4] = {GLYPH_BAR1, GLYPH_BAR2, GLYPH_BAR3, GLYPH_BAR4};
+    u32 cols;
+    u8 i;
+
+    if (max == 0)
+        max = 1;
+    if (value > max)
+        value = max;
+    cols = (value * cells * 5) / max;   // filled pixel columns
+
+    FbPosLCD(pos);
+    for (i = 0; i < cells; i++)
+    {
+        if (cols >= 5)
+        {
+            FbCharLCD(0xFF);            // ROM full block
+            cols -= 5;
+        }
+        else if (cols > 0)
+        {
+            FbCharLCD(part[cols - 1]);
+            cols = 0;
+        }
+        else
+            FbCharLCD(' ');
+    }
 }
\ No newline at end of file
@@ -2,7 +2,32 @@
 void InitLCD(void);
 void CmdLCD(u8 cmd);
 void DispLCD(u8 val);
+void WaitBusyLCD(void);
 void CharLCD(u8 dat);
 void StrLCD(u8 *ptr);
 void IntLCD(s32 num);
 void Degree(void);
+
+// Shadow framebuffer (see FlushLCD)
+void FbPosLCD(u8 pos);
+void FbCharLCD(u8 dat);
+void FbStrLCD(u8 *ptr);
+void FbBufLCD(const u8 *buf, u32 len);
+void FbIntLCD(s32 num);
+void FbDeciLCD(s32 deci, u8 width);
+void FlushLCD(void);
+void ClearFbLCD(void);
+
+// Custom glyphs (CGRAM slot = character code)
+#define GLYPH_BAR1    0
+#define GLYPH_DEGREE  1
+#define GLYPH_BELL    2
+#define GLYPH_UP      3
+#define GLYPH_DOWN    4
+#define GLYPH_BAR2    5
+#define GLYPH_BAR3    6
+#define GLYPH_BAR4    7
+
+void LoadGlyphsLCD(void);
+u8 GlyphLCD(u8 slot);
+void FbBarLCD(u8 pos, u8 cells, u32 value, u32 max);
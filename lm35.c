@@ -1,6 +1,88 @@
 #include "adc.h"          // ADC function declarations
 #include "types.h"        // Custom data types (u32, f32, u8 etc.)
 #include "adc_defines.h"  // ADC channel definitions
+#include "lm35_defines.h" // Fixed-point constants
+#include "lm35.h"         // LM35 declarations
+#include "filter.h"       // Filter stage ahead of the conversion
+
+/*----------------------------------------------------
+  Per-channel calibration
+
+  Applied after the nominal conversion:
+    deci = deci * gain / 1.0 + offset
+  gain in Q16, offset in deci-degrees C.
+----------------------------------------------------*/
+static s32 lm35Gain[LM35_CHANNELS] =
+{
+    LM35_CAL_UNITY, LM35_CAL_UNITY, LM35_CAL_UNITY, LM35_CAL_UNITY
+};
+static s32 lm35Offset[LM35_CHANNELS];
+
+/*----------------------------------------------------
+  LM35SetCal()
+
+  Sets gain (Q16) and offset (deci-C) of a channel.
+----------------------------------------------------*/
+void LM35SetCal(u32 ch, s32 gainQ16, s32 offsetDeci)
+{
+    if(ch >= LM35_CHANNELS)
+        return;
+    lm35Gain[ch] = gainQ16;
+    lm35Offset[ch] = offsetDeci;
+}
+
+/*----------------------------------------------------
+  LM35Deci()
+
+  Raw ADC counts -> signed tenths of a degree, all
+  in integer arithmetic (no soft-float).
+
+  Parameter:
+    counts -> ADC result (0-1023)
+    ch     -> channel, selects the calibration
+    tType  -> 'C' or 'F'
+----------------------------------------------------*/
+s32 LM35Deci(u32 counts, u32 ch, u8 tType)
+{
+    return LM35DeciFrac(counts, 0, ch, tType);
+}
+
+/*----------------------------------------------------
+  LM35DeciFrac()
+
+  As LM35Deci() for counts with frac extra fraction
+  bits (the Q4 output of FilterRead, frac <= 4).
+----------------------------------------------------*/
+s32 LM35DeciFrac(u32 counts, u8 frac, u32 ch, u8 tType)
+{
+    s32 deci;
+
+    // Nominal: counts * 3300/1023, rounded (max 3300); unsigned, fits for frac <= 4
+    deci = (s32)((counts * LM35_DECI_PER_COUNT + (LM35_ROUND << frac)) >> (LM35_Q + frac));
+
+    // Calibration; with gain < 4.0 both products stay below 2^31
+    if(ch < LM35_CHANNELS)
+        deci = ((deci * lm35Gain[ch] + LM35_ROUND) >> LM35_Q) + lm35Offset[ch];
+
+    // F = C * 9/5 + 32
+    if(tType == 'F')
+        deci = ((deci * LM35_F_PER_C + LM35_ROUND) >> LM35_Q) + LM35_F_OFFSET;
+
+    return deci;
+}
+
+/*----------------------------------------------------
+  Read_LM35_Deci()
+
+  Temperature of an LM35 on channel ch in tenths of
+  a degree ('C' or 'F'), after the filter selected
+  with FilterSet().
+----------------------------------------------------*/
+s32 Read_LM35_Deci(u32 ch, u8 tType)
+{
+    // Raw counts through the channel's filter (filter.c)
+    return LM35DeciFrac(FilterRead(ch), FILT_FRAC_BITS, ch, tType);
+}
 
 /*----------------------------------------------------
   Read_LM35()
@@ -13,37 +95,14 @@
 
   Returns:
     Temperature value (integer format)
+
+  Uses the fixed-point path; see Read_LM35_Deci()
+  for tenths of a degree and other channels.
 ----------------------------------------------------*/
 u32 Read_LM35(u8 tType)
 {
-    u32 adcDVal;      // Stores raw ADC digital value
-    f32 eAR, tDeg;    // eAR = analog voltage (in volts)
-                      // tDeg = temperature in degrees
-
-    // Read ADC channel CH0
-    // eAR  -> equivalent analog voltage
-    // adcDVal -> raw ADC digital value
-    Read_ADC(CH0, &eAR, &adcDVal);
-    
-    // LM35 gives 10mV per degree Celsius
-    // If voltage = 0.30V -> temperature = 30C
-    // So temperature = voltage * 100
-    tDeg = eAR * 100;
-
-    // If temperature type is Celsius
-    if(tType == 'C')
-    {
-        // Do nothing (already in Celsius)
-    }
-
-    // If temperature type is Fahrenheit
-    else if(tType == 'F')
-    {
-        // Convert Celsius to Fahrenheit
-        // Formula: F = (C  9/5) + 32
-        tDeg = ((tDeg * (9/5.0)) + 32);
-    }
-
-    // Return temperature value (converted to integer automatically)
-    return tDeg;
+    s32 deci = Read_LM35_Deci(CH0, tType);
+
+    // Whole degrees, truncated as before; below zero reads 0
+    return deci > 0 ? deci / 10 : 0;
 }
\ No newline at end of file
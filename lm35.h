@@ -1,4 +1,8 @@
 #include"types.h"
 //void Read_LM35(f32 *tdegC,f32 *tdegF);
 u32 Read_LM35(u8 tType);
+s32 Read_LM35_Deci(u32 ch, u8 tType);
+s32 LM35Deci(u32 counts, u32 ch, u8 tType);
+s32 LM35DeciFrac(u32 counts, u8 frac, u32 ch, u8 tType);
+void LM35SetCal(u32 ch, s32 gainQ16, s32 offsetDeci);
 //f32 Read_LM35_NP(u8 tType);
@@ -0,0 +1,17 @@
+#ifndef LM35_DEFINES_H
+#define LM35_DEFINES_H
+
+// Fixed-point LM35 conversion (see lm35.c)
+//   10 mV/C, Vref 3.3 V, 10-bit ADC:
+//   deci-C = counts * 3300 / 1023 = counts * 3.2258
+#define LM35_Q               16
+#define LM35_ROUND           (1L << (LM35_Q-1))
+#define LM35_DECI_PER_COUNT  211406L   // 3300/1023 in Q16
+#define LM35_F_PER_C         117965L   // 9/5 in Q16
+#define LM35_F_OFFSET        320       // 32.0 F in deci-degrees
+
+// Calibration: gain in Q16 (LM35_CAL_UNITY = 1.0), offset in deci-C
+#define LM35_CAL_UNITY       65536L
+#define LM35_CHANNELS        4
+
+#endif
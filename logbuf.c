@@ -0,0 +1,127 @@
+#include "types.h"          // Custom data types
+#include "logbuf.h"         // Record format and ring size
+
+/*----------------------------------------------------
+  RAM log ring
+
+  Records are numbered by a sequence number that only
+  grows: record seq lives in slot seq % LOG_RING_RECS
+  and stays readable until LOG_RING_RECS newer ones
+  have been written. Each consumer (UART text, dump,
+  statistics) keeps its own sequence cursor.
+
+  Slots hold the packed LOG_REC_BYTES form, so the
+  ms stamp costs no RAM; LogRead() unpacks.
+
+  Appends come from the sampler interrupt; readers
+  are tasks and check after copying that the slot
+  was not reused meanwhile (LogRead()).
+----------------------------------------------------*/
+static u8 logRing[LOG_RING_RECS][LOG_REC_BYTES];
+static volatile u32 logHead = 0;    // Next sequence number (write cursor, ISR)
+static volatile u32 logLost = 0;    // Records overwritten by wrap-around
+
+/*----------------------------------------------------
+  LogInit()
+
+  Empties the ring and clears the statistics.
+----------------------------------------------------*/
+void LogInit(void)
+{
+    logHead = 0;
+    logLost = 0;
+}
+
+/*----------------------------------------------------
+  LogAppend()
+
+  Stores a record, overwriting the oldest once the
+  ring is full. Returns its sequence number.
+----------------------------------------------------*/
+u32 LogAppend(const log_rec_t *r)
+{
+    if(logHead >= LOG_RING_RECS)
+        logLost++;                  // Oldest one goes
+
+    LogPack(r, logRing[logHead & (LOG_RING_RECS-1)]);
+    return logHead++;
+}
+
+/*----------------------------------------------------
+  LogRead()
+
+  Copies record seq. Returns 0 if it is not there,
+  or was overwritten while it was being copied.
+----------------------------------------------------*/
+u8 LogRead(u32 seq, log_rec_t *r)
+{
+    if(seq >= logHead || seq < LogOldest())
+        return 0;
+
+    LogUnpack(logRing[seq & (LOG_RING_RECS-1)], r);
+    return seq >= LogOldest();
+}
+
+/*----------------------------------------------------
+  LogHead() / LogOldest() / LogOverwritten()
+
+  Write cursor (next sequence number), oldest record
+  still held, and records lost to wrap-around.
+----------------------------------------------------*/
+u32 LogHead(void)
+{
+    return logHead;
+}
+
+u32 LogOldest(void)
+{
+    u32 head = logHead;             // One read: the ISR may append
+
+    return head > LOG_RING_RECS ? head - LOG_RING_RECS : 0;
+}
+
+u32 LogOverwritten(void)
+{
+    return logLost;
+}
+
+/*----------------------------------------------------
+  LogPack() / LogUnpack()
+
+  Record <-> LOG_REC_BYTES little-endian bytes, the
+  layout used in flash and on the wire (independent
+  of the compiler's struct layout).
+----------------------------------------------------*/
+void LogPack(const log_rec_t *r, u8 *b)
+{
+    s32 v = r->value;
+    u32 w;
+
+    if(v > LOG_VALUE_MAX)           // Saturate to 13 bits
+        v = LOG_VALUE_MAX;
+    else if(v < LOG_VALUE_MIN)
+        v = LOG_VALUE_MIN;
+    w = ((u32)v & 0x1FFF) | ((u32)r->ms << 13) |
+        ((u32)(r->ch & 0x07) << 23) | ((u32)((r->ch >> 4) & 0x07) << 26) |
+        ((u32)(r->flags & 0x07) << 29);
+
+    b[0] = r->time;
+    b[1] = r->time >> 8;
+    b[2] = r->time >> 16;
+    b[3] = r->time >> 24;
+    b[4] = w;
+    b[5] = w >> 8;
+    b[6] = w >> 16;
+    b[7] = w >> 24;
+}
+
+void LogUnpack(const u8 *b, log_rec_t *r)
+{
+    u32 w = b[4] | ((u32)b[5] << 8) | ((u32)b[6] << 16) | ((u32)b[7] << 24);
+
+    r->time  = b[0] | ((u32)b[1] << 8) | ((u32)b[2] << 16) | ((u32)b[3] << 24);
+    r->value = (s16)((w & 0x1FFF) | ((w & 0x1000) ? 0xE000 : 0));
+    r->ms    = (w >> 13) & 0x3FF;
+    r->ch    = ((w >> 23) & 0x07) | (((w >> 26) & 0x07) << 4);
+    r->flags = (w >> 29) & 0x07;
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#ifndef LOGBUF_H
+#define LOGBUF_H
+
+#include "types.h"
+
+/*----------------------------------------------------
+  log_rec_t
+
+  One log record. time is seconds since
+  RTC_EPOCH_YEAR and ms the milliseconds into that
+  second (RTCStampMs()); value is in tenths of a
+  degree C. Stored packed in 8 bytes (LogPack()).
+----------------------------------------------------*/
+typedef struct
+{
+    u32 time;       // RTCToSeconds()
+    s16 value;      // 0.1 C
+    u8  ch;         // bits 0-3 channel, bits 4-7 record type
+    u8  flags;      // LOG_F_*
+    u16 ms;         // 0..999
+} log_rec_t;
+
+// Record types (upper nibble of ch)
+#define LOG_T_SAMPLE   0x00
+#define LOG_T_ALARM    0x10     // flags = ALM_* conditions (alarm.h)
+
+#define LOG_CH(r)      ((r)->ch & 0x0F)
+#define LOG_TYPE(r)    ((r)->ch & 0xF0)
+
+// Flags
+#define LOG_F_OVER_SP  (1<<0)   // value >= set point
+
+// RAM ring: 1024 x 8 bytes (LogPack() form) = 8 KB, 17 h at one record per minute
+#ifndef LOG_RING_RECS
+#define LOG_RING_RECS  1024     // power of 2
+#endif
+
+void LogInit(void);
+u32 LogAppend(const log_rec_t *);
+u8 LogRead(u32 seq, log_rec_t *);
+u32 LogHead(void);
+u32 LogOldest(void);
+u32 LogOverwritten(void);
+
+/*----------------------------------------------------
+  Stored/transmitted form: 8 bytes, little-endian
+
+    bytes 0-3   time
+    bytes 4-7   bits  0-12  value (signed, +-409.5 C)
+                bits 13-22  ms
+                bits 23-25  channel
+                bits 26-28  record type (ch bits 4-6)
+                bits 29-31  flags
+----------------------------------------------------*/
+#define LOG_REC_BYTES  8
+#define LOG_VALUE_MAX  4095
+#define LOG_VALUE_MIN  (-4096)
+void LogPack(const log_rec_t *, u8 *);
+void LogUnpack(const u8 *, log_rec_t *);
+
+#endif
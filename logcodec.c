@@ -0,0 +1,331 @@
+#include "types.h"          // Custom data types
+#include "crc16.h"          // Block CRC
+#include "logbuf.h"         // log_rec_t
+#include "logcodec.h"       // Block layout
+
+/*----------------------------------------------------
+  Log block codec
+
+  Consecutive samples of a channel are one sampler
+  period apart and move by a count or two, so each is
+  coded as the change of its interval (delta of delta,
+  0 while the period holds) and the change of its
+  value, both zig-zag so small negative numbers stay
+  small. The common case (same period, same flags,
+  value within -8..7) is one byte, and unchanged
+  samples merge into runs of up to 17 per byte.
+
+  Tags are byte aligned rather than bit packed: the
+  decoder is one switch per byte and nothing has to
+  be shifted across word boundaries on the ARM7.
+----------------------------------------------------*/
+#define TAG_SMALL   0x00
+#define TAG_FULL_D  0x40
+#define TAG_RUN     0x80
+#define TAG_RAW     0xC0
+#define TAG_D       0x08        // TAG_FULL_D: delta of delta follows
+#define RUN_MAX     17
+
+static u32 Rd32(const u8 *p)
+{
+    return p[0] | ((u32)p[1] << 8) | ((u32)p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static void Wr32(u8 *p, u32 v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static u32 Zig(s32 v)
+{
+    return ((u32)v << 1) ^ (u32)(v >> 31);
+}
+
+static s32 Unzig(u32 u)
+{
+    return (s32)(u >> 1) ^ -(s32)(u & 1);
+}
+
+/*----------------------------------------------------
+  PutVar() / GetVar()
+
+  Varint of up to 5 bytes. GetVar() stops at end and
+  returns 0 there; a torn block then decodes wrong
+  values, never past its end.
+----------------------------------------------------*/
+static u32 PutVar(u8 *p, u32 v)
+{
+    u32 n = 0;
+
+    while(v >= 0x80)
+    {
+        p[n++] = v | 0x80;
+        v >>= 7;
+    }
+    p[n++] = v;
+    return n;
+}
+
+static u32 GetVar(codec_dec_t *d)
+{
+    u32 v = 0, shift = 0;
+    u8 b;
+
+    do
+    {
+        if(d->p >= d->end || shift > 28)
+            return 0;
+        b = *d->p++;
+        v |= (u32)(b & 0x7F) << shift;
+        shift += 7;
+    }
+    while(b & 0x80);
+    return v;
+}
+
+/*----------------------------------------------------
+  CodecRec() / CodecTime() / CodecCount()
+
+  Header fields of a block.
+----------------------------------------------------*/
+u32 CodecRec(const u8 *buf)
+{
+    return Rd32(buf);
+}
+
+u32 CodecTime(const u8 *buf)
+{
+    return Rd32(buf + 4);
+}
+
+u16 CodecCount(const u8 *buf)
+{
+    return buf[10] | (buf[11] << 8);
+}
+
+/*----------------------------------------------------
+  CodecStart()
+
+  Starts a block of size bytes at buf, which must be
+  all 0xFF. rec is stored as the number of its first
+  record.
+----------------------------------------------------*/
+void CodecStart(codec_enc_t *e, u8 *buf, u32 size, u32 rec)
+{
+    u8 i;
+
+    e->buf = buf;
+    e->size = size;
+    e->len = 0;
+    e->count = 0;
+    for(i = 0; i < CODEC_CHANNELS; i++)
+        e->ch[i].valid = 0;
+    Wr32(buf, rec);
+}
+
+/*----------------------------------------------------
+  Follow()
+
+  Channel state after a sample at t (both sides).
+----------------------------------------------------*/
+static void Follow(codec_ch_t *c, u32 t, s16 value, u8 flags)
+{
+    c->d = c->valid ? (s32)(t - c->t) : 0;
+    c->t = t;
+    c->value = value;
+    c->flags = flags;
+    c->valid = 1;
+}
+
+/*----------------------------------------------------
+  CodecPut()
+
+  Appends a record. Returns 0 if the block cannot
+  take it: full, or its time is before the base or
+  CODEC_SPAN_S after it. The first record always
+  fits a block of at least CODEC_HDR_BYTES + 11.
+----------------------------------------------------*/
+u8 CodecPut(codec_enc_t *e, const log_rec_t *r)
+{
+    u8 tmp[12], *tag, i, n = 0, ch = LOG_CH(r);
+    codec_ch_t *c = &e->ch[ch & (CODEC_CHANNELS - 1)];
+    s32 t, dod, dv;
+
+    if(e->count == CODEC_MAX_RECS)
+        return 0;
+    if(!e->count)
+    {
+        e->time = r->time;
+        e->ms = r->ms;
+    }
+    else if(r->time < e->time || r->time - e->time > CODEC_SPAN_S)
+        return 0;
+    t = (s32)(r->time - e->time) * 1000 + r->ms - e->ms;
+    if(t < 0)
+        return 0;
+
+    if(LOG_TYPE(r) == LOG_T_SAMPLE && ch < CODEC_CHANNELS && c->valid && r->flags <= 7)
+    {
+        dod = t - (s32)c->t - c->d;
+        dv = r->value - c->value;
+        tag = e->buf + CODEC_HDR_BYTES + e->last;
+        if(!dod && !dv && r->flags == c->flags && e->len &&
+           (*tag == (TAG_SMALL | ch << 4) ||
+            (*tag >= (TAG_RUN | ch << 4) && *tag < (TAG_RUN | ch << 4 | (RUN_MAX - 2)))))
+        {
+            *tag = (*tag == (TAG_SMALL | ch << 4)) ? (TAG_RUN | ch << 4) : *tag + 1;
+            Follow(c, t, r->value, r->flags);
+            e->count++;
+            return 1;
+        }
+        if(!dod && r->flags == c->flags && dv >= -8 && dv <= 7)
+            tmp[n++] = TAG_SMALL | ch << 4 | Zig(dv);
+        else
+        {
+            tmp[n++] = TAG_FULL_D | ch << 4 | (dod ? TAG_D : 0) | r->flags;
+            if(dod)
+                n += PutVar(tmp + n, Zig(dod));
+            n += PutVar(tmp + n, Zig(dv));
+        }
+    }
+    else
+    {
+        tmp[n++] = TAG_RAW;
+        tmp[n++] = r->ch;
+        tmp[n++] = r->flags;
+        n += PutVar(tmp + n, t);
+        n += PutVar(tmp + n, Zig(r->value));
+    }
+
+    if(CODEC_HDR_BYTES + e->len + n > e->size)
+        return 0;
+    if(LOG_TYPE(r) == LOG_T_SAMPLE && ch < CODEC_CHANNELS)
+        Follow(c, t, r->value, r->flags);
+    e->last = e->len;
+    for(i = 0; i < n; i++)
+        e->buf[CODEC_HDR_BYTES + e->len++] = tmp[i];
+    e->count++;
+    return 1;
+}
+
+/*----------------------------------------------------
+  CodecEnd()
+
+  Completes the header (base, count, CRC). The block
+  can still be extended and ended again.
+----------------------------------------------------*/
+void CodecEnd(codec_enc_t *e)
+{
+    u16 crc;
+
+    Wr32(e->buf + 4, e->time);
+    e->buf[8] = e->ms;
+    e->buf[9] = e->ms >> 8;
+    e->buf[10] = e->count;
+    e->buf[11] = e->count >> 8;
+    crc = Crc16(CRC16_INIT, e->buf, 12);
+    crc = Crc16(crc, e->buf + CODEC_HDR_BYTES, e->size - CODEC_HDR_BYTES);
+    e->buf[12] = crc;
+    e->buf[13] = crc >> 8;
+}
+
+/*----------------------------------------------------
+  CodecCheck()
+
+  1 if the block of size bytes at buf is complete
+  and its CRC matches.
+----------------------------------------------------*/
+u8 CodecCheck(const u8 *buf, u32 size)
+{
+    u16 crc = Crc16(CRC16_INIT, buf, 12);
+
+    crc = Crc16(crc, buf + CODEC_HDR_BYTES, size - CODEC_HDR_BYTES);
+    return CodecCount(buf) <= CODEC_MAX_RECS && crc == (buf[12] | (buf[13] << 8));
+}
+
+/*----------------------------------------------------
+  CodecOpen()
+
+  Starts decoding the block at buf.
+----------------------------------------------------*/
+void CodecOpen(codec_dec_t *d, const u8 *buf, u32 size)
+{
+    u8 i;
+
+    d->p = buf + CODEC_HDR_BYTES;
+    d->end = buf + size;
+    d->time = Rd32(buf + 4);
+    d->ms = buf[8] | (buf[9] << 8);
+    d->left = CodecCount(buf);
+    d->run = 0;
+    for(i = 0; i < CODEC_CHANNELS; i++)
+        d->ch[i].valid = 0;
+}
+
+/*----------------------------------------------------
+  CodecGet()
+
+  Next record of the block, 0 after the last.
+----------------------------------------------------*/
+u8 CodecGet(codec_dec_t *d, log_rec_t *r)
+{
+    codec_ch_t *c;
+    u32 t, ms;
+    u8 tag;
+
+    if(!d->left || (!d->run && d->p >= d->end))
+        return 0;
+    d->left--;
+
+    tag = d->run ? (TAG_RUN | d->runCh << 4) : *d->p++;
+    c = &d->ch[(tag >> 4) & (CODEC_CHANNELS - 1)];
+    r->ch = LOG_T_SAMPLE | ((tag >> 4) & (CODEC_CHANNELS - 1));
+    switch(tag & 0xC0)
+    {
+        case TAG_SMALL:
+            t = c->t + c->d;
+            r->value = c->value + Unzig(tag & 0x0F);
+            r->flags = c->flags;
+            break;
+
+        case TAG_FULL_D:
+            t = c->t + c->d;
+            if(tag & TAG_D)
+                t += Unzig(GetVar(d));
+            r->value = c->value + Unzig(GetVar(d));
+            r->flags = tag & 0x07;
+            break;
+
+        case TAG_RUN:
+            if(d->run)
+                d->run--;
+            else
+            {
+                d->run = (tag & 0x0F) + 1;
+                d->runCh = (tag >> 4) & (CODEC_CHANNELS - 1);
+            }
+            t = c->t + c->d;
+            r->value = c->value;
+            r->flags = c->flags;
+            break;
+
+        default:
+            r->ch = d->p < d->end ? *d->p++ : 0;
+            r->flags = d->p < d->end ? *d->p++ : 0;
+            t = GetVar(d);
+            r->value = Unzig(GetVar(d));
+            c = (LOG_TYPE(r) == LOG_T_SAMPLE && LOG_CH(r) < CODEC_CHANNELS) ?
+                &d->ch[LOG_CH(r)] : 0;
+            break;
+    }
+    if(c)
+        Follow(c, t, r->value, r->flags);
+
+    ms = d->ms + t;
+    r->time = d->time + ms / 1000;
+    r->ms = ms % 1000;
+    return 1;
+}
@@ -0,0 +1,86 @@
+#ifndef LOGCODEC_H
+#define LOGCODEC_H
+
+#include "types.h"
+#include "logbuf.h"
+
+/*----------------------------------------------------
+  Compressed record block
+
+  Each block decodes on its own: the header carries
+  the absolute base, and every record after it is
+  coded against the last record of its channel.
+
+    bytes 0-3    number of the first record (caller's)
+    bytes 4-7    time of the first record (base)
+    bytes 8-9    ms of the first record
+    bytes 10-11  records in the block
+    bytes 12-13  CRC16 of bytes 0-11 and the rest of
+                 the block (unused bytes stay 0xFF)
+    bytes 14-    records, each starting with a tag:
+
+    00cc vvvv  sample on channel cc one interval after
+               its last (delta of delta 0), same flags,
+               value + vvvv (zig-zag, -8..7)
+    01cc dfff  sample on channel cc with flags fff,
+               then if d the delta of delta, then the
+               value change (zig-zag varints)
+    10cc nnnn  nnnn + 2 samples on channel cc, one
+               interval apart, value and flags as before
+    11000000   any record: ch byte, flags byte, varint
+               ms after the base, zig-zag varint value
+
+  Times are ms after the base. A channel's first
+  sample in a block, alarm records and flags above 7
+  take the full form. Varints are 7 bits per byte,
+  low bits first, bit 7 set on all but the last.
+----------------------------------------------------*/
+#define CODEC_HDR_BYTES     14
+#define CODEC_CHANNELS      4       // Channels with a compact form
+#define CODEC_MAX_RECS      4095    // Per block (16 make a u16 count)
+#define CODEC_SPAN_S        2000000 // Base to last record, ms fit s32
+
+typedef struct
+{
+    u32 t;              // ms after the base
+    s32 d;              // Interval to the sample before
+    s16 value;
+    u8  flags;
+    u8  valid;          // Seen in this block
+} codec_ch_t;
+
+typedef struct
+{
+    u8 *buf;            // Block (CodecStart() leaves it as it is)
+    u32 size;           // Block bytes, header included
+    u32 len;            // Record bytes used
+    u32 last;           // Offset of the last tag, for runs
+    u32 time;           // Base
+    u16 ms;
+    u16 count;
+    codec_ch_t ch[CODEC_CHANNELS];
+} codec_enc_t;
+
+typedef struct
+{
+    const u8 *p;        // Next tag
+    const u8 *end;
+    u32 time;           // Base
+    u16 ms;
+    u16 left;           // Records still to come
+    u8  run;            // Repeats left of a run
+    u8  runCh;
+    codec_ch_t ch[CODEC_CHANNELS];
+} codec_dec_t;
+
+void CodecStart(codec_enc_t *, u8 *buf, u32 size, u32 rec);
+u8 CodecPut(codec_enc_t *, const log_rec_t *);
+void CodecEnd(codec_enc_t *);
+u8 CodecCheck(const u8 *buf, u32 size);
+void CodecOpen(codec_dec_t *, const u8 *buf, u32 size);
+u8 CodecGet(codec_dec_t *, log_rec_t *);
+u32 CodecRec(const u8 *buf);
+u32 CodecTime(const u8 *buf);
+u16 CodecCount(const u8 *buf);
+
+#endif
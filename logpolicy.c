@@ -0,0 +1,168 @@
+#include <LPC21xx.h>        // LPC21xx register definitions
+#include "types.h"          // Custom data types
+#include "timer_defines.h"  // TIMER0_VIC_CHNO
+#include "chan.h"           // Channel periods
+#include "sampler.h"        // SamplerSetPeriod(), period limits
+#include "logpolicy.h"      // Logging policy
+
+/*----------------------------------------------------
+  Policy state per channel
+
+  PolicySample() runs in the sampler interrupt for
+  every sample, after the statistics have had it; the
+  counters give the compression of each channel as
+  fullRate / logged.
+----------------------------------------------------*/
+static log_policy_t polCfg[CHAN_COUNT];
+static policy_cnt_t polCnt[CHAN_COUNT];
+static s32 polLast[CHAN_COUNT];         // Last value logged (DEADBAND)
+                                        // or sampled (ADAPTIVE)
+static u8  polLastFlags[CHAN_COUNT];
+static u32 polSinceMs[CHAN_COUNT];      // Since the last one logged
+static u8  polCalm[CHAN_COUNT];         // Calm steps in a row
+static u8  polFirst[CHAN_COUNT];        // Next sample is the first
+
+/*----------------------------------------------------
+  PolicyInit()
+
+  Every channel logs every sample.
+----------------------------------------------------*/
+void PolicyInit(void)
+{
+    u8 ch;
+
+    for(ch = 0; ch < CHAN_COUNT; ch++)
+    {
+        polCfg[ch].mode = POLICY_ALL;
+        polCfg[ch].band = 0;
+        polCfg[ch].minMs = polCfg[ch].maxMs = 0;
+        polCnt[ch].taken = polCnt[ch].logged = polCnt[ch].fullRate = 0;
+        polSinceMs[ch] = 0;
+        polLastFlags[ch] = 0;
+        polCalm[ch] = 0;
+        polFirst[ch] = 1;
+    }
+}
+
+/*----------------------------------------------------
+  PolicySet()
+
+  Replaces a channel's policy and clears its counters.
+  ADAPTIVE needs minMs <= maxMs, both valid sampler
+  periods, and starts from the channel period brought
+  into that range; the other modes go back to the
+  channel period. Returns 0 if the policy is invalid.
+----------------------------------------------------*/
+u8 PolicySet(u8 ch, const log_policy_t *p)
+{
+    u32 per;
+
+    if(ch >= CHAN_COUNT || p->mode > POLICY_ADAPTIVE)
+        return 0;
+    if(p->mode == POLICY_DEADBAND && !p->maxMs)
+        return 0;
+    if(p->mode == POLICY_ADAPTIVE &&
+       (p->minMs < SAMPLE_PERIOD_MIN || p->maxMs > SAMPLE_PERIOD_MAX ||
+        p->minMs > p->maxMs || p->minMs % SAMPLE_TICK_MS || p->maxMs % SAMPLE_TICK_MS))
+        return 0;
+
+    VICIntEnClr = (1<<TIMER0_VIC_CHNO);     // Tick must not see half an update
+    polCfg[ch] = *p;
+    polCnt[ch].taken = polCnt[ch].logged = polCnt[ch].fullRate = 0;
+    polSinceMs[ch] = 0;                     // Nothing counted under the old policy
+    polLastFlags[ch] = 0;
+    polCalm[ch] = 0;
+    polFirst[ch] = 1;
+    VICIntEnable = (1<<TIMER0_VIC_CHNO);
+
+    per = ChanCfg(ch)->periodMs;
+    if(p->mode == POLICY_ADAPTIVE)
+    {
+        if(per < p->minMs)
+            per = p->minMs;
+        if(per > p->maxMs)
+            per = p->maxMs;
+    }
+    return SamplerSetPeriod(ch, per);
+}
+
+/*----------------------------------------------------
+  PolicyCfg() / PolicyCounters()
+----------------------------------------------------*/
+const log_policy_t *PolicyCfg(u8 ch)
+{
+    return &polCfg[ch];
+}
+
+const policy_cnt_t *PolicyCounters(u8 ch)
+{
+    return &polCnt[ch];
+}
+
+/*----------------------------------------------------
+  PolicySample()
+
+  Sampler hook (interrupt context): 1 if sample r of
+  its channel is to be logged. periodMs is the period
+  it was taken at; ADAPTIVE may change it for the
+  next one.
+----------------------------------------------------*/
+u8 PolicySample(u8 ch, const log_rec_t *r, u32 *periodMs)
+{
+    const log_policy_t *p = &polCfg[ch];
+    policy_cnt_t *c = &polCnt[ch];
+    s32 step = r->value - polLast[ch];
+    u8 log = 1;
+
+    if(step < 0)
+        step = -step;
+    c->taken++;
+    c->fullRate += p->mode == POLICY_ADAPTIVE ? *periodMs / p->minMs : 1;
+    polSinceMs[ch] += *periodMs;
+
+    switch(p->mode)
+    {
+        case POLICY_NONE:
+            log = 0;
+            break;
+
+        case POLICY_DEADBAND:
+            log = polFirst[ch] || step > p->band || polSinceMs[ch] >= p->maxMs ||
+                  (r->flags & LOG_F_OVER_SP) != polLastFlags[ch];
+            break;
+
+        case POLICY_ADAPTIVE:
+            if(polFirst[ch])
+                break;
+            if(step > p->band)
+            {
+                polCalm[ch] = 0;            // Back to full speed at once,
+                *periodMs = p->minMs;       // slow down one step at a time
+            }
+            else if(2 * step > p->band)
+                polCalm[ch] = 0;
+            else if(++polCalm[ch] >= POLICY_STABLE)
+            {
+                polCalm[ch] = 0;
+                *periodMs = *periodMs * 2 > p->maxMs ? p->maxMs : *periodMs * 2;
+            }
+            polLast[ch] = r->value;         // Steps between samples
+            break;
+    }
+
+    if(log)
+    {
+        c->logged++;
+        polSinceMs[ch] = 0;
+        polLastFlags[ch] = r->flags & LOG_F_OVER_SP;
+        if(p->mode != POLICY_ADAPTIVE)
+            polLast[ch] = r->value;
+    }
+    if(polFirst[ch])
+    {
+        polFirst[ch] = 0;
+        polLast[ch] = r->value;
+        polCalm[ch] = 0;
+    }
+    return log;
+}
@@ -0,0 +1,55 @@
+#ifndef LOGPOLICY_H
+#define LOGPOLICY_H
+
+#include "types.h"
+#include "logbuf.h"
+
+/*----------------------------------------------------
+  Logging policy
+
+  Decides per channel which samples the sampler puts
+  in the log (and so on the UART and in flash):
+
+    ALL        every sample (default)
+    NONE       none; the samples only feed stats.c
+    DEADBAND   a sample that moved more than band
+               from the last one logged, or crossed
+               the set point, or once maxMs has gone
+               by without one (heartbeat)
+    ADAPTIVE   every sample, but the period drops to
+               minMs when a step exceeds band and
+               doubles (up to maxMs) after
+               POLICY_STABLE steps within band / 2
+
+  Values in the units of the channel (0.1 C or mV).
+----------------------------------------------------*/
+#define POLICY_ALL          0
+#define POLICY_NONE         1
+#define POLICY_DEADBAND     2
+#define POLICY_ADAPTIVE     3
+
+#define POLICY_STABLE       4   // Calm steps before slowing down
+
+typedef struct
+{
+    u8  mode;           // POLICY_*
+    u16 band;           // DEADBAND / ADAPTIVE threshold
+    u32 minMs;          // ADAPTIVE fastest period
+    u32 maxMs;          // DEADBAND heartbeat, ADAPTIVE slowest period
+} log_policy_t;
+
+typedef struct
+{
+    u32 taken;          // Samples seen
+    u32 logged;         // Samples put in the log
+    u32 fullRate;       // Samples the fastest allowed period would
+                        // have taken (taken, except ADAPTIVE)
+} policy_cnt_t;
+
+void PolicyInit(void);
+u8 PolicySet(u8 ch, const log_policy_t *);
+const log_policy_t *PolicyCfg(u8 ch);
+const policy_cnt_t *PolicyCounters(u8 ch);
+u8 PolicySample(u8 ch, const log_rec_t *, u32 *periodMs);
+
+#endif
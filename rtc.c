@@ -1,7 +1,10 @@
-#include <LPC21xx.H>      // LPC21xx register definitions
+#include <LPC21xx.h>      // LPC21xx register definitions
 #include "rtc_defines.h"  // RTC register macro definitions
 #include "types.h"        // Custom data types (u32, s32 etc.)
 #include "lcd.h"          // LCD display functions
+#include "delay.h"        // GetTickUs(), Timer0 1 us counter
+#include "rtc.h"          // rtc_time_t
+#include "fmt.h"          // Time and date formatting
 
 /*----------------------------------------------------
   Array storing names of days (3-letter format)
@@ -9,6 +12,135 @@
 ----------------------------------------------------*/
 char week[][4] = {"SUN","MON","TUE","WED","THU","FRI","SAT"};
 
+/*----------------------------------------------------
+  Second lock
+
+  The RTC only counts whole seconds (CTC gives 1/32768
+  s, at the cost of a snapshot per read). Timer0 runs
+  at 1 MHz, so a stamp with ms resolution is the RTC
+  time at the last second edge plus the Timer0 time
+  since that edge: one register read.
+
+  RTC_ISR() records each edge. It runs late by the
+  interrupt latency, so the edge is put back by the
+  CTC ticks counted since. The Timer0 length of each
+  RTC second calibrates lockErr (Timer0 against the
+  RTC crystal, Q20), which scales the time since the
+  edge; the lock is renewed every second, so Timer0
+  drift never accumulates.
+----------------------------------------------------*/
+#define LOCK_Q      20
+#define US_PER_TICK_Q9  15625   // 1e6 / 32768 = 15625 / 512
+
+static volatile u32 lockSeq;    // Odd while RTC_ISR() updates
+static volatile u32 lockSec;    // RTC seconds at the last edge
+static volatile u32 lockUs;     // T0TC at that edge
+static volatile s32 lockErr;    // (Timer0 us per RTC s - 1e6) / 1e6, Q20
+static volatile u8  lockValid;  // 0 until the first edge
+static u32 lastSec, lastMs;     // Last stamp handed out
+
+void RTC_ISR(void) __irq;
+
+/*----------------------------------------------------
+  RTC_ISR()
+
+  Counter increment interrupt (every RTC second).
+----------------------------------------------------*/
+void RTC_ISR(void) __irq
+{
+    u32 now = GetTickUs();      // First, before the snapshot reads
+    u16 sub;
+    u32 sec = RTCNow(&sub);
+    u32 edge = now - (((u32)sub * US_PER_TICK_Q9) >> 9);
+    u32 per = edge - lockUs;
+    s32 err;
+
+    lockSeq++;
+    if(lockValid && sec == lockSec + 1 &&
+       per > RTC_LOCK_MIN_US && per < RTC_LOCK_MAX_US)
+    {
+        // Filtered over about 8 s: the edge times carry the
+        // 30 us CTC resolution
+        err = ((s32)(per - 1000000) << LOCK_Q) / 1000000;
+        lockErr += (err - lockErr) / 8;
+    }
+    lockSec = sec;
+    lockUs = edge;
+    lockValid = 1;
+    lockSeq++;
+
+    ILR = ILR_RTCCIF;           // Clear the increment flag
+    VICVectAddr = 0;            // End of interrupt
+}
+
+/*----------------------------------------------------
+  RTCStampMs()
+  Time since RTC_EPOCH_YEAR with ms resolution
+
+  ms -> milliseconds into the returned second
+  Returns seconds. Never goes back between calls from
+  interrupt context (the sampler), except when the
+  clock is set.
+
+  A lock more than a second behind (RTC_ISR() held
+  off, edges missed) is not extrapolated: stamps come
+  from the CTC until the next edge relocks. That also
+  keeps dt * lockErr within 32 bits.
+----------------------------------------------------*/
+u32 RTCStampMs(u16 *ms)
+{
+    u32 seq, sec = 0, dt = 0xFFFFFFFF, m;
+    u16 sub;
+
+    if(lockValid)
+    {
+        do
+        {
+            seq = lockSeq;
+            sec = lockSec;
+            dt = GetTickUs() - lockUs;
+        } while((seq & 1) || seq != lockSeq);
+    }
+    if(dt >= 2 * RTC_LOCK_MIN_US)   // No lock yet, or stale: CTC
+    {
+        sec = RTCNow(&sub);
+        *ms = ((u32)sub * 125) >> 12;   // * 1000 / 32768
+        return sec;
+    }
+
+    dt -= ((s32)dt * lockErr) >> LOCK_Q;    // Timer0 us -> RTC us (|dt| < 2 s)
+    if(dt >= 1000000)           // Edge not served yet (IRQ latency)
+    {
+        dt -= 1000000;
+        sec++;
+    }
+    m = dt / 1000;
+
+    // Edge times are only known to one CTC tick, which
+    // can put a stamp a fraction of a ms behind the last
+    if(sec == lastSec && m < lastMs)
+        m = lastMs;
+    else if(sec + 1 == lastSec)
+    {
+        sec = lastSec;
+        m = lastMs;
+    }
+    lastSec = sec;
+    lastMs = m;
+
+    *ms = m;
+    return sec;
+}
+
+/*----------------------------------------------------
+  RTCLockPpm()
+  Timer0 against the RTC as calibrated, in ppm
+----------------------------------------------------*/
+s32 RTCLockPpm(void)
+{
+    return ((s32)lockErr * 1000000) >> LOCK_Q;
+}
+
 /*----------------------------------------------------
   RTC_Init()
   Initializes the Real Time Clock module.
@@ -17,74 +149,116 @@ char week[][4] = {"SUN","MON","TUE","WED","THU","FRI","SAT"};
   1. Reset RTC
   2. Configure prescaler (if required)
   3. Enable RTC
+
+  A clock that is already running with a valid time
+  (a reset without a power loss) is left as it is,
+  so log times do not jump back at every reboot.
+
+  Returns 1 if the time was kept, 0 if it has to be
+  set.
 ----------------------------------------------------*/
-void RTC_Init(void) 
+u8 RTC_Init(void) 
 {
-    CCR = RTC_RESET;   // Disable and reset RTC
+    rtc_time_t t;
+    u8 kept;
+
+    RTCSnapshot(&t);
+    kept = (CCR & RTC_ENABLE) &&
+           t.year >= RTC_EPOCH_YEAR && t.year <= 2099 &&
+           t.dom >= 1 && t.dom <= RTCDaysInMonth(t.month, t.year) &&
+           t.hour <= 23 && t.min <= 59 && t.sec <= 59;
+
+    if(!kept)
+    {
+        CCR = RTC_RESET;   // Disable and reset RTC
 
 #ifdef _LPC2148
-    // For LPC2148: Enable RTC & select clock source
-    CCR = RTC_ENABLE | RTC_CLKSRC;  
+        // For LPC2148: Enable RTC & select clock source
+        CCR = RTC_ENABLE | RTC_CLKSRC;  
 
 #else
-    // For other LPC21xx controllers:
-    // Configure prescaler values to generate 1 second tick
-    PREINT  = PREINT_VAL;  
-    PREFRAC = PREFRAC_VAL;
+        // For other LPC21xx controllers:
+        // Configure prescaler values to generate 1 second tick
+        PREINT  = PREINT_VAL;  
+        PREFRAC = PREFRAC_VAL;
 
-    CCR = RTC_ENABLE;   // Enable RTC
+        CCR = RTC_ENABLE;   // Enable RTC
 #endif
+    }
+
+    // Second edge interrupt for RTCStampMs()
+    lockValid = 0;
+    CIIR = CIIR_IMSEC;
+    ILR  = ILR_RTCCIF;
+    VICIntSelect &= ~(1<<RTC_VIC_CHNO);
+    VICVectAddr4 = (u32)RTC_ISR;
+    VICVectCntl4 = (1<<5) | RTC_VIC_CHNO;
+    VICIntEnable = (1<<RTC_VIC_CHNO);
+    return kept;
 }
 
 /*----------------------------------------------------
-  GetRTCTimeInfo()
-  Reads current time from RTC registers
+  RTCSnapshot()
+  Reads the whole clock at once
 
-  hour   -> pointer to store hour (023)
-  minute -> pointer to store minute (059)
-  second -> pointer to store second (059)
+  The time and date registers are separate, so six
+  reads can straddle a rollover (23:59:59 with the
+  next day's date is a whole day out). CTIME0 and
+  CTIME1 hold every field; CTIME0 is read again and
+  the reads repeated if the second moved on.
+
+  t -> calendar fields, sub = CTC 1/32768 s ticks
+  Returns the same time as seconds since RTC_EPOCH_YEAR
 ----------------------------------------------------*/
-void GetRTCTimeInfo(s32 *hour, s32 *minute, s32 *second)
+u32 RTCSnapshot(rtc_time_t *t)
 {
-    *hour   = HOUR;   // Read hour register
-    *minute = MIN;    // Read minute register
-    *second = SEC;    // Read second register
+    u32 t0, t1, ctc;
+
+    do
+    {
+        t0  = CTIME0;
+        ctc = CTC;
+        t1  = CTIME1;
+    } while(CTIME0 != t0);      // Rolled over between the reads
+
+    t->sec   = t0 & CT0_SEC_MASK;
+    t->min   = (t0 >> CT0_MIN_SHIFT) & CT0_MIN_MASK;
+    t->hour  = (t0 >> CT0_HOUR_SHIFT) & CT0_HOUR_MASK;
+    t->dow   = (t0 >> CT0_DOW_SHIFT) & CT0_DOW_MASK;
+    t->dom   = t1 & CT1_DOM_MASK;
+    t->month = (t1 >> CT1_MONTH_SHIFT) & CT1_MONTH_MASK;
+    t->year  = (t1 >> CT1_YEAR_SHIFT) & CT1_YEAR_MASK;
+    t->sub   = (ctc >> CTC_SHIFT) & CTC_MASK;
+
+    return RTCToSeconds(t->year, t->month, t->dom, t->hour, t->min, t->sec);
 }
 
 /*----------------------------------------------------
-  DisplayRTCTime()
-  Displays time in HH:MM:SS format on LCD
+  RTCNow()
+  Packed timestamp: seconds since RTC_EPOCH_YEAR
+
+  sub -> CTC ticks into that second (may be 0)
 ----------------------------------------------------*/
-void DisplayRTCTime(u32 hour, u32 minute, u32 second)
+u32 RTCNow(u16 *sub)
 {
-    CmdLCD(0x80);   // Move cursor to first row, first column
-
-    // Convert numeric digits to ASCII by adding 48
-    CharLCD((hour/10) + 48);
-    CharLCD((hour%10) + 48);
-    CharLCD(':');
+    rtc_time_t t;
+    u32 s = RTCSnapshot(&t);
 
-    CharLCD((minute/10) + 48);
-    CharLCD((minute%10) + 48);
-    CharLCD(':');
-
-    CharLCD((second/10) + 48);
-    CharLCD((second%10) + 48);
+    if(sub)
+        *sub = t.sub;
+    return s;
 }
 
 /*----------------------------------------------------
-  GetRTCDateInfo()
-  Reads current date from RTC registers
-
-  date  -> Day of month (131)
-  month -> Month (112)
-  year  -> Full year (4 digits)
+  DisplayRTCTime()
+  Displays time in HH:MM:SS format on LCD
 ----------------------------------------------------*/
-void GetRTCDateInfo(s32 *date, s32 *month, s32 *year)
+void DisplayRTCTime(u32 hour, u32 minute, u32 second)
 {
-    *date  = DOM;     // Day of month register
-    *month = MONTH;   // Month register
-    *year  = YEAR;    // Year register
+    u8 a[8];
+
+    FbPosLCD(0x80);   // First row, first column (shadow buffer)
+    FbBufLCD(a, FmtTime(a, hour, minute, second) - a);
 }
 
 /*----------------------------------------------------
@@ -93,21 +267,10 @@ void GetRTCDateInfo(s32 *date, s32 *month, s32 *year)
 ----------------------------------------------------*/
 void DisplayRTCDate(u32 date, u32 month, u32 year)
 {
-    CmdLCD(0xC0);   // Move cursor to second row
-
-    CharLCD((date/10) + 48);
-    CharLCD((date%10) + 48);
-    CharLCD('/');
-
-    CharLCD((month/10) + 48);
-    CharLCD((month%10) + 48);
-    CharLCD('/');
+    u8 a[10];
 
-    // Display 4-digit year manually
-    CharLCD((year/1000) + 48);
-    CharLCD(((year/100)%10) + 48);
-    CharLCD(((year/10)%10) + 48);
-    CharLCD((year%10) + 48);
+    FbPosLCD(0xC0);   // Second row (shadow buffer)
+    FbBufLCD(a, FmtDate(a, date, month, year) - a);
 }
 
 /*----------------------------------------------------
@@ -123,6 +286,7 @@ void SetRTCTimeInfo(u32 hour, u32 minute, u32 second)
     HOUR = hour;   // Set hour register
     MIN  = minute; // Set minute register
     SEC  = second; // Set second register
+    lockValid = 0; // Stamps from CTC until the next edge
 }
 
 /*----------------------------------------------------
@@ -138,17 +302,7 @@ void SetRTCDateInfo(u32 date, u32 month, u32 year)
     DOM   = date;   // Set day of month
     MONTH = month;  // Set month
     YEAR  = year;   // Set year
-}
-
-/*----------------------------------------------------
-  GetRTCDay()
-  Reads current day of week
-
-  day -> pointer (0=Sunday ... 6=Saturday)
-----------------------------------------------------*/
-void GetRTCDay(s32 *day)
-{
-    *day = DOW;   // Read Day Of Week register
+    lockValid = 0;  // Stamps from CTC until the next edge
 }
 
 /*----------------------------------------------------
@@ -157,8 +311,8 @@ void GetRTCDay(s32 *day)
 ----------------------------------------------------*/
 void DisplayRTCDay(u32 dow)
 {
-    CmdLCD(0xCB);       // Move cursor to specific position
-    StrLCD(week[dow]);  // Display corresponding day string
+    FbPosLCD(0xCB);       // Specific position (shadow buffer)
+    FbStrLCD(week[dow]);  // Display corresponding day string
 }
 
 /*----------------------------------------------------
@@ -170,4 +324,104 @@ void DisplayRTCDay(u32 dow)
 void SetRTCDay(u32 day)
 {
     DOW = day;   // Write day to register
-}
\ No newline at end of file
+}
+
+/*----------------------------------------------------
+  Days before each month (non-leap year)
+----------------------------------------------------*/
+static const u16 daysBefore[12] =
+{
+    0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334
+};
+
+/*----------------------------------------------------
+  Days before each year of a four year cycle that
+  starts with a leap year
+----------------------------------------------------*/
+static const u16 cycleBefore[4] = { 0, 366, 731, 1096 };
+
+#define IS_LEAP(y)  (((y) & 3) == 0)    // Valid 1901..2099
+#define LEAPS_BEFORE(y) (((y) - 1) / 4) // Leap years before y (same range)
+
+// Leap year at or before the epoch, and days from it to the epoch
+#define CYCLE_YEAR  (RTC_EPOCH_YEAR & ~3)
+#define CYCLE_DAYS  (cycleBefore[RTC_EPOCH_YEAR & 3])
+
+// Day of week of the epoch: 1 Jan 1901 was a Tuesday (2)
+#define EPOCH_DOW   (((RTC_EPOCH_YEAR - 1901) * 365 + LEAPS_BEFORE(RTC_EPOCH_YEAR) \
+                      - LEAPS_BEFORE(1901) + 2) % 7)
+
+/*----------------------------------------------------
+  RTCDaysInMonth()
+
+  Length of month (1..12) of year, 0 for an invalid
+  month.
+----------------------------------------------------*/
+u32 RTCDaysInMonth(u32 month, u32 year)
+{
+    if(month < 1 || month > 12)
+        return 0;
+    if(month == 12)
+        return 31;
+    return daysBefore[month] - daysBefore[month - 1] + (month == 2 && IS_LEAP(year));
+}
+
+/*----------------------------------------------------
+  RTCToSeconds()
+  Calendar time -> seconds since RTC_EPOCH_YEAR
+----------------------------------------------------*/
+u32 RTCToSeconds(u32 year, u32 month, u32 date,
+                 u32 hour, u32 minute, u32 second)
+{
+    u32 days;
+
+    days = (year - RTC_EPOCH_YEAR) * 365 +
+           LEAPS_BEFORE(year) - LEAPS_BEFORE(RTC_EPOCH_YEAR);
+    days += daysBefore[month - 1] + (date - 1);
+    if(month > 2 && IS_LEAP(year))
+        days++;
+
+    return ((days * 24 + hour) * 60 + minute) * 60 + second;
+}
+
+/*----------------------------------------------------
+  SecondsToRTC()
+  Seconds since RTC_EPOCH_YEAR -> calendar time
+
+  No search loops: the year comes from the four year
+  cycle and a table of its year starts, the month
+  from day/32 (never more than one short). Divisions
+  are all by constants.
+----------------------------------------------------*/
+void SecondsToRTC(u32 t, rtc_time_t *c)
+{
+    u32 days = t / 86400, rem = t - days * 86400;
+    u32 d, y, m, leap;
+
+    c->hour = rem / 3600;
+    rem -= c->hour * 3600;
+    c->min = rem / 60;
+    c->sec = rem - c->min * 60;
+    c->sub = 0;
+    c->dow = (days + EPOCH_DOW) % 7;
+
+    d = days + CYCLE_DAYS;              // Days since the cycle year
+    y = d / 1461;                       // Whole four year cycles
+    d -= y * 1461;
+    y = CYCLE_YEAR + y * 4;
+    if(d >= cycleBefore[2])
+        m = d >= cycleBefore[3] ? 3 : 2;
+    else
+        m = d >= cycleBefore[1] ? 1 : 0;
+    d -= cycleBefore[m];                // Day of the year, 0 based
+    y += m;
+    leap = (m == 0);
+
+    m = d >> 5;
+    if(m < 11 && d >= daysBefore[m + 1] + (leap && m + 1 >= 2))
+        m++;
+
+    c->year = y;
+    c->month = m + 1;
+    c->dom = d - daysBefore[m] - (leap && m >= 2) + 1;
+}
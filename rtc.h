@@ -1,15 +1,36 @@
+#ifndef RTC_H
+#define RTC_H
+
 #include "types.h"
 
-void RTC_Init(void);
-void GetRTCTimeInfo(s32 *,s32 *,s32 *);
+// One consistent reading of the clock (RTCSnapshot)
+typedef struct
+{
+    u8  sec, min, hour, dow;    // dow 0 = Sunday
+    u8  dom, month;
+    u16 year;
+    u16 sub;                    // 1/RTC_SUB_HZ s into the second (CTC)
+} rtc_time_t;
+
+#define RTC_SUB_HZ 32768
+
+u8 RTC_Init(void);
+u32 RTCSnapshot(rtc_time_t *);
+u32 RTCNow(u16 *);
+u32 RTCStampMs(u16 *);
+s32 RTCLockPpm(void);
 void DisplayRTCTime(u32,u32,u32);
-void GetRTCDateInfo(s32 *,s32 *,s32 *);
 void DisplayRTCDate(u32,u32,u32);
 
 void SetRTCTimeInfo(u32,u32,u32);
 void SetRTCDateInfo(u32,u32,u32);
 
-void GetRTCDay(s32 *);
 void DisplayRTCDay(u32);
 void SetRTCDay(u32);
 
+u32 RTCDaysInMonth(u32,u32);
+u32 RTCToSeconds(u32,u32,u32,u32,u32,u32);
+void SecondsToRTC(u32,rtc_time_t *);
+
+#endif
+
@@ -17,5 +17,36 @@
 
 //#define _LPC2148
 
+// Consolidated time registers (read only)
+#define CT0_SEC_MASK    0x3F
+#define CT0_MIN_SHIFT   8
+#define CT0_MIN_MASK    0x3F
+#define CT0_HOUR_SHIFT  16
+#define CT0_HOUR_MASK   0x1F
+#define CT0_DOW_SHIFT   24
+#define CT0_DOW_MASK    0x07
+#define CT1_DOM_MASK    0x1F
+#define CT1_MONTH_SHIFT 8
+#define CT1_MONTH_MASK  0x0F
+#define CT1_YEAR_SHIFT  16
+#define CT1_YEAR_MASK   0xFFF
+
+// Clock tick counter: 32768 Hz ticks into the second in bits 15:1
+#define CTC_SHIFT       1
+#define CTC_MASK        0x7FFF
+
+// Counter increment interrupt, once a second (second lock)
+#define RTC_VIC_CHNO    13
+#define CIIR_IMSEC      (1<<0)
+#define ILR_RTCCIF      (1<<0)
+
+// Timer0 us per RTC second accepted for calibration (+-1000 ppm);
+// anything else means the clock was set
+#define RTC_LOCK_MIN_US 999000
+#define RTC_LOCK_MAX_US 1001000
+
+// Log timestamps: seconds since 1 Jan of this year, 00:00:00
+#define RTC_EPOCH_YEAR 2000
+
 
 #endif
@@ -0,0 +1,178 @@
+#include <LPC21xx.h>        // LPC21xx register definitions
+#include "types.h"          // Custom data types
+#include "delay.h"          // TimebasePeriodic(), T0TC time base
+#include "timer_defines.h"  // TIMER0_VIC_CHNO
+#include "chan.h"           // ChanRead(), set points, periods
+#include "rtc.h"            // RTCStampMs()
+#include "logbuf.h"         // RAM log
+#include "alarm.h"          // AlarmCheck()
+#include "stats.h"          // StatsAdd()
+#include "logpolicy.h"      // PolicySample()
+#include "filter.h"         // FilterTick()
+#include "sampler.h"        // Periods, counters
+
+/*----------------------------------------------------
+  Sampling scheduler
+
+  Timer0 MR1 interrupts every SAMPLE_TICK_US. Each
+  channel has its own period in ticks; when it falls
+  due the channel is read (ChanRead(), filtered and
+  converted as its channel table entry says), time
+  stamped and appended to the RAM log right there in
+  the interrupt, so a busy or blocked task can no
+  longer make it miss a sample. Every sample goes
+  into the interval statistics (stats.c); the logging
+  policy (logpolicy.c) then decides whether it is
+  logged, and may change the period (ADAPTIVE). The
+  alarm engine (alarm.c) runs on every tick after
+  the samples.
+
+  Proof of no drops: every tick measures how late it
+  ran (T0TC against the MR1 match). A tick that comes
+  a whole period late means interrupts were off (IAP
+  flash erase); the skipped ticks are counted, and a
+  channel whose deadline passed without its sample
+  counts it in missed. taken + missed covers every
+  deadline since the period was set.
+----------------------------------------------------*/
+static sample_ch_t smpCh[SAMPLE_CHANNELS];
+static u32 smpNext[SAMPLE_CHANNELS];    // Due tick per channel
+static volatile u32 smpTick;            // Ticks since SamplerInit()
+static sample_stats_t smpStats;
+
+/*----------------------------------------------------
+  SamplerTick()
+
+  Timer0 MR1 hook (interrupt context).
+----------------------------------------------------*/
+static void SamplerTick(u32 dueUs)
+{
+    u32 late = T0TC - dueUs;
+    u32 skip = late / SAMPLE_TICK_US;
+    u32 per, perMs, behind, now = 0;
+    u16 ms = 0;
+    log_rec_t r;
+    u8 ch;
+
+    if(skip)
+    {
+        smpStats.lostTicks += skip;
+        late -= skip * SAMPLE_TICK_US;
+    }
+    smpTick += 1 + skip;
+    smpStats.ticks++;
+    smpStats.lateSumUs += late;
+    if(late > smpStats.lateMaxUs)
+        smpStats.lateMaxUs = late;
+
+    FilterTick();                               // IIR state, this context only
+    for(ch = 0; ch < SAMPLE_CHANNELS; ch++)
+    {
+        if(!smpCh[ch].periodMs || (s32)(smpTick - smpNext[ch]) < 0)
+            continue;
+
+        per = smpCh[ch].curMs / SAMPLE_TICK_MS;
+        behind = (smpTick - smpNext[ch]) / per;
+        smpCh[ch].missed += behind;             // Deadlines skipped
+        smpNext[ch] += (behind + 1) * per;
+
+        if(!now)
+            now = RTCStampMs(&ms);              // Stamp at acquisition
+        r.time  = now;
+        r.ms    = ms;
+        r.value = ChanRead(ch);
+        r.ch    = LOG_T_SAMPLE | ch;
+        r.flags = ChanOverSp(ch, r.value) ? LOG_F_OVER_SP : 0;
+        perMs   = smpCh[ch].curMs;
+        StatsAdd(ch, r.value, now, perMs);
+        if(PolicySample(ch, &r, &perMs))
+            LogAppend(&r);
+        smpCh[ch].taken++;
+
+        if(perMs != smpCh[ch].curMs)           // Adaptive rate
+        {
+            smpCh[ch].curMs = perMs;
+            smpNext[ch] = smpTick + perMs / SAMPLE_TICK_MS;
+        }
+    }
+
+    AlarmCheck();                               // Every tick, all channels
+}
+
+/*----------------------------------------------------
+  SamplerInit()
+
+  Periods from the channel table (ChanInit() first);
+  starts the Timer0 MR1 tick.
+----------------------------------------------------*/
+void SamplerInit(void)
+{
+    u8 ch;
+
+    smpTick = 0;
+    for(ch = 0; ch < SAMPLE_CHANNELS; ch++)
+        if(!SamplerSetPeriod(ch, ChanCfg(ch)->periodMs))
+            SamplerSetPeriod(ch, 0);
+    TimebasePeriodic(SAMPLE_TICK_US, SamplerTick);
+}
+
+/*----------------------------------------------------
+  SamplerSetPeriod()
+
+  Sets a channel's period (0 = off) and clears its
+  counters; the first sample follows one period
+  later. Returns 0 for an invalid channel or period.
+----------------------------------------------------*/
+u8 SamplerSetPeriod(u8 ch, u32 periodMs)
+{
+    if(ch >= SAMPLE_CHANNELS)
+        return 0;
+    if(periodMs && (periodMs < SAMPLE_PERIOD_MIN || periodMs > SAMPLE_PERIOD_MAX ||
+                    periodMs % SAMPLE_TICK_MS))
+        return 0;
+
+    VICIntEnClr = (1<<TIMER0_VIC_CHNO);     // Tick must not see half an update
+    smpCh[ch].periodMs = periodMs;
+    smpCh[ch].curMs = periodMs;
+    smpCh[ch].taken = 0;
+    smpCh[ch].missed = 0;
+    smpNext[ch] = smpTick + periodMs / SAMPLE_TICK_MS;
+    VICIntEnable = (1<<TIMER0_VIC_CHNO);
+    return 1;
+}
+
+/*----------------------------------------------------
+  SamplerChannel() / SamplerStats()
+----------------------------------------------------*/
+const sample_ch_t *SamplerChannel(u8 ch)
+{
+    return &smpCh[ch];
+}
+
+const sample_stats_t *SamplerStats(void)
+{
+    return &smpStats;
+}
+
+/*----------------------------------------------------
+  SamplerSlackMs()
+
+  Time until the next sample of any channel: how long
+  the CPU may be stalled (flash erase) without making
+  a sample late.
+----------------------------------------------------*/
+u32 SamplerSlackMs(void)
+{
+    u32 slack = 0xFFFFFFFF, t;
+    u8 ch;
+
+    for(ch = 0; ch < SAMPLE_CHANNELS; ch++)
+    {
+        if(!smpCh[ch].periodMs)
+            continue;
+        t = (smpNext[ch] - smpTick) * SAMPLE_TICK_MS;
+        if(t < slack)
+            slack = t;
+    }
+    return slack;
+}
@@ -0,0 +1,42 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "types.h"
+#include "chan.h"
+
+/*----------------------------------------------------
+  Sampling scheduler
+
+  Per-channel periods in ms, multiples of the 10 ms
+  sampler tick (Timer0 MR1), from SAMPLE_PERIOD_MIN
+  up to SAMPLE_PERIOD_MAX. 0 turns a channel off.
+----------------------------------------------------*/
+#define SAMPLE_TICK_US      10000
+#define SAMPLE_TICK_MS      (SAMPLE_TICK_US / 1000)
+#define SAMPLE_CHANNELS     CHAN_COUNT
+#define SAMPLE_PERIOD_MIN   SAMPLE_TICK_MS
+#define SAMPLE_PERIOD_MAX   86400000    // 24 h
+
+typedef struct
+{
+    u32 periodMs;           // As set, 0 = off
+    u32 curMs;              // In use (the adaptive policy changes it)
+    u32 taken;              // samples taken (logged or not)
+    u32 missed;             // deadlines passed without a sample
+} sample_ch_t;
+
+typedef struct
+{
+    u32 ticks;              // sampler interrupts
+    u32 lostTicks;          // ticks skipped (interrupts off too long)
+    u32 lateMaxUs;          // worst MR1 match to sample latency
+    u32 lateSumUs;          // for the average
+} sample_stats_t;
+
+void SamplerInit(void);
+u8 SamplerSetPeriod(u8 ch, u32 periodMs);
+const sample_ch_t *SamplerChannel(u8 ch);
+const sample_stats_t *SamplerStats(void);
+u32 SamplerSlackMs(void);
+
+#endif
@@ -0,0 +1,127 @@
+#include <LPC21xx.h>      // LPC21xx register definitions
+#include "types.h"        // Custom data types
+#include "delay.h"        // GetTickMs / GetTickUs
+#include "uart.h"         // SchedReport() output
+#include "sched.h"        // Task table
+
+/*----------------------------------------------------
+  Cooperative scheduler
+
+  Tasks are released by the 1 ms Timer0 tick and run
+  to completion, highest priority first. When nothing
+  is ready the CPU idles until the next interrupt.
+----------------------------------------------------*/
+#define PCON_IDL  (1<<0)   // PCON: idle mode
+
+static task_t *tasks;
+static u8 nTasks;
+static u32 idleMs;
+
+/*----------------------------------------------------
+  SchedInit()
+
+  Takes the task table and releases every task on
+  the next tick.
+----------------------------------------------------*/
+void SchedInit(task_t *tbl, u8 n)
+{
+    u8 i;
+    u32 now = GetTickMs();
+
+    tasks = tbl;
+    nTasks = n;
+    for (i = 0; i < n; i++)
+    {
+        tbl[i].nextMs = now;
+        tbl[i].runs = tbl[i].maxUs = tbl[i].totalUs = tbl[i].late = 0;
+    }
+}
+
+/*----------------------------------------------------
+  SchedRun()
+
+  Scheduler loop, never returns. Runtime of each task
+  is measured with the 1 us timebase.
+----------------------------------------------------*/
+void SchedRun(void)
+{
+    task_t *t;
+    u32 now, start, dt;
+    u8 i;
+
+    while (1)
+    {
+        now = GetTickMs();
+        t = 0;
+        for (i = 0; i < nTasks; i++)
+        {
+            if ((s32)(now - tasks[i].nextMs) < 0)
+                continue;               // Not released yet
+            if (!t || tasks[i].prio < t->prio)
+                t = &tasks[i];
+        }
+
+        if (!t)
+        {
+            start = now;
+            PCON = PCON_IDL;            // Sleep until the next tick
+            idleMs += GetTickMs() - start;
+            continue;
+        }
+
+        // Next release; skip whole periods that were missed
+        if (now - t->nextMs >= t->periodMs)
+        {
+            t->late++;
+            t->nextMs = now + t->periodMs;
+        }
+        else
+            t->nextMs += t->periodMs;
+
+        start = GetTickUs();
+        t->fn();
+        dt = GetTickUs() - start;
+
+        t->runs++;
+        t->totalUs += dt;
+        if (dt > t->maxUs)
+            t->maxUs = dt;
+    }
+}
+
+/*----------------------------------------------------
+  SchedReport()
+
+  GET TASKS body (cmd.c): for every task its name,
+  runs, worst and average runtime (us) and releases
+  missed, as " name runs/max/avg/late". The caller
+  ends the line.
+----------------------------------------------------*/
+void SchedReport(void)
+{
+    u8 i;
+
+    for (i = 0; i < nTasks; i++)
+    {
+        UARTTxChar(' ');
+        UARTTxStr((s8 *)tasks[i].name);
+        UARTTxChar(' ');
+        UARTTxU32(tasks[i].runs);
+        UARTTxChar('/');
+        UARTTxU32(tasks[i].maxUs);
+        UARTTxChar('/');
+        UARTTxU32(tasks[i].runs ? tasks[i].totalUs / tasks[i].runs : 0);
+        UARTTxChar('/');
+        UARTTxU32(tasks[i].late);
+    }
+}
+
+/*----------------------------------------------------
+  SchedIdleMs()
+
+  Milliseconds spent in idle mode so far.
+----------------------------------------------------*/
+u32 SchedIdleMs(void)
+{
+    return idleMs;
+}
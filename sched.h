@@ -0,0 +1,32 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include "types.h"
+
+/*----------------------------------------------------
+  task_t
+
+  One entry of the fixed task table handed to
+  SchedInit(). Only the first four fields are filled
+  in by the application; the rest is bookkeeping.
+----------------------------------------------------*/
+typedef struct
+{
+    const char *name;       // short name for SchedReport()
+    void (*fn)(void);       // task body, must not block
+    u32 periodMs;           // release period in ms
+    u8  prio;               // 0 = highest
+
+    u32 nextMs;             // next release (tick ms)
+    u32 runs;               // completed runs
+    u32 maxUs;              // worst runtime seen
+    u32 totalUs;            // sum of runtimes (for the average)
+    u32 late;               // releases missed by a whole period
+} task_t;
+
+void SchedInit(task_t *, u8);
+void SchedRun(void);
+void SchedReport(void);
+u32 SchedIdleMs(void);
+
+#endif
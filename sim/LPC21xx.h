@@ -0,0 +1,191 @@
+/*----------------------------------------------------
+  LPC21xx.h  (host simulator version)
+
+  Drop-in replacement for Keil's <LPC21xx.h> used when
+  the firmware is built on Linux. Every peripheral
+  register is an lvalue in a simulated register file;
+  each access goes through sim_reg() so that the models
+  in sim.c can see writes and refresh read values
+  (ADC result, UART status, RTC counters, timers ...).
+----------------------------------------------------*/
+#ifndef __LPC21xx_H
+#define __LPC21xx_H
+
+enum
+{
+    /* GPIO */
+    SIM_IOPIN0, SIM_IOSET0, SIM_IODIR0, SIM_IOCLR0,
+    SIM_IOPIN1, SIM_IOSET1, SIM_IODIR1, SIM_IOCLR1,
+
+    /* Pin connect block */
+    SIM_PINSEL0, SIM_PINSEL1, SIM_PINSEL2,
+
+    /* UART0 */
+    SIM_U0RBR, SIM_U0THR, SIM_U0IER, SIM_U0IIR, SIM_U0FCR,
+    SIM_U0LCR, SIM_U0LSR, SIM_U0SCR, SIM_U0DLL, SIM_U0DLM,
+    SIM_U0FDR,
+
+    /* ADC */
+    SIM_ADCR, SIM_ADDR,
+
+    /* RTC */
+    SIM_ILR, SIM_CTC, SIM_CCR, SIM_CIIR, SIM_AMR,
+    SIM_CTIME0, SIM_CTIME1, SIM_CTIME2,
+    SIM_SEC, SIM_MIN, SIM_HOUR, SIM_DOM, SIM_DOW, SIM_DOY,
+    SIM_MONTH, SIM_YEAR, SIM_PREINT, SIM_PREFRAC,
+
+    /* Timer0 / Timer1 */
+    SIM_T0IR, SIM_T0TCR, SIM_T0TC, SIM_T0PR, SIM_T0PC, SIM_T0MCR,
+    SIM_T0MR0, SIM_T0MR1, SIM_T0MR2, SIM_T0MR3,
+    SIM_T1IR, SIM_T1TCR, SIM_T1TC, SIM_T1PR, SIM_T1PC, SIM_T1MCR,
+    SIM_T1MR0, SIM_T1MR1, SIM_T1MR2, SIM_T1MR3,
+
+    /* System control */
+    SIM_PCON,
+
+    /* Vectored interrupt controller */
+    SIM_VICIRQStatus, SIM_VICRawIntr, SIM_VICIntSelect,
+    SIM_VICIntEnable, SIM_VICIntEnClr, SIM_VICSoftInt,
+    SIM_VICSoftIntClr, SIM_VICVectAddr, SIM_VICDefVectAddr,
+    SIM_VICVectAddr0,
+    SIM_VICVectCntl0 = SIM_VICVectAddr0 + 16,
+
+    SIM_NREGS = SIM_VICVectCntl0 + 16
+};
+
+volatile unsigned long *sim_reg(int id);
+
+/* On-chip flash and the IAP entry point (see iap_defines.h) */
+extern unsigned char sim_flash[];
+void sim_iap(unsigned long *cmd, unsigned long *result);
+
+#define FLASH_BASE_PTR ((const unsigned char *)sim_flash)
+#define IAP_ENTRY      sim_iap
+
+#define SIM_R(name) (*sim_reg(SIM_##name))
+
+/* GPIO */
+#define IOPIN0   SIM_R(IOPIN0)
+#define IOSET0   SIM_R(IOSET0)
+#define IODIR0   SIM_R(IODIR0)
+#define IOCLR0   SIM_R(IOCLR0)
+#define IOPIN1   SIM_R(IOPIN1)
+#define IOSET1   SIM_R(IOSET1)
+#define IODIR1   SIM_R(IODIR1)
+#define IOCLR1   SIM_R(IOCLR1)
+
+/* Pin connect block */
+#define PINSEL0  SIM_R(PINSEL0)
+#define PINSEL1  SIM_R(PINSEL1)
+#define PINSEL2  SIM_R(PINSEL2)
+
+/* UART0 */
+#define U0RBR    SIM_R(U0RBR)
+#define U0THR    SIM_R(U0THR)
+#define U0IER    SIM_R(U0IER)
+#define U0IIR    SIM_R(U0IIR)
+#define U0FCR    SIM_R(U0FCR)
+#define U0LCR    SIM_R(U0LCR)
+#define U0LSR    SIM_R(U0LSR)
+#define U0SCR    SIM_R(U0SCR)
+#define U0DLL    SIM_R(U0DLL)
+#define U0DLM    SIM_R(U0DLM)
+#define U0FDR    SIM_R(U0FDR)
+
+/* ADC */
+#define ADCR     SIM_R(ADCR)
+#define ADDR     SIM_R(ADDR)
+
+/* RTC */
+#define ILR      SIM_R(ILR)
+#define CTC      SIM_R(CTC)
+#define CCR      SIM_R(CCR)
+#define CIIR     SIM_R(CIIR)
+#define AMR      SIM_R(AMR)
+#define CTIME0   SIM_R(CTIME0)
+#define CTIME1   SIM_R(CTIME1)
+#define CTIME2   SIM_R(CTIME2)
+#define SEC      SIM_R(SEC)
+#define MIN      SIM_R(MIN)
+#define HOUR     SIM_R(HOUR)
+#define DOM      SIM_R(DOM)
+#define DOW      SIM_R(DOW)
+#define DOY      SIM_R(DOY)
+#define MONTH    SIM_R(MONTH)
+#define YEAR     SIM_R(YEAR)
+#define PREINT   SIM_R(PREINT)
+#define PREFRAC  SIM_R(PREFRAC)
+
+/* Timer0 */
+#define T0IR     SIM_R(T0IR)
+#define T0TCR    SIM_R(T0TCR)
+#define T0TC     SIM_R(T0TC)
+#define T0PR     SIM_R(T0PR)
+#define T0PC     SIM_R(T0PC)
+#define T0MCR    SIM_R(T0MCR)
+#define T0MR0    SIM_R(T0MR0)
+#define T0MR1    SIM_R(T0MR1)
+#define T0MR2    SIM_R(T0MR2)
+#define T0MR3    SIM_R(T0MR3)
+
+/* Timer1 */
+#define T1IR     SIM_R(T1IR)
+#define T1TCR    SIM_R(T1TCR)
+#define T1TC     SIM_R(T1TC)
+#define T1PR     SIM_R(T1PR)
+#define T1PC     SIM_R(T1PC)
+#define T1MCR    SIM_R(T1MCR)
+#define T1MR0    SIM_R(T1MR0)
+#define T1MR1    SIM_R(T1MR1)
+#define T1MR2    SIM_R(T1MR2)
+#define T1MR3    SIM_R(T1MR3)
+
+/* System control */
+#define PCON     SIM_R(PCON)
+
+/* VIC */
+#define VICIRQStatus   SIM_R(VICIRQStatus)
+#define VICRawIntr     SIM_R(VICRawIntr)
+#define VICIntSelect   SIM_R(VICIntSelect)
+#define VICIntEnable   SIM_R(VICIntEnable)
+#define VICIntEnClr    SIM_R(VICIntEnClr)
+#define VICSoftInt     SIM_R(VICSoftInt)
+#define VICSoftIntClr  SIM_R(VICSoftIntClr)
+#define VICVectAddr    SIM_R(VICVectAddr)
+#define VICDefVectAddr SIM_R(VICDefVectAddr)
+
+#define VICVectAddr0   (*sim_reg(SIM_VICVectAddr0 + 0))
+#define VICVectAddr1   (*sim_reg(SIM_VICVectAddr0 + 1))
+#define VICVectAddr2   (*sim_reg(SIM_VICVectAddr0 + 2))
+#define VICVectAddr3   (*sim_reg(SIM_VICVectAddr0 + 3))
+#define VICVectAddr4   (*sim_reg(SIM_VICVectAddr0 + 4))
+#define VICVectAddr5   (*sim_reg(SIM_VICVectAddr0 + 5))
+#define VICVectAddr6   (*sim_reg(SIM_VICVectAddr0 + 6))
+#define VICVectAddr7   (*sim_reg(SIM_VICVectAddr0 + 7))
+#define VICVectAddr8   (*sim_reg(SIM_VICVectAddr0 + 8))
+#define VICVectAddr9   (*sim_reg(SIM_VICVectAddr0 + 9))
+#define VICVectAddr10  (*sim_reg(SIM_VICVectAddr0 + 10))
+#define VICVectAddr11  (*sim_reg(SIM_VICVectAddr0 + 11))
+#define VICVectAddr12  (*sim_reg(SIM_VICVectAddr0 + 12))
+#define VICVectAddr13  (*sim_reg(SIM_VICVectAddr0 + 13))
+#define VICVectAddr14  (*sim_reg(SIM_VICVectAddr0 + 14))
+#define VICVectAddr15  (*sim_reg(SIM_VICVectAddr0 + 15))
+
+#define VICVectCntl0   (*sim_reg(SIM_VICVectCntl0 + 0))
+#define VICVectCntl1   (*sim_reg(SIM_VICVectCntl0 + 1))
+#define VICVectCntl2   (*sim_reg(SIM_VICVectCntl0 + 2))
+#define VICVectCntl3   (*sim_reg(SIM_VICVectCntl0 + 3))
+#define VICVectCntl4   (*sim_reg(SIM_VICVectCntl0 + 4))
+#define VICVectCntl5   (*sim_reg(SIM_VICVectCntl0 + 5))
+#define VICVectCntl6   (*sim_reg(SIM_VICVectCntl0 + 6))
+#define VICVectCntl7   (*sim_reg(SIM_VICVectCntl0 + 7))
+#define VICVectCntl8   (*sim_reg(SIM_VICVectCntl0 + 8))
+#define VICVectCntl9   (*sim_reg(SIM_VICVectCntl0 + 9))
+#define VICVectCntl10  (*sim_reg(SIM_VICVectCntl0 + 10))
+#define VICVectCntl11  (*sim_reg(SIM_VICVectCntl0 + 11))
+#define VICVectCntl12  (*sim_reg(SIM_VICVectCntl0 + 12))
+#define VICVectCntl13  (*sim_reg(SIM_VICVectCntl0 + 13))
+#define VICVectCntl14  (*sim_reg(SIM_VICVectCntl0 + 14))
+#define VICVectCntl15  (*sim_reg(SIM_VICVectCntl0 + 15))
+
+#endif
@@ -0,0 +1,1710 @@
+/*----------------------------------------------------
+  bench.c
+
+  Benchmarks for the firmware modules on the simulated
+  board. Each case calls real driver code and reports:
+
+    sim/op   simulated time the CPU spends per operation
+             (delays, busy waits, peripheral accesses)
+    host/op  host CPU time per operation (relative cost
+             of pure computation, not ARM7 cycles)
+    plus the peripheral traffic it caused.
+
+  Usage: bench [case ...]     (no argument = all cases)
+----------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sim.h"
+
+#include "../types.h"
+#include "../delay.h"
+#include "../lcd.h"
+#include "../uart.h"
+#include "../uart_defines.h"
+#include "../rtc.h"
+#include <LPC21xx.h>
+#include "../lm35.h"
+#include "../adc.h"
+#include "../adc_defines.h"
+#include "../data_logger.h"
+#include "../keyPd.h"
+#include "../filter.h"
+#include "../logbuf.h"
+#include "../flashlog.h"
+#include "../cmd.h"
+#include "../dump.h"
+#include "../sampler.h"
+#include "../chan.h"
+#include "../alarm.h"
+#include "../stats.h"
+#include "../logpolicy.h"
+#include "../logcodec.h"
+#include "../fmt.h"
+#include "../iap.h"
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define bench_cycles()  __rdtsc()   // Host TSC
+#else
+#define bench_cycles()  0ULL
+#endif
+
+void Timer1_ISR(void);       // keypad.c, called directly below
+
+static sim_stats_t s0;
+static uint64_t t0_sim, paused_sim, pause_at_sim;
+static double paused_host;
+static struct timespec t0_host, pause_at_host;
+
+static double host_since(const struct timespec *t)
+{
+    struct timespec t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t->tv_sec) * 1e9 + (t1.tv_nsec - t->tv_nsec);
+}
+
+static void bench_begin(void)
+{
+    s0 = *sim_stats();
+    t0_sim = sim_time_ns();
+    paused_sim = 0;
+    paused_host = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0_host);
+}
+
+/* Exclude set-up/drain work between pause and resume from the timing */
+static void bench_pause(void)
+{
+    pause_at_sim = sim_time_ns();
+    clock_gettime(CLOCK_MONOTONIC, &pause_at_host);
+}
+
+static void bench_resume(void)
+{
+    paused_sim += sim_time_ns() - pause_at_sim;
+    paused_host += host_since(&pause_at_host);
+}
+
+static void bench_end(const char *name, unsigned long ops)
+{
+    const sim_stats_t *s = sim_stats();
+    double host_ns, sim_ns;
+
+    host_ns = host_since(&t0_host) - paused_host;
+    sim_ns = (double)(sim_time_ns() - t0_sim - paused_sim);
+
+    printf("%-24s %8lu ops  sim/op %12.1f us  host/op %9.1f ns  lcd %6.1f/op  uart %6.1f B/op\n",
+           name, ops, sim_ns / ops / 1e3, host_ns / ops,
+           (double)(s->lcd_cmds + s->lcd_data - s0.lcd_cmds - s0.lcd_data) / ops,
+           (double)(s->uart_tx_bytes - s0.uart_tx_bytes) / ops);
+}
+
+/* RAM log record seq, unpacked (valid until the next call) */
+static const log_rec_t *log_at(u32 seq)
+{
+    static log_rec_t r;
+
+    return LogRead(seq, &r) ? &r : 0;
+}
+
+/*----------------------------------------------------
+  One pass of the main-loop display code after the
+  RTC second has ticked (first full paint untimed)
+----------------------------------------------------*/
+static void lcd_pass(void)
+{
+    rtc_time_t t;
+    u32 now = RTCSnapshot(&t);
+
+    DisplayRTCTime(t.hour, t.min, t.sec);
+    DisplayRTCDate(t.dom, t.month, t.year);
+    DisplayRTCDay(t.dow);
+    DispRTCTemp(now);
+    FlushLCD();
+}
+
+static void bench_lcd_refresh(void)
+{
+    int i, n = 20;
+
+    InitLCD();
+    SetRTCTimeInfo(11, 51, 1);
+    SetRTCDateInfo(3, 1, 2026);
+    lcd_pass();
+
+    bench_begin();
+    for (i = 0; i < n; i++)
+    {
+        bench_pause();
+        sim_advance_ns(SIM_NS_PER_S);
+        bench_resume();
+        lcd_pass();
+    }
+    bench_end("lcd_refresh", n);
+}
+
+/*----------------------------------------------------
+  Raw LCD character throughput (one 16x2 screen)
+----------------------------------------------------*/
+static void bench_lcd_chars(void)
+{
+    int i, r, c, n = 10;
+
+    InitLCD();
+    bench_begin();
+    for (i = 0; i < n; i++)
+    {
+        for (r = 0; r < 2; r++)
+        {
+            CmdLCD(r ? 0xC0 : 0x80);
+            for (c = 0; c < 16; c++)
+                CharLCD('A' + c);
+        }
+    }
+    bench_end("lcd_chars", n * 32);
+    printf("%-24s %8.0f chars/s\n", "",
+           n * 32 * 1e9 / (double)(sim_time_ns() - t0_sim));
+}
+
+/*----------------------------------------------------
+  One [INFO] log line as sent from main(): time the
+  caller is held up; the line drains untimed.
+----------------------------------------------------*/
+static void bench_uart_line(void)
+{
+    rtc_time_t t;
+    int i, n = 20;
+
+    InitUART();
+    bench_begin();
+    for (i = 0; i < n; i++)
+    {
+        DispUARTTemp(CH0);
+        RTCSnapshot(&t);
+        DisplayUARTTime(t.hour, t.min, t.sec);
+        DisplayUARTDate(t.dom, t.month, t.year);
+        UARTTxStr("\n\r");
+        bench_pause();
+        UARTTxFlush();
+        bench_resume();
+    }
+    bench_end("uart_log_line", n);
+}
+
+/*----------------------------------------------------
+  Single LM35 reading (conversion + float math)
+----------------------------------------------------*/
+static void bench_lm35_read(void)
+{
+    volatile u32 t;
+    int i, n = 10000;
+
+    bench_begin();
+    for (i = 0; i < n; i++)
+        t = Read_LM35('C');
+    bench_end("lm35_read", n);
+    (void)t;
+}
+
+/*----------------------------------------------------
+  LM35 reading served from the burst ring (no
+  conversion), plus the per-channel sample rate
+----------------------------------------------------*/
+static void bench_adc_burst(void)
+{
+    volatile u32 t;
+    u32 c0;
+    uint64_t irq0;
+    int i, n = 10000;
+
+    ADCStartBurst(ADC_BURST_CHANNELS);
+    bench_begin();
+    for (i = 0; i < n; i++)
+        t = Read_LM35('C');
+    bench_end("lm35_read_burst", n);
+    (void)t;
+
+    c0 = ADCSampleCount(CH0);
+    irq0 = sim_stats()->irqs;
+    sim_advance_ns(SIM_NS_PER_S);
+    printf("%-24s %8lu samples/s per channel, %lu irq/s\n", "",
+           (unsigned long)(ADCSampleCount(CH0) - c0),
+           (unsigned long)(sim_stats()->irqs - irq0));
+    ADCStopBurst();
+}
+
+/*----------------------------------------------------
+  Counts -> temperature: the float math Read_LM35 used
+  to do (double/float, truncated) against LM35Deci().
+  Pure computation, so only host/op moves, and the
+  host has an FPU. On the ARM7TDMI the float path is
+  five soft-float library calls (ui2d, dmul, d2f,
+  fmul, f2uiz); the fixed path is two MULs, two adds
+  and two shifts (plus one MUL for 'F').
+----------------------------------------------------*/
+static u32 lm35_float_path(u32 adcDVal)
+{
+    f32 eAR = adcDVal * (3.3 / 1023);
+    f32 tDeg = eAR * 100;
+
+    return tDeg;
+}
+
+static void bench_lm35_convert(void)
+{
+    volatile u32 f = 0;
+    volatile s32 d = 0;
+    double err, maxErr = 0;
+    int i, r, n = 1024 * 200;
+
+    bench_begin();
+    for (r = 0; r < 200; r++)
+        for (i = 0; i < 1024; i++)
+            f = lm35_float_path(i);
+    bench_end("lm35_conv_float", n);
+
+    bench_begin();
+    for (r = 0; r < 200; r++)
+        for (i = 0; i < 1024; i++)
+            d = LM35Deci(i, CH0, 'C');
+    bench_end("lm35_conv_fixed", n);
+
+    for (i = 0; i < 1024; i++)
+    {
+        err = LM35Deci(i, CH0, 'C') - i * 3300.0 / 1023;
+        if (err < 0)
+            err = -err;
+        if (err > maxErr)
+            maxErr = err;
+    }
+    printf("%-24s %8.2f deci-C max error vs exact (float path: 1 C steps)\n", "", maxErr);
+    (void)f;
+    (void)d;
+}
+
+/*----------------------------------------------------
+  Filter stage: cost of one sampler tick's
+  FilterTick() and a FilterRead(), and the noise
+  left in the temperature. AIN0 sits at 30.5 C
+  with 1 count RMS of ADC noise (~3.2 deci-C); burst
+  runs and each read is 5 ms after the previous one.
+  host/op includes the pause/resume around the 5 ms
+  step; filt_baseline is that overhead alone.
+----------------------------------------------------*/
+static void bench_filters(void)
+{
+    static const struct
+    {
+        const char *name;
+        u8 type, param;
+    } f[] =
+    {
+        { "filt_none",        FILT_NONE,       0 },
+        { "filt_oversample1", FILT_OVERSAMPLE, 1 },
+        { "filt_oversample2", FILT_OVERSAMPLE, 2 },
+        { "filt_oversample3", FILT_OVERSAMPLE, 3 },
+        { "filt_movavg8",     FILT_MOVAVG,     8 },
+        { "filt_movavg32",    FILT_MOVAVG,     32 },
+        { "filt_median3",     FILT_MEDIAN,     3 },
+        { "filt_median9",     FILT_MEDIAN,     9 },
+        { "filt_iir4",        FILT_IIR,        4 },
+        { "filt_iir6",        FILT_IIR,        6 },
+    };
+    static s32 v[2000];
+    unsigned k;
+    int i, n = 2000;
+    double mean, var;
+
+    sim_set_noise(0, 1.0);
+    ADCStartBurst(ADC_BURST_CHANNELS);
+
+    bench_begin();
+    for (i = 0; i < n; i++)
+    {
+        bench_pause();
+        sim_advance_ns(5 * SIM_NS_PER_MS);
+        bench_resume();
+    }
+    bench_end("filt_baseline", n);
+
+    for (k = 0; k < sizeof f / sizeof f[0]; k++)
+    {
+        FilterSet(CH0, f[k].type, f[k].param);
+        FilterTick();
+
+        bench_begin();
+        for (i = 0; i < n; i++)
+        {
+            bench_pause();
+            sim_advance_ns(5 * SIM_NS_PER_MS);
+            bench_resume();
+            FilterTick();
+            v[i] = LM35DeciFrac(FilterRead(CH0), FILT_FRAC_BITS, CH0, 'C');
+        }
+        bench_end(f[k].name, n);
+
+        mean = var = 0;
+        for (i = 0; i < n; i++)
+            mean += v[i];
+        mean /= n;
+        for (i = 0; i < n; i++)
+            var += (v[i] - mean) * (v[i] - mean);
+        printf("%-24s %8.2f deci-C RMS noise, mean %.1f\n", "", sqrt(var / n), mean);
+    }
+    ADCStopBurst();
+}
+
+/*----------------------------------------------------
+  RAM log: append a record, and read it back as the
+  UART text consumer does
+----------------------------------------------------*/
+static void bench_log_append(void)
+{
+    log_rec_t r = { 0, 305, LOG_T_SAMPLE, 0 };
+    u32 seq;
+    int i, n = 100000;
+
+    LogInit();
+    bench_begin();
+    for (i = 0; i < n; i++)
+    {
+        r.time += 60;
+        LogAppend(&r);
+    }
+    bench_end("log_append", n);
+
+    InitUART();
+    bench_begin();
+    for (seq = LogHead() - 20; seq < LogHead(); seq++)
+    {
+        DispUARTRec(log_at(seq));
+        bench_pause();
+        UARTTxFlush();
+        bench_resume();
+    }
+    bench_end("log_rec_to_uart_text", 20);
+    printf("%-24s %8u records held (%u overwritten), 12 B each in RAM, 8 B packed\n", "",
+           (unsigned)(LogHead() - LogOldest()), (unsigned)LogOverwritten());
+}
+
+/*----------------------------------------------------
+  Flash log: 30 days of one record per minute moved
+  to flash with an unlimited budget. Reports the cost
+  of one service call, write amplification, erases
+  per sector and the lifetime at 100k erase cycles;
+  then checks the log survives a reboot.
+----------------------------------------------------*/
+#ifndef BENCH_FLASH_IMAGE
+#define BENCH_FLASH_IMAGE "build/flash_full.bin"
+#endif
+
+static log_rec_t flash_rec = { 0, 305, LOG_T_SAMPLE, 0 };
+
+/* Logs n records one minute apart and moves them to flash */
+static void flash_fill(u32 n)
+{
+    u32 i;
+
+    for (i = 0; i < n; i++)
+    {
+        flash_rec.time += 60;
+        flash_rec.value = 250 + flash_rec.time / 60 % 100;
+        LogAppend(&flash_rec);
+        FlashLogService(1000);      // erase (if due) ...
+        FlashLogService(1000);      // ... then stage / program
+    }
+}
+
+static void bench_flash_wear(void)
+{
+    const sim_stats_t *s = sim_stats();
+    log_rec_t q;
+    u32 i, n = 30 * 24 * 60, end, bad = 0;
+    uint64_t e0, p0, b0, max = 0, sect[FL_SECTORS + 1];
+    double days;
+
+    sim_flash_erase_all();
+    LogInit();
+    FlashLogInit();
+    e0 = s->flash_erases;
+    p0 = s->flash_programs;
+    b0 = s->flash_prog_bytes;
+    for (i = 0; i <= FL_SECTORS; i++)
+        sect[i] = s->flash_sector_erases[FL_FIRST_SECTOR + i];
+
+    flash_rec.time = 0;
+    bench_begin();
+    flash_fill(n);
+    bench_end("flash_service", 2 * n);
+
+    printf("%-24s %8u records  %llu erases  %llu programs  write amp %.2f\n", "",
+           (unsigned)n, (unsigned long long)(s->flash_erases - e0),
+           (unsigned long long)(s->flash_programs - p0),
+           (double)(s->flash_prog_bytes - b0) / ((double)n * LOG_REC_BYTES));
+    printf("%-24s %8s erases/sector:", "", "");
+    for (i = 0; i <= FL_SECTORS; i++)
+    {
+        uint64_t e = s->flash_sector_erases[FL_FIRST_SECTOR + i] - sect[i];
+        printf(i == FL_JRNL ? ", journal %llu" : " %llu", (unsigned long long)e);
+        if (e > max) max = e;
+    }
+    days = (double)n / (24 * 60);
+    printf("  (lifetime %.0f years at 100k cycles)\n",
+           100000.0 * days / (max ? max : 1) / 365.0);
+
+    // Reboot: the end of the log must be found again
+    end = FlashLogEnd();
+    FlashLogInit();
+    for (i = FlashLogFirst(); i < FlashLogEnd(); i++)
+        if (!FlashLogRead(i, &q) || q.time != (i + 1) * 60)
+            bad++;
+    printf("%-24s %8s reboot end %s, %u records in flash, %u bad, %u lost\n", "", "",
+           end == FlashLogEnd() ? "ok" : "MISMATCH",
+           (unsigned)(FlashLogEnd() - FlashLogFirst()), (unsigned)bad,
+           (unsigned)FlashLogLost());
+}
+
+/*----------------------------------------------------
+  Flash log boot: FlashLogInit() on a full image (three
+  complete sectors, the fourth in its last block)
+  against reading every stored record, which is what
+  recovery without the sector index costs. The image
+  is left in BENCH_FLASH_IMAGE for logger_sim -f.
+----------------------------------------------------*/
+static void bench_flash_boot(void)
+{
+    log_rec_t q;
+    u32 i, n = 100, rec, ok = 0;
+
+    sim_set_flash_file(BENCH_FLASH_IMAGE);
+    sim_flash_erase_all();          // start from a blank image
+    LogInit();
+    FlashLogInit();
+    flash_rec.time = 0;
+    while (FlashLogIndex(FL_SECTORS - 1)->blocks < FL_BLOCKS - 1)
+        flash_fill(1);
+
+    bench_begin();
+    for (i = 0; i < n; i++)
+        FlashLogInit();
+    bench_end("flash_boot_index", n);
+
+    bench_begin();
+    for (i = 0; i < n; i++)
+        for (rec = FlashLogFirst(); rec < FlashLogEnd(); rec++)
+            FlashLogRead(rec, &q);
+    bench_end("flash_boot_full_scan", n);
+
+    bench_begin();
+    for (i = 0; i < n; i++)
+        FlashLogFind(flash_rec.time / 2);
+    bench_end("flash_find_time", n);
+
+    for (i = 0; i < FL_SECTORS; i++)
+        ok += FlashLogCheck(i);
+    printf("%-24s %8u records in flash, head sector %u/%u blocks, %u sectors pass CRC\n", "",
+           (unsigned)(FlashLogEnd() - FlashLogFirst()),
+           (unsigned)FlashLogIndex(FL_SECTORS - 1)->blocks, (unsigned)FL_BLOCKS,
+           (unsigned)ok);
+    sim_set_flash_file(NULL);
+}
+
+/*----------------------------------------------------
+  Command task: STATUS then a DUMP of 500 RAM records,
+  one CmdTask() run per 10 ms as scheduled. Shows the
+  worst single run (what sampling could be held up
+  by) and how long the dump takes on the wire.
+----------------------------------------------------*/
+static void bench_cmd(void)
+{
+    log_rec_t r = { 0, 305, LOG_T_SAMPLE, 0 };
+    const sim_stats_t *s = sim_stats();
+    uint64_t t, worst = 0, tx0, tx;
+    int i, n = 2000, done = 0;
+
+    sim_flash_erase_all();
+    LogInit();
+    FlashLogInit();
+    for (i = 0; i < 500; i++)
+    {
+        r.time += 60;
+        LogAppend(&r);
+    }
+    InitUART();
+    sim_uart_rx("STATUS\r\nDUMP\r\n", 14);
+    tx0 = tx = s->uart_tx_bytes;
+
+    bench_begin();
+    for (i = 0; i < n; i++)
+    {
+        bench_pause();
+        sim_advance_ns(10 * SIM_NS_PER_MS);
+        bench_resume();
+        t = sim_time_ns();
+        CmdTask();
+        t = sim_time_ns() - t;
+        if (t > worst)
+            worst = t;
+        if (s->uart_tx_bytes != tx)
+            done = i;               // last run that still saw output
+        tx = s->uart_tx_bytes;
+    }
+    bench_end("cmd_task", n);
+    printf("%-24s %8s worst run %.1f us, %llu bytes sent, dump done after %.2f s\n", "", "",
+           worst / 1e3, (unsigned long long)(s->uart_tx_bytes - tx0),
+           (done + 1) * 0.01);
+}
+
+/*----------------------------------------------------
+  Dump of a full flash log (2532 records): text lines
+  against SLIP frames, at 9600 and at 115200 baud via
+  U0FDR. DumpStep() runs every 10 ms as CmdTask would;
+  rates are over simulated time.
+----------------------------------------------------*/
+#define BENCH_DUMP_RECS 2532        // What five sectors held uncompressed
+
+static void bench_dump(void)
+{
+    static const struct { const char *name; u8 mode; u32 baud; } cfg[] =
+    {
+        { "dump_text_9600",  DUMP_TEXT, 9600 },
+        { "dump_bin_9600",   DUMP_BIN,  9600 },
+        { "dump_bin_115200", DUMP_BIN,  115200 },
+    };
+    const sim_stats_t *s = sim_stats();
+    FILE *cap;
+    static char out[96 * 1024];
+    char *p;
+    size_t len;
+    unsigned i, recs;
+    u32 rate;
+    uint64_t t0, tx0;
+    double secs;
+    int runs;
+
+    sim_flash_erase_all();
+    LogInit();
+    FlashLogInit();
+    flash_rec.time = 0;
+    flash_fill(BENCH_DUMP_RECS);
+
+    InitUART();
+    for (i = 0; i < sizeof cfg / sizeof cfg[0]; i++)
+    {
+        cap = tmpfile();
+        rate = UARTSetBaud(cfg[i].baud);
+        sim_set_uart_file(cap);
+        t0 = sim_time_ns();
+        tx0 = s->uart_tx_bytes;
+
+        bench_begin();
+        DumpStart(FlashLogFirst(), cfg[i].mode);
+        for (runs = 0; DumpActive() || !UARTTxIdle(); runs++)
+        {
+            DumpStep();
+            bench_pause();
+            sim_advance_ns(10 * SIM_NS_PER_MS);
+            bench_resume();
+        }
+        bench_end(cfg[i].name, runs);
+
+        secs = (sim_time_ns() - t0) / 1e9;
+        sim_set_uart_file(NULL);
+        recs = 0;
+        rewind(cap);
+        len = fread(out, 1, sizeof out - 1, cap);
+        out[len] = 0;
+        for (p = out; p + 8 <= out + len; p++)
+            if (!memcmp(p, "OK DUMP ", 8))
+                recs = atoi(p + 8);
+        fclose(cap);
+        printf("%-24s %8s %u baud: %u records in %.2f s, %.0f bytes/s, %.0f records/s\n",
+               "", "", (unsigned)rate, recs, secs,
+               (s->uart_tx_bytes - tx0) / secs, recs / secs);
+    }
+    UARTSetBaud(UART_BAUD);
+}
+
+/*----------------------------------------------------
+  Timer0-based delay accuracy: delay_ms(5)
+----------------------------------------------------*/
+/*----------------------------------------------------
+  Sampling scheduler: one minute of simulated time
+  with the four channels at 10 ms, 100 ms, 1 s and
+  60 s. Every deadline must be met (taken equal to
+  the expected count, nothing missed); lateness is
+  the MR1 match to sample time. A flash erase with
+  interrupts off (IAP) then has to show up as lost
+  ticks and missed samples, not silently vanish.
+----------------------------------------------------*/
+static void bench_sampler(void)
+{
+    static const u32 period[SAMPLE_CHANNELS] = { 10, 100, 1000, 60000 };
+    const sample_stats_t *st = SamplerStats();
+    const sample_ch_t *c;
+    u32 i, ms = 60000, bad = 0;
+
+    LogInit();
+    ADCStartBurst(ADC_BURST_CHANNELS);
+    SamplerInit();
+    for (i = 0; i < SAMPLE_CHANNELS; i++)
+        SamplerSetPeriod(i, period[i]);
+
+    bench_begin();
+    for (i = 0; i < ms; i++)
+        sim_advance_ns(SIM_NS_PER_MS);
+    bench_end("sampler_tick", st->ticks);
+
+    for (i = 0; i < SAMPLE_CHANNELS; i++)
+    {
+        c = SamplerChannel(i);
+        if (c->taken != ms / period[i] || c->missed)
+            bad++;
+        printf("%-24s %8s CH%u every %5u ms: %5u taken of %5u, %u missed\n", "", "",
+               (unsigned)i, (unsigned)period[i], (unsigned)c->taken,
+               (unsigned)(ms / period[i]), (unsigned)c->missed);
+    }
+    printf("%-24s %8s %u ticks, %u lost, late max %u us avg %u us, %s\n", "", "",
+           (unsigned)st->ticks, (unsigned)st->lostTicks, (unsigned)st->lateMaxUs,
+           (unsigned)(st->lateSumUs / st->ticks), bad ? "DEADLINES MISSED" : "no drops");
+
+    // One sector erase with interrupts off
+    sim_flash_erase_all();
+    IAPPrepare(FL_FIRST_SECTOR, FL_FIRST_SECTOR);
+    IAPErase(FL_FIRST_SECTOR, FL_FIRST_SECTOR);
+    sim_advance_ns(SIM_NS_PER_MS);
+    printf("%-24s %8s after erase: %u ticks lost, CH0 %u CH1 %u CH2 %u missed\n", "", "",
+           (unsigned)st->lostTicks, (unsigned)SamplerChannel(0)->missed,
+           (unsigned)SamplerChannel(1)->missed, (unsigned)SamplerChannel(2)->missed);
+}
+
+/*----------------------------------------------------
+  Channel table: the four inputs at different
+  temperatures, acquired in one pass (SampleTask),
+  then ten seconds of sampling with every channel at
+  1 s. Each record has to carry its channel id and
+  that channel's value (within 0.2 C of the input).
+----------------------------------------------------*/
+static void bench_chan(void)
+{
+    static const double temp[CHAN_COUNT] = { 30.5, 21.0, 45.2, 8.7 };
+    const log_rec_t *r;
+    u32 seq, recs[CHAN_COUNT] = { 0 }, bad = 0;
+    int i, n = 1000;
+
+    for (i = 0; i < CHAN_COUNT; i++)
+        sim_set_temp(i, temp[i]);
+    LogInit();
+    ADCStartBurst(ChanMask());
+    sim_advance_ns(100 * SIM_NS_PER_MS);    // fill the filters
+
+    bench_begin();
+    for (i = 0; i < n; i++)
+        ChanAcquire();
+    bench_end("chan_acquire_all", n);
+    for (i = 0; i < CHAN_COUNT; i++)
+        printf("%-24s %8s %s %5.1f C in, %5.1f C read\n", "", "",
+               ChanCfg(i)->name, temp[i], ChanLatest(i) / 10.0);
+
+    SamplerInit();
+    for (i = 0; i < CHAN_COUNT; i++)
+        ChanSetPeriod(i, 1000);
+    sim_advance_ns(10 * SIM_NS_PER_S);
+
+    for (seq = LogOldest(); seq < LogHead(); seq++)
+    {
+        r = log_at(seq);
+        if (LOG_TYPE(r) != LOG_T_SAMPLE)
+            continue;                   // AIN2 is over its set point
+        recs[LOG_CH(r)]++;
+        if (fabs(r->value / 10.0 - temp[LOG_CH(r)]) > 0.2)
+            bad++;
+    }
+    printf("%-24s %8s records per channel %u/%u/%u/%u, %u with a wrong value: %s\n", "", "",
+           (unsigned)recs[0], (unsigned)recs[1], (unsigned)recs[2], (unsigned)recs[3],
+           (unsigned)bad, bad ? "CHANNELS MIXED" : "ok");
+    ADCStopBurst();
+}
+
+/*----------------------------------------------------
+  Alarm latency: AIN0 steps from 30.5 C to 45 C
+  across its 40 C set point, 50 times at different
+  phases of the sampler tick. The simulator times
+  the crossing (as the ADC sees it) to the buzzer
+  edge and to the "[ALERT]" line on TXD0; the bench
+  times it to the alarm record in the log. LogTask
+  runs every 100 ms as in the task table.
+
+  Then a 6 C/min ramp against a 3 C/min rate limit,
+  and a latched alarm that must keep sounding after
+  the value drops until it is acknowledged.
+----------------------------------------------------*/
+static int alarm_wait(u32 *seq, uint64_t limit_ns, uint64_t *rec_ns)
+{
+    const sim_stats_t *s = sim_stats();
+    uint64_t t = sim_time_ns();
+    log_rec_t r;
+
+    while (sim_time_ns() - t < limit_ns)
+    {
+        sim_advance_ns(100 * SIM_NS_PER_US);
+        if (sim_time_ns() / (100 * SIM_NS_PER_MS) != (sim_time_ns() - 100 * SIM_NS_PER_US) / (100 * SIM_NS_PER_MS))
+            LogTask();
+        for ( ; LogRead(*seq, &r); (*seq)++)
+            if (LOG_TYPE(&r) == LOG_T_ALARM && r.flags && rec_ns && !*rec_ns)
+                *rec_ns = sim_time_ns() - s->alarm_cross_ns;
+        if (s->alarm_buzzer_ns && s->alarm_alert_ns && (!rec_ns || *rec_ns))
+            return 1;
+    }
+    return 0;
+}
+
+static void bench_alarm(void)
+{
+    const sim_stats_t *s = sim_stats();
+    alarm_cfg_t cfg = { ALM_LOW_OFF, 5, 0, 0 };
+    uint64_t buzMax = 0, buzSum = 0, recMax = 0, recSum = 0, txMax = 0, txSum = 0, rec, buz, tx;
+    u32 seq, missed = 0, t;
+    int i, n = 50;
+
+    InitUART();
+    LogInit();
+    ADCStartBurst(ChanMask());
+    AlarmInit();
+    SamplerInit();
+    seq = LogHead();
+    sim_advance_ns(SIM_NS_PER_S);
+
+    for (i = 0; i < n; i++)
+    {
+        sim_advance_ns(SIM_NS_PER_S + i * 730 * SIM_NS_PER_US);
+        sim_watch_alarm(0, 40.0);
+        sim_set_temp(0, 45.0);
+        rec = 0;
+        if (!alarm_wait(&seq, SIM_NS_PER_S, &rec))
+            missed++;
+        buz = s->alarm_buzzer_ns - s->alarm_cross_ns;
+        tx = s->alarm_alert_ns - s->alarm_cross_ns;
+        buzSum += buz;
+        recSum += rec;
+        txSum += tx;
+        if (buz > buzMax) buzMax = buz;
+        if (rec > recMax) recMax = rec;
+        if (tx > txMax) txMax = tx;
+
+        sim_set_temp(0, 30.5);
+        alarm_wait(&seq, SIM_NS_PER_S, NULL);   // clears; drains the UART
+    }
+    printf("%-24s %8s %d steps over SP, %u without an alarm\n", "", "", n, (unsigned)missed);
+    printf("%-24s %8s crossing to buzzer   max %6.1f ms avg %6.1f ms\n", "", "",
+           buzMax / 1e6, buzSum / 1e6 / n);
+    printf("%-24s %8s crossing to record   max %6.1f ms avg %6.1f ms\n", "", "",
+           recMax / 1e6, recSum / 1e6 / n);
+    printf("%-24s %8s crossing to [ALERT]  max %6.1f ms avg %6.1f ms (LogTask 100 ms)\n", "", "",
+           txMax / 1e6, txSum / 1e6 / n);
+
+    // Rate of change: 0.1 C per second is 6 C/min, limit 3 C/min;
+    // the steps above have to leave the window first
+    sim_advance_ns((ALM_RATE_WIN_S + 1) * SIM_NS_PER_S);
+    cfg.rateMax = 30;
+    AlarmSet(0, &cfg);
+    for (t = 0; t < 60 && !(AlarmChannel(0)->cond & ALM_RATE); t++)
+    {
+        sim_set_temp(0, 30.5 + t * 0.1);
+        sim_advance_ns(SIM_NS_PER_S);
+    }
+    printf("%-24s %8s 6 C/min ramp: rate alarm after %u s, rate %.1f C/min\n", "", "",
+           (unsigned)t, AlarmChannel(0)->rate / 10.0);
+    sim_set_temp(0, 30.5);
+    sim_advance_ns(15 * SIM_NS_PER_S);
+
+    // Latched: keeps sounding after the value is back until ACK
+    cfg.rateMax = 0;
+    cfg.latch = 1;
+    AlarmSet(0, &cfg);
+    sim_set_temp(0, 45.0);
+    sim_advance_ns(100 * SIM_NS_PER_MS);
+    sim_set_temp(0, 30.5);
+    sim_advance_ns(SIM_NS_PER_S);
+    i = AlarmBuzzer() && AlarmChannel(0)->state == ALM_S_LATCHED;
+    AlarmAck();
+    sim_advance_ns(20 * SIM_NS_PER_MS);
+    printf("%-24s %8s latched: %s after the value dropped, %s after ACK\n", "", "",
+           i ? "sounding" : "SILENT", AlarmBuzzer() ? "STILL SOUNDING" : "off");
+    ADCStopBurst();
+}
+
+/*----------------------------------------------------
+  Interval statistics: cost of one StatsAdd(), then
+  three minutes of AIN0 at 100 ms around 40 C with
+  noise, from 23:58 on New Year's Eve, so minute,
+  hour and day buckets all close. Each summary is
+  checked against the same samples taken from the
+  log and summed on the host in double. Last, the
+  UART bytes of a minute at 100 ms with every sample
+  logged against statistics only.
+----------------------------------------------------*/
+static void bench_stats(void)
+{
+    static const char *span[STAT_SPANS] = { "1m", "1h", "1d" };
+    static s32 val[2000];
+    static u32 when[2000];
+    const sim_stats_t *st = sim_stats();
+    stat_rec_t s;
+    log_rec_t r;
+    log_policy_t pol = { POLICY_ALL, 0, 0, 0 };
+    u32 seq, n = 0, i, j, k, bad = 0, over, min, max;
+    uint64_t tx0, tx[2];
+    double sum, ss, mean, sd;
+
+    StatsInit();
+    bench_begin();
+    for (i = 0; i < 100000; i++)
+        StatsAdd(3, 395 + i % 11, 1000000 + i / 100, 10);
+    bench_end("stats_add", 100000);
+    StatsInit();
+
+    SetRTCTimeInfo(23, 58, 0);
+    SetRTCDateInfo(31, 12, 2025);
+    sim_set_temp(0, 40.0);
+    sim_set_noise(0, 2.0);
+    LogInit();
+    ADCStartBurst(ChanMask());
+    SamplerInit();
+    ChanSetPeriod(0, 100);
+    for (seq = LogHead(), i = 0; i < 181; i++)
+    {
+        sim_advance_ns(SIM_NS_PER_S);
+        for ( ; LogRead(seq, &r); seq++)
+            if (LOG_TYPE(&r) == LOG_T_SAMPLE && n < 2000)
+            {
+                val[n] = r.value;
+                when[n++] = r.time;
+            }
+    }
+
+    for (k = StatsOldest(); StatsRead(k, &s); k++)
+    {
+        u32 len = s.span == STAT_MIN ? 60 : s.span == STAT_HOUR ? 3600 : 86400;
+
+        sum = ss = 0;
+        over = 0;
+        min = max = 0;
+        for (i = j = 0; i < n; i++)
+        {
+            if (when[i] < s.start || when[i] >= s.start + len)
+                continue;
+            if (!j || val[i] < val[min]) min = i;
+            if (!j || val[i] > val[max]) max = i;
+            over += val[i] >= ChanCfg(0)->sp;
+            sum += val[i];
+            j++;
+        }
+        mean = j ? sum / j : 0;
+        for (i = 0; i < n; i++)
+            if (when[i] >= s.start && when[i] < s.start + len)
+                ss += (val[i] - mean) * (val[i] - mean);
+        sd = j > 1 ? sqrt(ss / (j - 1)) : 0;
+        i = s.count != j || fabs(s.mean - mean) > 0.5 || fabs(s.sd - sd) > 1.0 ||
+            s.min != val[min] || s.max != val[max] ||
+            s.minTime != when[min] || s.maxTime != when[max] || s.overS != over / 10;
+        bad += i;
+        printf("%-24s %8s %s n %4u mean %5.1f (%5.1f) sd %.0f (%.2f) min %d max %d over %u s: %s\n",
+               "", "", span[s.span], (unsigned)s.count, s.mean / 10.0, mean / 10.0,
+               (double)s.sd, sd, s.min, s.max, (unsigned)s.overS, i ? "WRONG" : "ok");
+    }
+    printf("%-24s %8s %u summaries from %u samples, %u wrong\n", "", "",
+           (unsigned)(StatsHead() - StatsOldest()), (unsigned)n, (unsigned)bad);
+
+    // A minute of text lines: every sample against statistics only
+    sim_set_temp(0, 30.5);
+    sim_set_noise(0, 0.4);
+    InitUART();
+    for (k = 0; k < 2; k++)
+    {
+        pol.mode = k ? POLICY_NONE : POLICY_ALL;
+        PolicySet(0, &pol);
+        seq = LogHead();
+        j = StatsHead();
+        sim_advance_ns(60 * SIM_NS_PER_S);
+        tx0 = st->uart_tx_bytes;
+        for ( ; LogRead(seq, &r); seq++)
+        {
+            DispUARTRec(&r);
+            UARTTxFlush();
+        }
+        for ( ; StatsRead(j, &s); j++)
+        {
+            DispUARTStat(&s);
+            UARTTxFlush();
+        }
+        tx[k] = st->uart_tx_bytes - tx0;
+    }
+    printf("%-24s %8s UART per minute at 100 ms: %u B raw, %u B statistics only\n", "", "",
+           (unsigned)tx[0], (unsigned)tx[1]);
+    PolicyInit();
+    ADCStopBurst();
+}
+
+/*----------------------------------------------------
+  Logging policy: ten minutes of AIN0 sampled every
+  second, flat at 30.5 C with ADC noise, a 4.8 C/min
+  ramp to 45 C, then flat again; once per policy.
+  Compression is the samples a fixed 1 s rate logs
+  per record logged. The error is the worst distance,
+  checked every second, between the input and the
+  last record logged (sample and hold), so ALL shows
+  what the ADC and filter alone cost. ADAPTIVE only
+  notices the ramp at its next sample, so its error
+  grows with the slowest period.
+----------------------------------------------------*/
+static double policy_trace(u32 s)
+{
+    if (s < 120)
+        return 30.5;
+    if (s < 300)
+        return 30.5 + (45.0 - 30.5) * (s - 120) / 180.0;
+    return 45.0;
+}
+
+static void bench_policy(void)
+{
+    static const struct
+    {
+        const char *name;
+        log_policy_t pol;
+    } mode[] =
+    {
+        { "policy_all",        { POLICY_ALL,      0, 0,    0 } },
+        { "policy_deadband",   { POLICY_DEADBAND, 5, 0,    300000 } },
+        { "policy_adaptive10", { POLICY_ADAPTIVE, 5, 1000, 10000 } },
+        { "policy_adaptive60", { POLICY_ADAPTIVE, 5, 1000, 60000 } },
+    };
+    const policy_cnt_t *c = PolicyCounters(0);
+    const log_rec_t *r;
+    u32 i, s, secs = 600, seq;
+    double held, err;
+
+    sim_set_noise(0, 0.4);
+    ADCStartBurst(ChanMask());
+    sim_advance_ns(100 * SIM_NS_PER_MS);    // fill the filters
+    for (i = 0; i < sizeof mode / sizeof mode[0]; i++)
+    {
+        LogInit();
+        SamplerInit();
+        ChanSetPeriod(0, 1000);
+        PolicySet(0, &mode[i].pol);
+        seq = LogHead();
+        held = -1000;
+        err = 0;
+
+        bench_begin();
+        for (s = 0; s < secs; s++)
+        {
+            sim_set_temp(0, policy_trace(s));
+            sim_advance_ns(SIM_NS_PER_S);
+            for ( ; seq < LogHead(); seq++)
+                if (LOG_TYPE(r = log_at(seq)) == LOG_T_SAMPLE && LOG_CH(r) == 0)
+                    held = r->value / 10.0;
+            if (fabs(held - policy_trace(s)) > err)
+                err = fabs(held - policy_trace(s));
+        }
+        bench_end(mode[i].name, c->taken);
+        printf("%-24s %8s %u taken, %u logged, %.1f:1, max error %.2f C\n", "", "",
+               (unsigned)c->taken, (unsigned)c->logged,
+               c->logged ? (double)c->fullRate / c->logged : 0.0, err);
+    }
+    PolicyInit();
+    ChanSetPeriod(0, 60000);
+    ADCStopBurst();
+}
+
+/*----------------------------------------------------
+  Log block codec: each trace is coded into flash
+  sized blocks, decoded again and compared record by
+  record. Synthetic traces: one LM35 a minute wobbling
+  by an ADC count, the same input filtered so only
+  one sample in ten moves, the flash_fill() sawtooth
+  and four channels a second. Recorded traces: what
+  the sampler logged over ten minutes with ADC noise,
+  one channel and four (with the AIN0 ramp of the
+  policy bench). Retention is how long the log
+  sectors last at the trace's rate, with blocks also
+  closed when the journal fills (FL_JRNL_SLOTS copies
+  FL_STAGE_S apart), against 8 bytes a record.
+----------------------------------------------------*/
+#define CODEC_TRACE_MAX 8192
+
+static log_rec_t codec_trace[CODEC_TRACE_MAX], codec_out[CODEC_TRACE_MAX];
+static u8 codec_blk[CODEC_TRACE_MAX * 12];
+
+static void codec_run(const char *name, u32 n, double secs)
+{
+    char label[32];
+    codec_enc_t e;
+    codec_dec_t d;
+    log_rec_t q;
+    u32 i, blocks = 0, bad = 0, per, stage;
+    u32 size = FL_BLOCK - FL_HDR_SIZE;      // the smaller blocks
+    double perDay = n / (secs / 86400.0), days, raw;
+
+    snprintf(label, sizeof label, "codec_enc_%s", name);
+    bench_begin();
+    memset(codec_blk, 0xFF, sizeof codec_blk);
+    for (i = 0; i < n; i++)
+    {
+        if (!i || !CodecPut(&e, &codec_trace[i]))
+        {
+            if (i)
+                CodecEnd(&e);
+            CodecStart(&e, codec_blk + blocks++ * size, size, i);
+            CodecPut(&e, &codec_trace[i]);
+        }
+    }
+    CodecEnd(&e);
+    bench_end(label, n);
+
+    snprintf(label, sizeof label, "codec_dec_%s", name);
+    bench_begin();
+    for (i = 0, per = 0; per < blocks; per++)
+    {
+        CodecOpen(&d, codec_blk + per * size, size);
+        while (i < n && CodecGet(&d, &codec_out[i]))
+            i++;
+    }
+    bench_end(label, n);
+
+    bad = i != n;
+    for (i = 0; i < n; i++)
+    {
+        q = codec_out[i];
+        bad += q.time != codec_trace[i].time || q.ms != codec_trace[i].ms ||
+               q.value != codec_trace[i].value || q.ch != codec_trace[i].ch ||
+               q.flags != codec_trace[i].flags;
+    }
+
+    per = n / blocks;                       // records per block ...
+    stage = (u32)(perDay * FL_JRNL_SLOTS * FL_STAGE_S / 86400.0);
+    if (stage && stage < per)
+        per = stage;                        // ... unless the journal fills first
+    days = (double)per * FL_BLOCKS * FL_SECTORS / perDay;
+    raw = (double)FL_SECTORS * (FL_SECTOR_SIZE - FL_HDR_SIZE - FL_TRL_SIZE) / LOG_REC_BYTES / perDay;
+    printf("%-24s %8s %u records, %.2f B each, %.1f:1, round trip %s; flash holds ",
+           "", "", (unsigned)n, (double)blocks * size / n,
+           (double)n * LOG_REC_BYTES / (blocks * size), bad ? "WRONG" : "ok");
+    if (days < 2)
+        printf("%.1f h (uncompressed %.1f h)\n", days * 24, raw * 24);
+    else
+        printf("%.0f days (uncompressed %.1f)\n", days, raw);
+}
+
+/* One LM35 reading as the ADC quantises it, in 0.1 C */
+static s16 codec_lm35(double degc)
+{
+    return (s16)((u32)(degc * 10.0 * 1024 / 3300 + 0.5) * 3300 / 1024);
+}
+
+/* Appends the sampler's new records to the trace */
+static u32 codec_drain(u32 *seq, u32 n)
+{
+    for ( ; *seq < LogHead() && n < CODEC_TRACE_MAX; (*seq)++)
+        codec_trace[n++] = *log_at(*seq);
+    return n;
+}
+
+static void bench_codec(void)
+{
+    static const double temp[CHAN_COUNT] = { 30.5, 21.0, 45.2, 8.7 };
+    u32 i, n, s, seq, ch;
+    log_rec_t r = { 0, 0, LOG_T_SAMPLE, 0, 0 };
+
+    srand(1);
+    for (i = 0; i < 4096; i++)
+    {
+        r.time = 800000000 + i * 60;
+        r.value = codec_lm35(25.0 + (rand() % 100) / 100.0 * 0.32 - 0.16);
+        codec_trace[i] = r;
+    }
+    codec_run("lm35_1min", 4096, 4096 * 60.0);
+
+    for (i = 0; i < 4096; i++)
+    {
+        r.time = 800000000 + i * 60;
+        if (rand() % 10 == 0)               // filtered: one change in ten
+            r.value = codec_lm35(25.0 + (rand() % 2 ? 0.16 : -0.16));
+        codec_trace[i] = r;
+    }
+    codec_run("steady_1min", 4096, 4096 * 60.0);
+
+    for (i = 0; i < 4096; i++)
+    {
+        r.time = (i + 1) * 60;
+        r.value = 250 + r.time / 60 % 100;
+        codec_trace[i] = r;
+    }
+    codec_run("sawtooth", 4096, 4096 * 60.0);
+
+    for (i = 0; i < 4096; i++)
+    {
+        r.time = 800000000 + i / CHAN_COUNT;
+        r.ms = 250;
+        r.ch = LOG_T_SAMPLE | (i % CHAN_COUNT);
+        r.value = codec_lm35(temp[i % CHAN_COUNT] + (rand() % 100) / 100.0 * 0.32 - 0.16);
+        codec_trace[i] = r;
+    }
+    codec_run("4ch_1s", 4096, 4096 / CHAN_COUNT);
+
+    // Recorded: what the sampler logs
+    for (ch = 0; ch < 2; ch++)
+    {
+        u32 chans = ch ? CHAN_COUNT : 1;
+
+        for (i = 0; i < CHAN_COUNT; i++)
+        {
+            sim_set_temp(i, temp[i]);
+            sim_set_noise(i, 0.4);
+        }
+        LogInit();
+        ADCStartBurst(ChanMask());
+        sim_advance_ns(100 * SIM_NS_PER_MS);
+        SamplerInit();
+        for (i = 0; i < CHAN_COUNT; i++)
+            ChanSetPeriod(i, i < chans ? 1000 : 0);
+        seq = LogHead();
+        for (s = n = 0; s < 600; s++)
+        {
+            if (ch)
+                sim_set_temp(0, policy_trace(s));
+            sim_advance_ns(SIM_NS_PER_S);
+            n = codec_drain(&seq, n);
+        }
+        codec_run(ch ? "rec_4ch_1s" : "rec_1ch_1s", n, 600);
+    }
+    for (i = 0; i < CHAN_COUNT; i++)
+        ChanSetPeriod(i, i ? 0 : 60000);
+    ADCStopBurst();
+}
+
+/*----------------------------------------------------
+  Text formatting: a DispUARTRec() line against the
+  per-character path it replaced (a / and % by 10
+  per digit, one UARTTxChar() and TX lock per byte),
+  alternating a sample and an alarm record; the line
+  drains untimed. cyc/line is the caller's host TSC
+  count (x86 only), reg/line its peripheral accesses
+  (VIC lock/unlock, THR), which carry over to the
+  ARM7 as they are. Both paths must send the same
+  bytes.
+
+  Then the digits alone, into a buffer: the divide
+  loop against FmtU32().
+----------------------------------------------------*/
+static void fmt_old_u32(u32 num)
+{
+    u8 a[10];
+    s8 i = 0;
+
+    if (num == 0)
+        UARTTxChar('0');
+    else
+    {
+        while (num > 0)
+        {
+            a[i++] = (num % 10) + 48;
+            num = num / 10;
+        }
+        for (--i; i >= 0; i--)
+            UARTTxChar(a[i]);
+    }
+}
+
+static void fmt_old_rec(const log_rec_t *r)
+{
+    rtc_time_t c;
+    u8 ch = LOG_CH(r);
+    s32 v = r->value;
+
+    if (LOG_TYPE(r) == LOG_T_ALARM)
+        UARTTxStr((s8 *)(r->flags ? " [ALERT]" : " [CLEAR]"));
+    UARTTxChar(' ');
+    UARTTxStr((s8 *)ChanCfg(ch)->name);
+    UARTTxStr((s8 *)": ");
+    if (v < 0)
+    {
+        UARTTxChar('-');
+        v = -v;
+    }
+    fmt_old_u32(v / 10);
+    UARTTxChar('.');
+    UARTTxChar((v % 10) + 48);
+    UARTTxChar(0xB0);
+    UARTTxChar('C');
+    UARTTxStr((s8 *)" @ ");
+
+    SecondsToRTC(r->time, &c);
+    UARTTxChar((c.hour / 10) + 48);
+    UARTTxChar((c.hour % 10) + 48);
+    UARTTxChar(':');
+    UARTTxChar((c.min / 10) + 48);
+    UARTTxChar((c.min % 10) + 48);
+    UARTTxChar(':');
+    UARTTxChar((c.sec / 10) + 48);
+    UARTTxChar((c.sec % 10) + 48);
+    UARTTxChar('.');
+    UARTTxChar((r->ms / 100) + 48);
+    UARTTxChar((r->ms / 10 % 10) + 48);
+    UARTTxChar((r->ms % 10) + 48);
+    UARTTxChar(' ');
+    UARTTxChar((c.dom / 10) + 48);
+    UARTTxChar((c.dom % 10) + 48);
+    UARTTxChar('/');
+    UARTTxChar((c.month / 10) + 48);
+    UARTTxChar((c.month % 10) + 48);
+    UARTTxChar('/');
+    fmt_old_u32(c.year);
+
+    if (LOG_TYPE(r) == LOG_T_ALARM)
+    {
+        if (r->flags & ALM_HIGH)
+            UARTTxStr((s8 *)" HIGH");
+        if (r->flags & ALM_LOW)
+            UARTTxStr((s8 *)" LOW");
+        if (r->flags & ALM_RATE)
+            UARTTxStr((s8 *)" RATE");
+        UARTTxStr((s8 *)"\n\r");
+    }
+    else if (r->flags & LOG_F_OVER_SP)
+        UARTTxStr((s8 *)" - OVER TEMP!\n\r");
+    else
+        UARTTxStr((s8 *)"\n\r");
+}
+
+static void fmt_old_digits(u8 *p, u32 num)
+{
+    u8 a[10];
+    s8 i = 0;
+
+    do
+    {
+        a[i++] = (num % 10) + 48;
+        num = num / 10;
+    }
+    while (num > 0);
+    for (--i; i >= 0; i--)
+        *p++ = a[i];
+}
+
+#define FMT_LINES   400
+#define FMT_VALUES  4096
+
+static FILE *fmt_lines(const char *name, void (*line)(const log_rec_t *),
+                       const log_rec_t *rec)
+{
+    const sim_stats_t *s = sim_stats();
+    FILE *cap = tmpfile();
+    uint64_t cyc = 0, c0, reg = 0, r0, tx0 = s->uart_tx_bytes;
+    int i;
+
+    sim_set_uart_file(cap);
+    bench_begin();
+    for (i = 0; i < FMT_LINES; i++)
+    {
+        r0 = s->reg_accesses;
+        c0 = bench_cycles();
+        line(&rec[i & 1]);
+        cyc += bench_cycles() - c0;
+        reg += s->reg_accesses - r0;
+        bench_pause();
+        UARTTxFlush();
+        bench_resume();
+    }
+    bench_end(name, FMT_LINES);
+    sim_set_uart_file(NULL);
+    printf("%-24s %8s %.0f cyc/line  %.1f reg/line  %.1f B/line\n", "", "",
+           (double)cyc / FMT_LINES, (double)reg / FMT_LINES,
+           (double)(s->uart_tx_bytes - tx0) / FMT_LINES);
+    return cap;
+}
+
+static void bench_fmt(void)
+{
+    static u32 val[FMT_VALUES];
+    static char a[8192], b[8192];
+    volatile char sink;
+    log_rec_t rec[2] =
+    {
+        { 0, 305, LOG_T_SAMPLE | CH0, 0, 7 },
+        { 0, 512, LOG_T_ALARM | CH0, ALM_HIGH | ALM_RATE, 993 },
+    };
+    FILE *old, *cur;
+    size_t na, nb;
+    u8 buf[12], *e;
+    uint64_t cyc, c0;
+    int i, r, bad = 0, runs = 100;
+
+    rec[0].time = rec[1].time = RTCToSeconds(2026, 12, 31, 23, 59, 58);
+    InitUART();
+    old = fmt_lines("fmt_line_perchar", fmt_old_rec, rec);
+    cur = fmt_lines("fmt_line_buffer", DispUARTRec, rec);
+
+    rewind(old);
+    rewind(cur);
+    na = fread(a, 1, sizeof a, old);
+    nb = fread(b, 1, sizeof b, cur);
+    fclose(old);
+    fclose(cur);
+    printf("%-24s %8s %s\n", "", "",
+           na == nb && !memcmp(a, b, na) ? "same text as the per-character path" :
+           "MISMATCH against the per-character path");
+
+    srand(1);
+    for (i = 0; i < FMT_VALUES; i++)
+        val[i] = (u32)rand() >> (rand() % 31);      // 1 to 10 digits
+    for (i = 0; i < FMT_VALUES; i++)
+    {
+        e = FmtU32(buf, val[i]);
+        sprintf(b, "%lu", (unsigned long)val[i]);
+        if ((size_t)(e - buf) != strlen(b) || memcmp(buf, b, e - buf))
+            bad++;
+    }
+
+    bench_begin();
+    c0 = bench_cycles();
+    for (r = 0; r < runs; r++)
+        for (i = 0; i < FMT_VALUES; i++)
+            fmt_old_digits((u8 *)a + (i & 63), val[i]);
+    cyc = bench_cycles() - c0;
+    bench_end("fmt_u32_divide", (unsigned long)runs * FMT_VALUES);
+    printf("%-24s %8s %.1f cyc/value\n", "", "", (double)cyc / runs / FMT_VALUES);
+
+    bench_begin();
+    c0 = bench_cycles();
+    for (r = 0; r < runs; r++)
+        for (i = 0; i < FMT_VALUES; i++)
+            FmtU32((u8 *)a + (i & 63), val[i]);
+    cyc = bench_cycles() - c0;
+    bench_end("fmt_u32_pairs", (unsigned long)runs * FMT_VALUES);
+    printf("%-24s %8s %.1f cyc/value, %s\n", "", "", (double)cyc / runs / FMT_VALUES,
+           bad ? "WRONG digits" : "digits match printf");
+    sink = a[0];
+    (void)sink;
+}
+
+/*----------------------------------------------------
+  RTC reads across midnight on New Year's Eve: the
+  old six register reads (HOUR, MIN, SEC, then DOM,
+  MONTH, YEAR) against RTCSnapshot(). Each trial
+  brackets a six-register read between two snapshots
+  and counts it torn when it falls outside them; the
+  trials are stepped 37 ns apart so the rollover
+  lands between every pair of register reads.
+
+  Then the calendar conversion: SecondsToRTC() over
+  2000..2099 against RTCToSeconds() and a day-by-day
+  reference, and its host cost against a year/month
+  search loop like the one it replaced.
+----------------------------------------------------*/
+static u32 rtc_six_reads(void)
+{
+    u32 h = HOUR, mi = MIN, s = SEC;
+    u32 d = DOM, mo = MONTH, y = YEAR;
+
+    return RTCToSeconds(y, mo, d, h, mi, s);
+}
+
+/* t in seconds since 2000 */
+static u32 rtc_loop_to_year(u32 t, u32 *month)
+{
+    static const u16 before[12] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+    u32 days = t / 86400, y = 2000, len, m;
+
+    while (days >= (len = (y & 3) ? 365 : 366))
+    {
+        days -= len;
+        y++;
+    }
+    for (m = 11; m > 0; m--)
+        if (before[m] + (m >= 2 && !(y & 3)) <= days)
+            break;
+    *month = m + 1;
+    return y;
+}
+
+static void bench_rtc(void)
+{
+    u32 i, j, n = 200, torn = 0, snapBad = 0, before, after, six, prev = 0;
+    u32 t, start, end, mon, sum = 0, bad = 0;
+    uint64_t a0;
+    rtc_time_t c, r = { 0, 0, 0, 6, 1, 1, 2000, 0 };   // Saturday 01/01/2000
+    static const u8 mdays[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+    for (i = 0; i < n; i++)
+    {
+        SetRTCTimeInfo(23, 59, 59);
+        SetRTCDateInfo(31, 12, 2025);
+        while (RTCNow(&c.sub) && c.sub < RTC_SUB_HZ - 64)   // last 2 ms of the second
+            sim_advance_ns(SIM_NS_PER_MS / 2);
+        sim_advance_ns(i * 37);
+        for (j = 0; j < 3000; j++)
+        {
+            before = RTCNow(0);
+            six = rtc_six_reads();
+            after = RTCNow(0);
+            if (six < before || six > after)
+                torn++;
+            if (j && (before < prev || before > prev + 1))
+                snapBad++;
+            prev = after;
+            if (before != after)
+                break;
+        }
+    }
+    a0 = sim_stats()->reg_accesses;
+    RTCSnapshot(&c);
+    printf("%-24s %8u rollovers: six-register read torn %u times, snapshot %u; %u vs %u register reads\n",
+           "rtc_rollover", (unsigned)n, (unsigned)torn, (unsigned)snapBad, 6u,
+           (unsigned)(sim_stats()->reg_accesses - a0));
+
+    // Every day of the century, first and last second
+    start = RTCToSeconds(2000, 1, 1, 0, 0, 0);
+    end = RTCToSeconds(2099, 12, 31, 23, 59, 59);
+    for (t = start; t < end; t += 86400)
+    {
+        for (j = 0; j < 86400; j += 86399)
+        {
+            SecondsToRTC(t + j, &c);
+            if (c.year != r.year || c.month != r.month || c.dom != r.dom ||
+                c.dow != r.dow || c.hour != j / 3600 || c.sec != j % 60 ||
+                RTCToSeconds(c.year, c.month, c.dom, c.hour, c.min, c.sec) != t + j)
+                bad++;
+        }
+        r.dow = (r.dow + 1) % 7;
+        if (++r.dom > mdays[r.month - 1] + (r.month == 2 && !(r.year & 3)))
+        {
+            r.dom = 1;
+            if (++r.month > 12)
+            {
+                r.month = 1;
+                r.year++;
+            }
+        }
+    }
+    printf("%-24s %8u days checked, %u wrong\n", "rtc_calendar", (unsigned)((end - start) / 86400 + 1),
+           (unsigned)bad);
+
+    bench_begin();
+    for (t = start; t < end; t += 86400 * 7 + 3599)
+    {
+        SecondsToRTC(t, &c);
+        sum += c.year;
+    }
+    bench_end("rtc_seconds_to_cal", (end - start) / (86400 * 7 + 3599) + 1);
+    bench_begin();
+    for (t = start; t < end; t += 86400 * 7 + 3599)
+        sum += rtc_loop_to_year(t - start, &mon) + mon;
+    bench_end("rtc_year_loop_ref", (end - start) / (86400 * 7 + 3599) + 1);
+    if (!sum)
+        printf("\n");
+}
+
+/*----------------------------------------------------
+  Sub-second timestamps: two minutes of sampling with
+  CH0 every 10 ms while the RTC crystal is off PCLK by
+  a set error. Every record must be later than the
+  one before and 10 ms after it (+-1 ms rounding);
+  stamps taken at random points are compared with the
+  RTC itself (snapshot + CTC, 30 us resolution), and
+  the lock's own estimate of the crystal error is
+  shown against the simulated one.
+----------------------------------------------------*/
+static void bench_timestamp(void)
+{
+    static const double ppm[] = { 0, 100, -100, -800 };
+    unsigned k, i;
+    u32 seq, sec, ref, back, jitter, recs;
+    s32 err, maxErr, d;
+    u16 ms, sub;
+    log_rec_t r, prev;
+    char name[32];
+
+    for (k = 0; k < sizeof ppm / sizeof ppm[0]; k++)
+    {
+        sim_reset();
+        sim_set_rtc_ppm(ppm[k]);
+        InitTimebase();
+        RTC_Init();
+        SetRTCTimeInfo(23, 59, 0);
+        SetRTCDateInfo(31, 12, 2025);
+        LogInit();
+        ADCStartBurst(ADC_BURST_CHANNELS);
+        SamplerInit();
+        SamplerSetPeriod(0, 10);
+        sim_advance_ns(10 * SIM_NS_PER_S);          // settle the calibration
+
+        seq = LogHead();
+        back = jitter = recs = 0;
+        maxErr = 0;
+        prev.time = 0;
+        bench_begin();
+        for (i = 0; i < 120 * 20; i++)
+        {
+            bench_pause();
+            sim_advance_ns(50 * SIM_NS_PER_MS - 3 * SIM_NS_PER_US * (i % 7));
+            bench_resume();
+
+            sec = RTCStampMs(&ms);
+            ref = RTCNow(&sub);
+            d = (s32)(sec - ref) * 1000 + ms - (s32)(((u32)sub * 1000) >> 15);
+            err = d < 0 ? -d : d;
+            if (err > maxErr)
+                maxErr = err;
+
+            bench_pause();
+            for ( ; LogRead(seq, &r); seq++)
+            {
+                if (LOG_CH(&r) != 0)
+                    continue;
+                if (prev.time)
+                {
+                    d = (s32)(r.time - prev.time) * 1000 + r.ms - prev.ms;
+                    if (d <= 0)
+                        back++;
+                    else if (d < 9 || d > 11)
+                        jitter++;
+                }
+                prev = r;
+                recs++;
+            }
+            bench_resume();
+        }
+        sprintf(name, "timestamp_%+.0fppm", ppm[k]);
+        bench_end(name, i);
+        printf("%-24s %8s %u records: %u out of order, %u not 10+-1 ms apart; "
+               "max error against RTC %d ms, lock estimate %+d ppm\n", "", "",
+               (unsigned)recs, (unsigned)back, (unsigned)jitter, (int)maxErr,
+               (int)-RTCLockPpm());
+    }
+}
+
+static void bench_delay_ms(void)
+{
+    int i, n = 100;
+
+    bench_begin();
+    for (i = 0; i < n; i++)
+        delay_ms(5);
+    bench_end("delay_ms(5)", n);
+}
+
+/*----------------------------------------------------
+  Keypad: one 5 ms Timer1 scan (idle and with a key
+  held) against the old blocking read of a 100 ms
+  press (wait press, 10 ms debounce, wait release)
+----------------------------------------------------*/
+static void bench_key_scan(void)
+{
+    int i, n = 1000;
+    u8 ev;
+
+    KeyPdInit();
+    bench_begin();
+    for (i = 0; i < n; i++)
+        Timer1_ISR();
+    bench_end("key_scan_idle", n);
+
+    sim_press_key(5, 60000);
+    bench_begin();
+    for (i = 0; i < n; i++)
+        Timer1_ISR();
+    bench_end("key_scan_held", n);
+    while (KeyGetEvent(&ev))
+        ;
+}
+
+static void bench_key_blocking(void)
+{
+    volatile u8 key;
+    int i, n = 5;
+
+    KeyPdInit();
+    bench_begin();
+    for (i = 0; i < n; i++)
+    {
+        sim_press_key(i, 100);
+        while (ColStat());
+        delay_ms(10);
+        key = KeyVal();
+        while (!ColStat());
+    }
+    bench_end("key_read_blocking", n);
+    (void)key;
+}
+
+static const struct
+{
+    const char *name;
+    void (*fn)(void);
+} cases[] =
+{
+    { "lcd_refresh",   bench_lcd_refresh },
+    { "lcd_chars",     bench_lcd_chars },
+    { "uart_log_line", bench_uart_line },
+    { "lm35_read",     bench_lm35_read },
+    { "adc_burst",     bench_adc_burst },
+    { "lm35_convert",  bench_lm35_convert },
+    { "filters",       bench_filters },
+    { "log_append",    bench_log_append },
+    { "flash_wear",    bench_flash_wear },
+    { "flash_boot",    bench_flash_boot },
+    { "cmd",           bench_cmd },
+    { "dump",          bench_dump },
+    { "sampler",       bench_sampler },
+    { "chan",          bench_chan },
+    { "alarm",         bench_alarm },
+    { "stats",         bench_stats },
+    { "policy",        bench_policy },
+    { "codec",         bench_codec },
+    { "fmt",           bench_fmt },
+    { "rtc",           bench_rtc },
+    { "timestamp",     bench_timestamp },
+    { "delay_ms",      bench_delay_ms },
+    { "key_scan",      bench_key_scan },
+    { "key_blocking",  bench_key_blocking },
+};
+
+int main(int argc, char **argv)
+{
+    unsigned i;
+    int a, ran = 0;
+
+    for (i = 0; i < sizeof cases / sizeof cases[0]; i++)
+    {
+        int want = (argc == 1);
+
+        for (a = 1; a < argc; a++)
+            if (!strcmp(argv[a], cases[i].name))
+                want = 1;
+        if (!want)
+            continue;
+        sim_reset();
+        sim_set_temp(0, 30.5);
+        InitTimebase();
+        RTC_Init();
+        Init_ADC(CH0);
+        ChanInit();
+        AlarmInit();
+        StatsInit();
+        PolicyInit();
+        cases[i].fn();
+        ran++;
+    }
+    if (!ran)
+    {
+        fprintf(stderr, "no such case\n");
+        return 2;
+    }
+    return 0;
+}
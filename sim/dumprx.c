@@ -0,0 +1,242 @@
+/*----------------------------------------------------
+  dumprx.c
+
+  Linux receiver for the logger's binary dump
+  ("DUMP BIN", see dump.h). Decodes the SLIP frames,
+  checks their CRC16 and record numbering, optionally
+  writes the records as CSV and reports the transfer
+  rate.
+
+  Usage: dumprx [-b baud] [-r rec] [-c] [-o out.csv]
+                [-t seconds] <tty | capture file | ->
+
+    -b  baud rate when the input is a serial port
+    -c  send "DUMP BIN <rec>" on the serial port first
+    -r  record to start from (with -c; default 0)
+    -o  CSV output: rec,time (s.ms),value,ch,flags
+    -t  elapsed time to use for the rates of a captured
+        file (logger_sim -u); a serial port is timed
+        by the wall clock
+
+  On a gap or bad frame the report says where to
+  resume ("dumprx -c -r <rec>").
+----------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+
+#include "../dump.h"
+
+#define REC_BYTES   8       // LOG_REC_BYTES
+#define MAX_FRAME   (DUMP_HDR_BYTES + 255 * REC_BYTES + 2)
+
+static unsigned char frame[MAX_FRAME];
+static size_t flen;
+static int esc, overflow;
+
+static unsigned long bytes, frames, records, bad, junk, gaps;
+static uint32_t expect, resume;
+static int have_expect, done;
+static double t_first = -1, t_last;
+static FILE *csv;
+
+static double now_s(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static uint16_t crc16(const unsigned char *p, size_t n)
+{
+    uint16_t crc = 0xFFFF;
+    int i;
+
+    while (n--)
+    {
+        crc ^= (uint16_t)*p++ << 8;
+        for (i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+static uint32_t rd32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void end_frame(void)
+{
+    uint32_t rec;
+    unsigned n, i;
+    const unsigned char *r;
+
+    if (flen == 0 && !overflow)
+        return;                         // empty: back-to-back END bytes
+    if (overflow || flen < DUMP_HDR_BYTES + 2 ||
+        (frame[0] != DUMP_F_RECS && frame[0] != DUMP_F_END))
+    {
+        junk += flen;                   // text lines between frames
+        goto out;
+    }
+    n = frame[5];
+    if (flen != DUMP_HDR_BYTES + n * REC_BYTES + 2 ||
+        crc16(frame, flen - 2) != (frame[flen - 2] | (frame[flen - 1] << 8)))
+    {
+        bad++;
+        goto out;
+    }
+
+    frames++;
+    rec = rd32(frame + 1);
+    if (have_expect && rec != expect)
+    {
+        if (!gaps++)
+            resume = expect;            // first record missing
+        fprintf(stderr, "gap: expected record %u, got %u\n",
+                (unsigned)expect, (unsigned)rec);
+    }
+    if (frame[0] == DUMP_F_END)
+        done = 1;
+    for (i = 0, r = frame + DUMP_HDR_BYTES; i < n; i++, r += REC_BYTES)
+        if (csv)
+        {
+            uint32_t w = rd32(r + 4);   // value:13 ms:10 ch:3 type:3 flags:3
+            int v = (int)(w & 0x1FFF) - ((w & 0x1000) ? 0x2000 : 0);
+
+            fprintf(csv, "%u,%u.%03u,%.1f,%u,%u\n", (unsigned)(rec + i), (unsigned)rd32(r),
+                    (unsigned)((w >> 13) & 0x3FF), v / 10.0,
+                    (unsigned)(((w >> 23) & 7) | (((w >> 26) & 7) << 4)), (unsigned)(w >> 29));
+        }
+    records += n;
+    expect = rec + n;
+    have_expect = 1;
+out:
+    flen = 0;
+    overflow = 0;
+}
+
+static void rx_byte(unsigned char b)
+{
+    if (b == SLIP_END)
+    {
+        end_frame();
+        esc = 0;
+        return;
+    }
+    if (esc)
+    {
+        b = (b == SLIP_ESC_END) ? SLIP_END : (b == SLIP_ESC_ESC) ? SLIP_ESC : b;
+        esc = 0;
+    }
+    else if (b == SLIP_ESC)
+    {
+        esc = 1;
+        return;
+    }
+    if (flen < sizeof frame)
+        frame[flen++] = b;
+    else
+        overflow = 1;
+}
+
+static speed_t baud_const(long b)
+{
+    switch (b)
+    {
+    case 9600:   return B9600;
+    case 19200:  return B19200;
+    case 38400:  return B38400;
+    case 57600:  return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    }
+    fprintf(stderr, "unsupported baud rate %ld\n", b);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    long baud = 9600;
+    unsigned long from = 0;
+    double elapsed = 0;
+    int opt, fd, send = 0, tty;
+    unsigned char buf[4096];
+    ssize_t n, i;
+
+    while ((opt = getopt(argc, argv, "b:r:co:t:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b': baud = atol(optarg); break;
+        case 'r': from = strtoul(optarg, NULL, 0); break;
+        case 'c': send = 1; break;
+        case 'o': if (!(csv = fopen(optarg, "w"))) { perror(optarg); return 2; } break;
+        case 't': elapsed = atof(optarg); break;
+        default:
+            fprintf(stderr, "usage: dumprx [-b baud] [-r rec] [-c] [-o out.csv] "
+                            "[-t seconds] <tty | file | ->\n");
+            return 2;
+        }
+    }
+    if (optind != argc - 1)
+        return 2;
+
+    fd = strcmp(argv[optind], "-") ? open(argv[optind], O_RDWR | O_NOCTTY) : 0;
+    if (fd < 0 && (fd = open(argv[optind], O_RDONLY)) < 0)
+    {
+        perror(argv[optind]);
+        return 2;
+    }
+    tty = isatty(fd);
+    if (tty)
+    {
+        struct termios t;
+
+        tcgetattr(fd, &t);
+        cfmakeraw(&t);
+        cfsetspeed(&t, baud_const(baud));
+        t.c_cc[VMIN] = 1;
+        t.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &t);
+        tcflush(fd, TCIFLUSH);
+        if (send)
+        {
+            char cmd[32];
+            int len = snprintf(cmd, sizeof cmd, "DUMP BIN %lu\r\n", from);
+
+            if (write(fd, cmd, len) != len)
+                perror("write");
+        }
+    }
+
+    while (!done && (n = read(fd, buf, sizeof buf)) > 0)
+    {
+        if (t_first < 0)
+            t_first = now_s();
+        for (i = 0; i < n && !done; i++)
+            rx_byte(buf[i]);
+        bytes += i;
+        t_last = now_s();
+    }
+    if (csv)
+        fclose(csv);
+
+    if (elapsed <= 0 && tty && t_first >= 0)
+        elapsed = t_last - t_first;
+    printf("bytes %lu  frames %lu  records %lu  bad %lu  gaps %lu  other %lu bytes\n",
+           bytes, frames, records, bad, gaps, junk);
+    if (elapsed > 0)
+        printf("%.2f s  %.0f bytes/s  %.0f records/s\n",
+               elapsed, bytes / elapsed, records / elapsed);
+    if (!done || bad || gaps)
+        printf("incomplete: resume with -c -r %u\n", (unsigned)(gaps ? resume : expect));
+    return (done && !bad && !gaps) ? 0 : 1;
+}
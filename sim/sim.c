@@ -0,0 +1,1600 @@
+/*----------------------------------------------------
+  sim.c
+
+  LPC21xx register file and peripheral models used by
+  the host build of the firmware.
+
+  How it works:
+    - Every register access from the firmware goes
+      through sim_reg(), which returns a pointer into
+      regs[]. The firmware reads or writes it directly.
+    - Writes are noticed on the NEXT access (or when
+      simulated time is advanced): the two most recently
+      accessed registers are compared against the value
+      that was presented to the firmware and the model
+      side effect is applied (commit).
+    - Each access costs SIM_ACCESS_NS of simulated time.
+      Firmware delays spin on Timer0, so time advances
+      through those reads; harnesses can also call
+      sim_advance_ns(). A loop that polls only RAM never
+      advances time - it must touch a register.
+    - Pending, enabled interrupts are dispatched through
+      the VIC vector slots between register accesses.
+
+  Models: GPIO (switch, 4x4 keypad, HD44780 LCD and
+  buzzer on P0),
+  UART0 (16 byte FIFOs, baud-rate timing, capture file),
+  ADC (LM35 voltages from a script, single/burst mode),
+  RTC (1 Hz counters, CTC, CIIR interrupts) and
+  Timer0/Timer1 (prescaler, match interrupt/reset/stop).
+  Writing PCON.IDL skips time forward to the next
+  enabled interrupt, as the idle mode does on the chip.
+  Flash (LPC2148 sector map) is programmed through
+  sim_iap(), optionally backed by an image file.
+----------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "LPC21xx.h"
+#include "sim.h"
+
+#define SIM_ACCESS_NS     100      // one peripheral access on the VPB
+#define SIM_IRQ_ENTRY_NS  500      // IRQ entry + exit overhead
+#define SIM_SLICE_NS      10000    // max step while advancing time
+
+#define THR_EMPTY   0x100000000UL  // THR sentinel: no pending write
+
+/* VIC channel numbers */
+#define VIC_TIMER0  4
+#define VIC_TIMER1  5
+#define VIC_UART0   6
+#define VIC_RTC     13
+#define VIC_AD0     18
+
+/* LCD wiring (see lcd.c) */
+#define LCD_RS  12
+#define LCD_RW  13
+#define LCD_EN  14
+#define SW_PIN  4
+#define BUZ_PIN 25   // buzzer (data_logger.h BUZ)
+
+/*---------------- register file ------------------*/
+static unsigned long regs[SIM_NREGS];   // what the firmware sees
+static unsigned long shown[SIM_NREGS];  // value last presented/committed
+
+typedef struct
+{
+    int id;        // register id, -1 = empty
+    int fresh;     // accessed in the previous call, access side effect pending
+} win_t;
+
+static win_t win[2];                     // win[0] newest, win[1] older
+
+static uint64_t now_ns;
+static uint64_t limit_ns;
+static int      in_isr;
+static sim_stats_t st;
+
+/*---------------- GPIO ----------------------------*/
+static unsigned long latch[2];           // output latches of P0, P1
+
+static int      sw_down;
+static uint64_t sw_release_ns;
+static int      key_down = -1;
+static uint64_t key_release_ns;
+
+/*---------------- LCD -----------------------------*/
+typedef struct
+{
+    unsigned char ddram[128];
+    unsigned char cgram[64];
+    unsigned char ac;        // address counter
+    int  cg_mode;            // AC points into CGRAM
+    int  inc;                // entry mode I/D
+    int  en;                 // last sampled EN level
+    int  driving;            // controller drives D0..D7 (read cycle)
+    unsigned char rd;        // byte driven during a read
+    uint64_t busy_until;
+} lcd_t;
+
+static lcd_t lcd;
+static FILE *lcd_file;
+static char  lcd_logged[2][17];
+static uint64_t lcd_next_log_ns;
+
+/*---------------- UART0 ---------------------------*/
+typedef struct
+{
+    unsigned char tx[16];
+    int  tx_head, tx_count;
+    unsigned char shift;     // byte in the transmit shift register
+    int  shifting;
+    uint64_t shift_done;
+    int  thre_irq;           // THRE interrupt pending
+    int  iir_thre;           // last IIR read reported THRE
+
+    unsigned char rx[16];
+    int  rx_head, rx_count;
+
+    char    *rx_queue;       // scripted bytes still "on the wire"
+    uint32_t rx_qlen, rx_qpos;
+    uint64_t rx_next;
+} uart_t;
+
+static uart_t uart;
+static FILE  *uart_file;
+
+/*---------------- ADC -----------------------------*/
+typedef struct
+{
+    double temp[8];          // degC on each AIN
+    double from[8], to[8];   // ramp
+    uint64_t t0[8], t1[8];
+    double sigma[8];         // noise in counts
+    int    busy;
+    int    ch;
+    uint64_t done_at;
+    unsigned long dr;        // global data register
+} adc_t;
+
+static adc_t adc;
+static unsigned long long rng = 0x9E3779B97F4A7C15ULL;
+
+/*---------------- Flash / IAP ---------------------*/
+#define FLASH_SECTORS     27                // LPC2148, 0x7D000+ is the boot block
+#define FLASH_ERASE_NS    (400 * SIM_NS_PER_MS)
+#define FLASH_PROG_NS     (1 * SIM_NS_PER_MS)  // per 256 bytes
+
+unsigned char sim_flash[SIM_FLASH_SIZE];
+static int    flash_prepared[FLASH_SECTORS];
+static FILE  *flash_file;
+static int    flash_ready;                  // sim_flash holds a valid image
+
+/*---------------- RTC -----------------------------*/
+typedef struct
+{
+    unsigned long sec, min, hour, dom, dow, doy, month, year;
+    unsigned long ilr;
+    uint64_t phase;          // ns into the current second
+    uint64_t last;
+    int64_t  ppm_frac;       // crystal error carried between steps (ns * 1e6)
+    double   ppm;            // RTC crystal error against PCLK
+} rtc_t;
+
+static rtc_t rtc;
+
+/*---------------- Timers --------------------------*/
+typedef struct
+{
+    int base;                // SIM_T0IR or SIM_T1IR
+    int vic;
+    unsigned long ir, tc, pc;
+    uint64_t last_pclk;
+} tmr_t;
+
+static tmr_t tmr[2];
+
+/*---------------- alarm latency watch -------------*/
+typedef struct
+{
+    int      armed, ch, dir;
+    double   level;          // degC
+    int      buz;            // buzzer output as last seen
+    int      alert_match;    // chars of "[ALERT]" matched on TXD0
+} watch_t;
+
+static watch_t watch;
+static const char alert_tag[] = "[ALERT]";
+
+/*---------------- VIC -----------------------------*/
+static unsigned long vic_enabled;
+static unsigned long vic_current;
+
+/*---------------- script --------------------------*/
+enum { EV_TEMP, EV_RAMP, EV_NOISE, EV_KEY, EV_SW, EV_RX, EV_WATCH };
+
+typedef struct
+{
+    uint64_t t;
+    int kind, a;
+    double v, w;
+    char *text;
+    uint32_t len;
+} event_t;
+
+static event_t *events;
+static int nevents, next_event;
+
+static void sim_step(void);
+static void sim_stall(uint64_t ns);
+static void sim_irq(void);
+static void sim_idle(void);
+static void commit_window(void);
+
+/*==================================================
+  Helpers
+==================================================*/
+static uint64_t pclk_cycles(uint64_t ns)
+{
+    return ns * (SIM_PCLK_HZ / 1000000ULL) / 1000ULL;
+}
+
+static double gauss(void)
+{
+    double u, v;
+
+    rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+    u = ((rng >> 11) + 1.0) / 9007199254740993.0;
+    rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+    v = (rng >> 11) / 9007199254740992.0;
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+static int days_in_month(unsigned long m, unsigned long y)
+{
+    static const int d[] = {31,28,31,30,31,30,31,31,30,31,30,31};
+
+    if (m < 1 || m > 12)
+        return 31;
+    if (m == 2 && (y % 4) == 0)
+        return 29;
+    return d[m - 1];
+}
+
+/*==================================================
+  LCD (HD44780, 8-bit bus on P0.16..P0.23)
+==================================================*/
+static void lcd_advance(void)
+{
+    if (lcd.cg_mode)
+    {
+        lcd.ac = (lcd.ac + (lcd.inc ? 1 : -1)) & 0x3F;
+        return;
+    }
+    if (lcd.inc)
+        lcd.ac = (lcd.ac == 0x27) ? 0x40 : (lcd.ac == 0x67) ? 0x00 : lcd.ac + 1;
+    else
+        lcd.ac = (lcd.ac == 0x40) ? 0x27 : (lcd.ac == 0x00) ? 0x67 : lcd.ac - 1;
+}
+
+static void lcd_write(int rs, unsigned char d)
+{
+    uint64_t exec = 37 * SIM_NS_PER_US;
+
+    if (now_ns < lcd.busy_until)
+        st.lcd_busy_violations++;
+
+    if (rs)
+    {
+        st.lcd_data++;
+        if (lcd.cg_mode)
+            lcd.cgram[lcd.ac & 0x3F] = d;
+        else
+            lcd.ddram[lcd.ac & 0x7F] = d;
+        lcd_advance();
+        exec += 4 * SIM_NS_PER_US;
+    }
+    else
+    {
+        st.lcd_cmds++;
+        if (d & 0x80)
+        {
+            lcd.ac = d & 0x7F;
+            lcd.cg_mode = 0;
+        }
+        else if (d & 0x40)
+        {
+            lcd.ac = d & 0x3F;
+            lcd.cg_mode = 1;
+        }
+        else if (d & 0x20)
+        {
+            // function set: 8-bit, 2 lines assumed
+        }
+        else if (d & 0x10)
+        {
+            if (!(d & 0x08))   // cursor shift
+            {
+                int inc = lcd.inc;
+                lcd.inc = (d & 0x04) != 0;
+                lcd_advance();
+                lcd.inc = inc;
+            }
+        }
+        else if (d & 0x08)
+        {
+            // display on/off control
+        }
+        else if (d & 0x04)
+        {
+            lcd.inc = (d & 0x02) != 0;
+        }
+        else if (d & 0x02)
+        {
+            lcd.ac = 0;
+            lcd.cg_mode = 0;
+            exec = 1520 * SIM_NS_PER_US;
+        }
+        else if (d & 0x01)
+        {
+            memset(lcd.ddram, ' ', sizeof lcd.ddram);
+            lcd.ac = 0;
+            lcd.cg_mode = 0;
+            lcd.inc = 1;
+            exec = 1520 * SIM_NS_PER_US;
+        }
+    }
+    lcd.busy_until = now_ns + exec;
+}
+
+/* Called whenever P0 outputs change: sample RS/RW/EN/D0..D7 */
+static void lcd_bus(void)
+{
+    unsigned long out = latch[0] & shown[SIM_IODIR0];
+    int en = (out >> LCD_EN) & 1;
+    int rs = (out >> LCD_RS) & 1;
+    int rw = (out >> LCD_RW) & 1;
+
+    if (en && !lcd.en && rw)
+    {
+        lcd.driving = 1;
+        st.lcd_reads++;
+        if (rs)
+            lcd.rd = lcd.cg_mode ? lcd.cgram[lcd.ac & 0x3F] : lcd.ddram[lcd.ac & 0x7F];
+        else
+            lcd.rd = ((now_ns < lcd.busy_until) ? 0x80 : 0) | (lcd.ac & 0x7F);
+    }
+    if (!en && lcd.en)
+    {
+        if (!rw)
+            lcd_write(rs, (out >> 16) & 0xFF);
+        lcd.driving = 0;
+    }
+    if (!en || !rw)
+        lcd.driving = 0;
+    lcd.en = en;
+}
+
+void sim_lcd_text(char line[2][17])
+{
+    int r, c;
+
+    for (r = 0; r < 2; r++)
+    {
+        for (c = 0; c < 16; c++)
+        {
+            unsigned char ch = lcd.ddram[r * 0x40 + c];
+            line[r][c] = (ch < 8) ? '*' : (ch < 0x20 || ch > 0x7E) ? '?' : ch;
+        }
+        line[r][16] = '\0';
+    }
+}
+
+static void lcd_log(int force)
+{
+    char text[2][17];
+
+    if (!lcd_file)
+        return;
+    if (!force && now_ns < lcd_next_log_ns)
+        return;
+    lcd_next_log_ns = now_ns + 100 * SIM_NS_PER_MS;
+    sim_lcd_text(text);
+    if (!force && memcmp(text, lcd_logged, sizeof text) == 0)
+        return;
+    memcpy(lcd_logged, text, sizeof text);
+    fprintf(lcd_file, "%10.3f |%s|%s|\n", now_ns / 1e9, text[0], text[1]);
+}
+
+/*==================================================
+  GPIO
+==================================================*/
+static unsigned long pins(int port)
+{
+    unsigned long in = 0xFFFFFFFFUL, dir;
+
+    if (port == 0)
+    {
+        dir = shown[SIM_IODIR0];
+        if (sw_down)
+            in &= ~(1UL << SW_PIN);
+        if (lcd.driving)
+            in = (in & ~0x00FF0000UL) | ((unsigned long)lcd.rd << 16);
+    }
+    else
+    {
+        dir = shown[SIM_IODIR1];
+        if (key_down >= 0)
+        {
+            int row = key_down / 4, col = key_down % 4;
+            unsigned long rowdrv = latch[1] & dir;
+
+            // pressed key pulls its column low when its row is driven low
+            if ((dir >> (16 + row)) & 1)
+                if (((rowdrv >> (16 + row)) & 1) == 0)
+                    in &= ~(1UL << (20 + col));
+        }
+    }
+    return ((latch[port] & dir) | (in & ~dir)) & 0xFFFFFFFFUL;
+}
+
+/*==================================================
+  UART0
+==================================================*/
+static uint64_t uart_char_ns(void)
+{
+    unsigned long div = (shown[SIM_U0DLM] << 8) | shown[SIM_U0DLL];
+    unsigned long fdr = shown[SIM_U0FDR];
+    unsigned long mul = (fdr >> 4) & 0xF, add = fdr & 0xF;
+    double baud;
+
+    if (div == 0)
+        div = 1;
+    if (mul == 0)
+        mul = 1;
+    baud = (double)SIM_PCLK_HZ / (16.0 * div * (1.0 + (double)add / mul));
+    return (uint64_t)(10.0 * 1e9 / baud);
+}
+
+static void uart_tx_push(unsigned char b)
+{
+    if (!uart.shifting)
+    {
+        uart.shift = b;       // straight into the shift register
+        uart.shifting = 1;
+        uart.shift_done = now_ns + uart_char_ns();
+        uart.thre_irq = 1;
+        return;
+    }
+    if (uart.tx_count >= 16)
+    {
+        st.uart_tx_overruns++;
+        return;
+    }
+    uart.tx[(uart.tx_head + uart.tx_count) & 15] = b;
+    uart.tx_count++;
+    uart.thre_irq = 0;
+}
+
+static void uart_emit(unsigned char b)
+{
+    st.uart_tx_bytes++;
+    if (b == (unsigned char)alert_tag[watch.alert_match])
+    {
+        if (!alert_tag[++watch.alert_match])
+        {
+            watch.alert_match = 0;
+            if (watch.armed && !st.alarm_alert_ns)
+                st.alarm_alert_ns = now_ns;
+        }
+    }
+    else
+        watch.alert_match = (b == '[');
+    if (uart_file)
+        fputc(b, uart_file);
+}
+
+static void uart_step(void)
+{
+    while (uart.shifting && now_ns >= uart.shift_done)
+    {
+        uart_emit(uart.shift);
+        if (uart.tx_count)
+        {
+            uart.shift = uart.tx[uart.tx_head];
+            uart.tx_head = (uart.tx_head + 1) & 15;
+            uart.tx_count--;
+            uart.shift_done += uart_char_ns();
+            if (uart.tx_count == 0)
+                uart.thre_irq = 1;
+        }
+        else
+            uart.shifting = 0;
+    }
+
+    while (uart.rx_qpos < uart.rx_qlen && now_ns >= uart.rx_next)
+    {
+        if (uart.rx_count < 16)
+        {
+            uart.rx[(uart.rx_head + uart.rx_count) & 15] = uart.rx_queue[uart.rx_qpos];
+            uart.rx_count++;
+            st.uart_rx_bytes++;
+        }
+        else
+            st.uart_rx_overruns++;
+        uart.rx_qpos++;
+        uart.rx_next += uart_char_ns();
+    }
+}
+
+static int uart_irq(void)
+{
+    unsigned long ier = shown[SIM_U0IER];
+
+    return ((ier & 1) && uart.rx_count) || ((ier & 2) && uart.thre_irq);
+}
+
+static unsigned long uart_iir(void)
+{
+    unsigned long ier = shown[SIM_U0IER];
+    unsigned long fifo = (shown[SIM_U0FCR] & 1) ? 0xC0 : 0;
+
+    uart.iir_thre = 0;
+    if ((ier & 1) && uart.rx_count)
+        return fifo | 0x04;               // RDA
+    if ((ier & 2) && uart.thre_irq)
+    {
+        uart.iir_thre = 1;
+        return fifo | 0x02;               // THRE
+    }
+    return fifo | 0x01;                   // nothing pending
+}
+
+static unsigned long uart_lsr(void)
+{
+    unsigned long lsr = 0;
+
+    if (uart.rx_count)
+        lsr |= 1 << 0;                    // RDR
+    if (uart.tx_count == 0)
+        lsr |= 1 << 5;                    // THRE
+    if (uart.tx_count == 0 && !uart.shifting)
+        lsr |= 1 << 6;                    // TEMT
+    return lsr;
+}
+
+/*==================================================
+  ADC
+==================================================*/
+static double adc_temp(int ch)
+{
+    if (adc.t1[ch] > adc.t0[ch] && now_ns < adc.t1[ch])
+    {
+        double f = (double)(now_ns - adc.t0[ch]) / (double)(adc.t1[ch] - adc.t0[ch]);
+        return adc.from[ch] + (adc.to[ch] - adc.from[ch]) * f;
+    }
+    return adc.temp[ch];
+}
+
+static unsigned long adc_counts(int ch)
+{
+    // LM35: 10 mV per degC, Vref = 3.3 V, 10-bit result
+    double v = adc_temp(ch) * 0.01;
+    double c = v * 1023.0 / 3.3;
+
+    if (adc.sigma[ch] > 0)
+        c += gauss() * adc.sigma[ch];
+    c = floor(c + 0.5);
+    if (c < 0)
+        c = 0;
+    if (c > 1023)
+        c = 1023;
+    return (unsigned long)c;
+}
+
+static uint64_t adc_conv_ns(void)
+{
+    unsigned long clkdiv = (shown[SIM_ADCR] >> 8) & 0xFF;
+    unsigned long clks = 11;
+
+    if ((shown[SIM_ADCR] >> 16) & 1)
+        clks = 11 - ((shown[SIM_ADCR] >> 17) & 7);   // CLKS in burst mode
+    return clks * (clkdiv + 1) * SIM_NS_PER_S / SIM_PCLK_HZ;
+}
+
+static int adc_next_ch(int from)
+{
+    unsigned long sel = shown[SIM_ADCR] & 0xFF;
+    int i;
+
+    if (!sel)
+        return -1;
+    for (i = 0; i < 8; i++)
+    {
+        int ch = (from + i) & 7;
+        if ((sel >> ch) & 1)
+            return ch;
+    }
+    return -1;
+}
+
+static void adc_start(int ch, uint64_t at)
+{
+    if (ch < 0 || !((shown[SIM_ADCR] >> 21) & 1))
+    {
+        adc.busy = 0;
+        return;
+    }
+    adc.busy = 1;
+    adc.ch = ch;
+    adc.done_at = at + adc_conv_ns();
+}
+
+static void adc_step(void)
+{
+    while (adc.busy && now_ns >= adc.done_at)
+    {
+        unsigned long dr = (adc_counts(adc.ch) << 6) | ((unsigned long)adc.ch << 24) | (1UL << 31);
+
+        if (adc.dr & (1UL << 31))
+        {
+            dr |= 1UL << 30;    // OVERRUN
+            st.adc_overruns++;
+        }
+        adc.dr = dr;
+        st.adc_conversions++;
+        if (watch.armed && adc.ch == watch.ch && !st.alarm_cross_ns &&
+            (adc_temp(adc.ch) - watch.level) * watch.dir >= 0)
+            st.alarm_cross_ns = now_ns;
+
+        if ((shown[SIM_ADCR] >> 16) & 1)
+            adc_start(adc_next_ch(adc.ch + 1), adc.done_at);
+        else
+            adc.busy = 0;
+    }
+}
+
+/*==================================================
+  RTC
+==================================================*/
+static void rtc_tick(void)
+{
+    unsigned long ciir = shown[SIM_CIIR], inc = 1;
+
+    if (++rtc.sec >= 60)
+    {
+        rtc.sec = 0;
+        inc |= 2;
+        if (++rtc.min >= 60)
+        {
+            rtc.min = 0;
+            inc |= 4;
+            if (++rtc.hour >= 24)
+            {
+                rtc.hour = 0;
+                inc |= 8 | 16 | 32;
+                rtc.dow = (rtc.dow + 1) % 7;
+                rtc.doy++;
+                if (++rtc.dom > (unsigned long)days_in_month(rtc.month, rtc.year))
+                {
+                    rtc.dom = 1;
+                    inc |= 64;
+                    if (++rtc.month > 12)
+                    {
+                        rtc.month = 1;
+                        rtc.doy = 1;
+                        rtc.year++;
+                        inc |= 128;
+                    }
+                }
+            }
+        }
+    }
+    if (ciir & inc)
+        rtc.ilr |= 1;
+}
+
+static void rtc_step(void)
+{
+    if (shown[SIM_CCR] & 1)
+    {
+        int64_t d = (int64_t)(now_ns - rtc.last);
+
+        // A 32 kHz crystal runs off the main one by ppm
+        rtc.ppm_frac += (int64_t)(d * rtc.ppm);
+        d += rtc.ppm_frac / 1000000;
+        rtc.ppm_frac %= 1000000;
+        rtc.phase += d;
+        while (rtc.phase >= SIM_NS_PER_S)
+        {
+            rtc.phase -= SIM_NS_PER_S;
+            rtc_tick();
+        }
+    }
+    rtc.last = now_ns;
+}
+
+/*==================================================
+  Timers
+==================================================*/
+#define TREG(t, off) shown[(t)->base + (off)]   // IR TCR TC PR PC MCR MR0..3
+
+static void tmr_step(tmr_t *t)
+{
+    uint64_t cyc = pclk_cycles(now_ns);
+    uint64_t n = cyc - t->last_pclk;
+    unsigned long pr = TREG(t, 3) + 1, mcr = TREG(t, 5);
+
+    t->last_pclk = cyc;
+    if ((TREG(t, 1) & 3) != 1)          // disabled or held in reset
+        return;
+
+    t->pc += n;
+    n = t->pc / pr;
+    t->pc %= pr;
+
+    while (n)
+    {
+        uint64_t dist = 0;
+        int i;
+
+        for (i = 0; i < 4; i++)
+        {
+            unsigned long mr = TREG(t, 6 + i);
+            if (((mcr >> (3 * i)) & 7) && mr > t->tc)
+                if (!dist || mr - t->tc < dist)
+                    dist = mr - t->tc;
+        }
+        if (!dist || n < dist)
+        {
+            t->tc = (t->tc + n) & 0xFFFFFFFFUL;
+            break;
+        }
+        t->tc += dist;
+        n -= dist;
+        for (i = 0; i < 4; i++)
+        {
+            if (TREG(t, 6 + i) != t->tc)
+                continue;
+            if ((mcr >> (3 * i)) & 1)
+                t->ir |= 1UL << i;
+            if ((mcr >> (3 * i)) & 4)
+            {
+                shown[t->base + 1] &= ~1UL;
+                regs[t->base + 1] = shown[t->base + 1];
+                n = 0;
+            }
+        }
+        for (i = 0; i < 4; i++)
+            if (TREG(t, 6 + i) == t->tc && ((mcr >> (3 * i)) & 2))
+                t->tc = 0;
+    }
+}
+
+/*==================================================
+  Flash and IAP
+==================================================*/
+static unsigned long sector_addr(int n)
+{
+    if (n < 8)
+        return n * 0x1000UL;
+    if (n < 22)
+        return 0x8000UL + (n - 8) * 0x8000UL;
+    return 0x78000UL + (n - 22) * 0x1000UL;
+}
+
+static unsigned long sector_size(int n)
+{
+    return (n >= 8 && n < 22) ? 0x8000UL : 0x1000UL;
+}
+
+static int sector_of(unsigned long addr)
+{
+    int n;
+
+    for (n = 0; n < FLASH_SECTORS; n++)
+        if (addr >= sector_addr(n) && addr < sector_addr(n) + sector_size(n))
+            return n;
+    return -1;
+}
+
+static void flash_save(unsigned long addr, unsigned long len)
+{
+    if (!flash_file)
+        return;
+    fseek(flash_file, (long)addr, SEEK_SET);
+    fwrite(sim_flash + addr, 1, len, flash_file);
+    fflush(flash_file);
+}
+
+/* IAP status codes */
+enum { CMD_SUCCESS, INVALID_COMMAND, SRC_ADDR_ERROR, DST_ADDR_ERROR,
+       SRC_ADDR_NOT_MAPPED, DST_ADDR_NOT_MAPPED, COUNT_ERROR, INVALID_SECTOR,
+       SECTOR_NOT_BLANK, SECTOR_NOT_PREPARED, COMPARE_ERROR, BUSY };
+
+/*
+  The IAP entry point. Commands 50 (prepare), 51 (copy RAM
+  to flash), 52 (erase), 53 (blank check) and 54 (part id).
+  The CPU is stalled for the erase/program time: no
+  interrupts are taken, peripherals keep running.
+*/
+void sim_iap(unsigned long *cmd, unsigned long *res)
+{
+    unsigned long a, i;
+    int n, first = (int)cmd[1], last = (int)cmd[2];
+
+    commit_window();
+    if (cmd[0] == 50 || cmd[0] == 52 || cmd[0] == 53)
+    {
+        if (first < 0 || last >= FLASH_SECTORS || first > last)
+        {
+            res[0] = INVALID_SECTOR;
+            return;
+        }
+    }
+
+    res[0] = CMD_SUCCESS;
+    switch (cmd[0])
+    {
+    case 50:
+        for (n = first; n <= last; n++)
+            flash_prepared[n] = 1;
+        break;
+
+    case 51:
+    {
+        unsigned long dst = cmd[1], len = cmd[3];
+        const unsigned char *src = (const unsigned char *)cmd[2];
+
+        if (dst % 256)
+        {
+            res[0] = DST_ADDR_ERROR;
+            return;
+        }
+        if (len != 256 && len != 512 && len != 1024 && len != 4096)
+        {
+            res[0] = COUNT_ERROR;
+            return;
+        }
+        n = sector_of(dst);
+        if (n < 0 || sector_of(dst + len - 1) != n)
+        {
+            res[0] = DST_ADDR_NOT_MAPPED;
+            return;
+        }
+        if (!flash_prepared[n])
+        {
+            res[0] = SECTOR_NOT_PREPARED;
+            return;
+        }
+        for (i = 0; i < len; i++)
+        {
+            if (sim_flash[dst + i] != 0xFF)
+                st.flash_reprograms++;        // ECC lines can only be written once
+            sim_flash[dst + i] &= src[i];
+        }
+        flash_prepared[n] = 0;
+        st.flash_programs++;
+        st.flash_prog_bytes += len;
+        flash_save(dst, len);
+        sim_stall(FLASH_PROG_NS * (len / 256));
+        break;
+    }
+
+    case 52:
+        for (n = first; n <= last; n++)
+            if (!flash_prepared[n])
+            {
+                res[0] = SECTOR_NOT_PREPARED;
+                return;
+            }
+        for (n = first; n <= last; n++)
+        {
+            a = sector_addr(n);
+            memset(sim_flash + a, 0xFF, sector_size(n));
+            flash_prepared[n] = 0;
+            st.flash_erases++;
+            st.flash_sector_erases[n]++;
+            flash_save(a, sector_size(n));
+            sim_stall(FLASH_ERASE_NS);
+        }
+        break;
+
+    case 53:
+        for (n = first; n <= last; n++)
+        {
+            a = sector_addr(n);
+            for (i = 0; i < sector_size(n); i++)
+                if (sim_flash[a + i] != 0xFF)
+                {
+                    res[0] = SECTOR_NOT_BLANK;
+                    res[1] = a + i;
+                    res[2] = sim_flash[a + i];
+                    return;
+                }
+        }
+        break;
+
+    case 54:
+        res[1] = 0x0402FF25;                  // LPC2148
+        break;
+
+    default:
+        res[0] = INVALID_COMMAND;
+    }
+}
+
+/*==================================================
+  Script
+==================================================*/
+static void apply_event(event_t *e)
+{
+    switch (e->kind)
+    {
+    case EV_TEMP:  sim_set_temp(e->a, e->v); break;
+    case EV_NOISE: sim_set_noise(e->a, e->v); break;
+    case EV_KEY:   sim_press_key(e->a, (uint32_t)e->v); break;
+    case EV_SW:    sim_press_switch((uint32_t)e->v); break;
+    case EV_RX:    sim_uart_rx(e->text, e->len); break;
+    case EV_WATCH: sim_watch_alarm(e->a, e->v); break;
+    case EV_RAMP:
+        adc.from[e->a] = adc_temp(e->a);
+        adc.to[e->a] = e->v;
+        adc.temp[e->a] = e->v;
+        adc.t0[e->a] = now_ns;
+        adc.t1[e->a] = now_ns + (uint64_t)(e->w * 1e9);
+        break;
+    }
+}
+
+static char *unescape(const char *s, uint32_t *len)
+{
+    char *out = malloc(strlen(s) + 1), *o = out;
+
+    while (*s)
+    {
+        if (*s == '\\' && s[1])
+        {
+            s++;
+            *o++ = (*s == 'n') ? '\n' : (*s == 'r') ? '\r' : (*s == 's') ? ' ' : *s;
+            s++;
+        }
+        else
+            *o++ = *s++;
+    }
+    *len = o - out;
+    return out;
+}
+
+static int ev_cmp(const void *a, const void *b)
+{
+    const event_t *x = a, *y = b;
+
+    if (x->t != y->t)
+        return x->t < y->t ? -1 : 1;
+    return x < y ? -1 : 1;
+}
+
+/*
+  Script format, one event per line ('#' starts a comment):
+    <time_s> temp  <ch> <degC>
+    <time_s> ramp  <ch> <degC> <duration_s>
+    <time_s> noise <ch> <sigma_counts>
+    <time_s> key   <0..15> [hold_ms]
+    <time_s> sw    [hold_ms]
+    <time_s> rx    <text with \r \n \s escapes>
+    <time_s> watch <ch> <degC>   (alarm latency, see sim_watch_alarm)
+*/
+int sim_load_script(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[512];
+    int lineno = 0;
+
+    if (!f)
+    {
+        perror(path);
+        return -1;
+    }
+    while (fgets(line, sizeof line, f))
+    {
+        event_t e;
+        char cmd[16], arg[400];
+        double t;
+        int n;
+
+        lineno++;
+        if (strchr(line, '#'))
+            *strchr(line, '#') = '\0';
+        memset(&e, 0, sizeof e);
+        arg[0] = '\0';
+        n = sscanf(line, "%lf %15s %399[^\n]", &t, cmd, arg);
+        if (n < 2)
+            continue;
+        e.t = (uint64_t)(t * 1e9 + 0.5);
+
+        if (!strcmp(cmd, "temp") && sscanf(arg, "%d %lf", &e.a, &e.v) == 2)
+            e.kind = EV_TEMP;
+        else if (!strcmp(cmd, "ramp") && sscanf(arg, "%d %lf %lf", &e.a, &e.v, &e.w) == 3)
+            e.kind = EV_RAMP;
+        else if (!strcmp(cmd, "noise") && sscanf(arg, "%d %lf", &e.a, &e.v) == 2)
+            e.kind = EV_NOISE;
+        else if (!strcmp(cmd, "key") && sscanf(arg, "%d %lf", &e.a, &e.v) >= 1)
+            e.kind = EV_KEY;
+        else if (!strcmp(cmd, "sw"))
+        {
+            e.kind = EV_SW;
+            sscanf(arg, "%lf", &e.v);
+        }
+        else if (!strcmp(cmd, "watch") && sscanf(arg, "%d %lf", &e.a, &e.v) == 2)
+            e.kind = EV_WATCH;
+        else if (!strcmp(cmd, "rx") && arg[0])
+        {
+            e.kind = EV_RX;
+            e.text = unescape(arg, &e.len);
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: bad event\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+        if ((e.kind == EV_KEY || e.kind == EV_SW) && e.v <= 0)
+            e.v = 80;
+        if ((e.kind <= EV_NOISE || e.kind == EV_WATCH) && (e.a < 0 || e.a > 7))
+        {
+            fprintf(stderr, "%s:%d: bad channel\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+        events = realloc(events, (nevents + 1) * sizeof *events);
+        events[nevents++] = e;
+    }
+    fclose(f);
+    qsort(events, nevents, sizeof *events, ev_cmp);
+    return 0;
+}
+
+/*==================================================
+  Register access
+==================================================*/
+static void present(int id)
+{
+    unsigned long v = regs[id];
+
+    switch (id)
+    {
+    case SIM_IOPIN0:  v = pins(0); break;
+    case SIM_IOPIN1:  v = pins(1); break;
+    case SIM_IOSET0:
+    case SIM_IOCLR0:
+    case SIM_IOSET1:
+    case SIM_IOCLR1:
+    case SIM_VICIntEnClr:
+    case SIM_VICSoftIntClr: v = 0; break;
+
+    case SIM_U0THR:   v = THR_EMPTY; break;
+    case SIM_U0RBR:   v = uart.rx_count ? uart.rx[uart.rx_head] : 0; break;
+    case SIM_U0IIR:   v = uart_iir(); break;
+    case SIM_U0LSR:   v = uart_lsr(); break;
+
+    case SIM_ADDR:    v = adc.dr; break;
+
+    case SIM_ILR:     v = rtc.ilr; break;
+    case SIM_CTC:     v = ((rtc.phase * 32768ULL / SIM_NS_PER_S) & 0x7FFF) << 1; break;
+    case SIM_SEC:     v = rtc.sec; break;
+    case SIM_MIN:     v = rtc.min; break;
+    case SIM_HOUR:    v = rtc.hour; break;
+    case SIM_DOM:     v = rtc.dom; break;
+    case SIM_DOW:     v = rtc.dow; break;
+    case SIM_DOY:     v = rtc.doy; break;
+    case SIM_MONTH:   v = rtc.month; break;
+    case SIM_YEAR:    v = rtc.year; break;
+    case SIM_CTIME0:  v = rtc.sec | (rtc.min << 8) | (rtc.hour << 16) | (rtc.dow << 24); break;
+    case SIM_CTIME1:  v = rtc.dom | (rtc.month << 8) | (rtc.year << 16); break;
+    case SIM_CTIME2:  v = rtc.doy; break;
+
+    case SIM_T0IR:    v = tmr[0].ir; break;
+    case SIM_T0TC:    v = tmr[0].tc; break;
+    case SIM_T0PC:    v = tmr[0].pc; break;
+    case SIM_T1IR:    v = tmr[1].ir; break;
+    case SIM_T1TC:    v = tmr[1].tc; break;
+    case SIM_T1PC:    v = tmr[1].pc; break;
+
+    case SIM_VICIntEnable: v = vic_enabled; break;
+    case SIM_VICVectAddr:  v = vic_current; break;
+    case SIM_PCON:         v = 0; break;
+    }
+    regs[id] = shown[id] = v;
+}
+
+static unsigned long irq_raw(void)
+{
+    unsigned long raw = shown[SIM_VICSoftInt];
+
+    if (tmr[0].ir)                 raw |= 1UL << VIC_TIMER0;
+    if (tmr[1].ir)                 raw |= 1UL << VIC_TIMER1;
+    if (uart_irq())                raw |= 1UL << VIC_UART0;
+    if (rtc.ilr)                   raw |= 1UL << VIC_RTC;
+    if (adc.dr & (1UL << 31))      raw |= 1UL << VIC_AD0;
+    return raw;
+}
+
+/* Buzzer edges; the first rise since sim_watch_alarm() is timed */
+static void buzzer(void)
+{
+    int on = (latch[0] >> BUZ_PIN) & 1;
+
+    if (on && !watch.buz)
+    {
+        st.buzzer_on++;
+        if (watch.armed && !st.alarm_buzzer_ns)
+            st.alarm_buzzer_ns = now_ns;
+    }
+    watch.buz = on;
+}
+
+/* Apply what the firmware did to register id since it was presented */
+static void commit(int id, int accessed)
+{
+    unsigned long v = regs[id];
+    int written = (v != shown[id]);
+
+    if (id < SIM_VICVectAddr0 || id >= SIM_VICVectCntl0)
+        v &= 0xFFFFFFFFUL;
+
+    switch (id)
+    {
+    case SIM_IOPIN0:  if (written) latch[0] = v; break;
+    case SIM_IOPIN1:  if (written) latch[1] = v; break;
+    case SIM_IOSET0:  latch[0] |= v; break;
+    case SIM_IOCLR0:  latch[0] &= ~v; break;
+    case SIM_IOSET1:  latch[1] |= v; break;
+    case SIM_IOCLR1:  latch[1] &= ~v; break;
+
+    case SIM_U0THR:
+        if (written)
+            uart_tx_push(v & 0xFF);
+        break;
+    case SIM_U0RBR:
+        if (accessed && uart.rx_count)
+        {
+            uart.rx_head = (uart.rx_head + 1) & 15;
+            uart.rx_count--;
+        }
+        break;
+    case SIM_U0IIR:
+        if (accessed && uart.iir_thre)
+            uart.thre_irq = 0;
+        uart.iir_thre = 0;
+        break;
+    case SIM_U0FCR:
+        if (written && (v & 2))
+            uart.rx_count = 0;
+        if (written && (v & 4))
+            uart.tx_count = 0;
+        break;
+    case SIM_U0IER:
+        if (written && (v & 2) && uart.tx_count == 0)
+            uart.thre_irq = 1;
+        break;
+
+    case SIM_ADCR:
+        if (written)
+        {
+            shown[id] = v;
+            if ((v >> 16) & 1)
+            {
+                if (!adc.busy)
+                    adc_start(adc_next_ch(0), now_ns);
+            }
+            else if (((v >> 24) & 7) == 1)
+                adc_start(adc_next_ch(0), now_ns);
+        }
+        break;
+    case SIM_ADDR:
+        if (accessed)
+            adc.dr &= ~(3UL << 30);       // reading clears DONE and OVERRUN
+        break;
+
+    case SIM_ILR:     if (written || accessed) rtc.ilr &= ~(written ? v : shown[id]); break;
+    case SIM_SEC:     if (written) rtc.sec = v; break;
+    case SIM_MIN:     if (written) rtc.min = v; break;
+    case SIM_HOUR:    if (written) rtc.hour = v; break;
+    case SIM_DOM:     if (written) rtc.dom = v; break;
+    case SIM_DOW:     if (written) rtc.dow = v; break;
+    case SIM_DOY:     if (written) rtc.doy = v; break;
+    case SIM_MONTH:   if (written) rtc.month = v; break;
+    case SIM_YEAR:    if (written) rtc.year = v; break;
+    case SIM_CCR:
+        if (written && (v & 2))
+            rtc.phase = 0;
+        break;
+
+    case SIM_T0IR:    if (written || accessed) tmr[0].ir &= ~(written ? v : shown[id]); break;
+    case SIM_T0TC:    if (written) tmr[0].tc = v; break;
+    case SIM_T0PC:    if (written) tmr[0].pc = v; break;
+    case SIM_T1IR:    if (written || accessed) tmr[1].ir &= ~(written ? v : shown[id]); break;
+    case SIM_T1TC:    if (written) tmr[1].tc = v; break;
+    case SIM_T1PC:    if (written) tmr[1].pc = v; break;
+    case SIM_T0TCR:
+    case SIM_T1TCR:
+        if (written && (v & 2))
+        {
+            tmr_t *t = &tmr[id == SIM_T1TCR];
+            t->tc = t->pc = 0;
+        }
+        break;
+
+    case SIM_VICIntEnable: if (written) vic_enabled |= v; break;
+    case SIM_VICIntEnClr:  vic_enabled &= ~v; break;
+    case SIM_VICSoftIntClr:
+        shown[SIM_VICSoftInt] &= ~v;
+        regs[SIM_VICSoftInt] = shown[SIM_VICSoftInt];
+        break;
+    case SIM_VICVectAddr:  if (written) vic_current = 0; break;
+
+    case SIM_PCON:
+        if (written && (v & 1))
+            sim_idle();
+        v = 0;                            // IDL clears on wake-up
+        break;
+    }
+
+    if (written || accessed)
+    {
+        shown[id] = v;
+        switch (id)   // read-side registers: re-present the model value
+        {
+        case SIM_IOSET0: case SIM_IOCLR0: case SIM_IOSET1: case SIM_IOCLR1:
+        case SIM_VICIntEnClr: case SIM_VICSoftIntClr:
+        case SIM_U0THR: case SIM_U0RBR: case SIM_U0IIR: case SIM_ADDR:
+        case SIM_ILR: case SIM_T0IR: case SIM_T1IR:
+        case SIM_VICIntEnable: case SIM_VICVectAddr:
+        case SIM_IOPIN0: case SIM_IOPIN1: case SIM_PCON:
+            present(id);
+            break;
+        default:
+            regs[id] = v;
+            break;
+        }
+    }
+    if (id == SIM_IOPIN0 || id == SIM_IOSET0 || id == SIM_IOCLR0 || id == SIM_IODIR0)
+    {
+        lcd_bus();
+        buzzer();
+    }
+}
+
+static void commit_window(void)
+{
+    int i;
+
+    for (i = 1; i >= 0; i--)
+    {
+        if (win[i].id < 0)
+            continue;
+        commit(win[i].id, win[i].fresh);
+        win[i].fresh = 0;
+    }
+}
+
+volatile unsigned long *sim_reg(int id)
+{
+    commit_window();
+
+    st.reg_accesses++;
+    now_ns += SIM_ACCESS_NS;
+    sim_step();
+    sim_irq();
+
+    present(id);
+    win[1] = win[0];
+    win[0].id = id;
+    win[0].fresh = 1;
+    return &regs[id];
+}
+
+static void sim_irq(void)
+{
+    unsigned long pend, fn = 0;
+    win_t saved[2];
+    int i;
+
+    if (in_isr)
+        return;
+    pend = irq_raw() & vic_enabled & ~shown[SIM_VICIntSelect];
+    if (!pend)
+        return;
+
+    for (i = 0; i < 16; i++)
+    {
+        unsigned long c = shown[SIM_VICVectCntl0 + i];
+        if ((c & 0x20) && ((pend >> (c & 0x1F)) & 1))
+        {
+            fn = shown[SIM_VICVectAddr0 + i];
+            break;
+        }
+    }
+    if (!fn)
+        fn = shown[SIM_VICDefVectAddr];
+    if (!fn)
+    {
+        fprintf(stderr, "sim: IRQ 0x%lx has no handler, disabled\n", pend);
+        vic_enabled &= ~pend;
+        return;
+    }
+
+    memcpy(saved, win, sizeof win);
+    win[0].id = win[1].id = -1;
+    in_isr = 1;
+    vic_current = fn;
+    st.irqs++;
+    now_ns += SIM_IRQ_ENTRY_NS;
+
+    ((void (*)(void))fn)();
+
+    commit_window();
+    memcpy(win, saved, sizeof win);
+    in_isr = 0;
+}
+
+/*==================================================
+  Simulated time
+==================================================*/
+static void sim_step(void)
+{
+    while (next_event < nevents && events[next_event].t <= now_ns)
+        apply_event(&events[next_event++]);
+
+    if (sw_down && now_ns >= sw_release_ns)
+        sw_down = 0;
+    if (key_down >= 0 && now_ns >= key_release_ns)
+        key_down = -1;
+
+    rtc_step();
+    tmr_step(&tmr[0]);
+    tmr_step(&tmr[1]);
+    uart_step();
+    adc_step();
+    lcd_log(0);
+
+    if (limit_ns && now_ns >= limit_ns)
+        exit(0);
+}
+
+/* CPU halted until an enabled interrupt is pending */
+static void sim_idle(void)
+{
+    uint64_t from = now_ns;
+
+    if (in_isr || !vic_enabled || (limit_ns && now_ns >= limit_ns))
+        return;                           // nothing to wake us / at exit
+    while (!(irq_raw() & vic_enabled & ~shown[SIM_VICIntSelect]))
+    {
+        now_ns += SIM_SLICE_NS / 10;
+        sim_step();
+    }
+    st.idle_ns += now_ns - from;
+}
+
+/* CPU stalled (IAP): time and peripherals run, no interrupts */
+static void sim_stall(uint64_t ns)
+{
+    uint64_t end = now_ns + ns;
+
+    while (now_ns < end)
+    {
+        uint64_t d = end - now_ns;
+        now_ns += (d > SIM_SLICE_NS) ? SIM_SLICE_NS : d;
+        sim_step();
+    }
+    st.flash_stall_ns += ns;
+}
+
+void sim_advance_ns(uint64_t ns)
+{
+    uint64_t end = now_ns + ns;
+
+    commit_window();
+    while (now_ns < end)
+    {
+        uint64_t d = end - now_ns;
+        now_ns += (d > SIM_SLICE_NS) ? SIM_SLICE_NS : d;
+        sim_step();
+        sim_irq();
+    }
+}
+
+uint64_t sim_time_ns(void)
+{
+    return now_ns;
+}
+
+/*==================================================
+  Set-up, stimulus and observation
+==================================================*/
+void sim_reset(void)
+{
+    int i;
+
+    memset(regs, 0, sizeof regs);
+    memset(shown, 0, sizeof shown);
+    memset(&st, 0, sizeof st);
+    memset(&lcd, 0, sizeof lcd);
+    memset(&uart, 0, sizeof uart);
+    memset(&adc, 0, sizeof adc);
+    memset(&rtc, 0, sizeof rtc);
+    memset(tmr, 0, sizeof tmr);
+    memset(latch, 0, sizeof latch);
+    memset(&watch, 0, sizeof watch);
+    memset(lcd.ddram, ' ', sizeof lcd.ddram);
+    memset(lcd_logged, 0, sizeof lcd_logged);
+    memset(flash_prepared, 0, sizeof flash_prepared);
+    if (!flash_ready)
+        sim_flash_erase_all();              // flash keeps its contents across resets
+
+    win[0].id = win[1].id = -1;
+    now_ns = 0;
+    in_isr = 0;
+    sw_down = 0;
+    key_down = -1;
+    vic_enabled = vic_current = 0;
+    next_event = 0;
+    lcd.inc = 1;
+    lcd_next_log_ns = 0;
+
+    // reset values that differ from zero
+    shown[SIM_U0LCR] = regs[SIM_U0LCR] = 0;
+    shown[SIM_U0FDR] = regs[SIM_U0FDR] = 0x10;
+    shown[SIM_U0DLL] = regs[SIM_U0DLL] = 1;
+    shown[SIM_ADCR]  = regs[SIM_ADCR]  = 1;
+    rtc.dom = rtc.month = rtc.doy = 1;
+    rtc.year = 2000;
+    tmr[0].base = SIM_T0IR; tmr[0].vic = VIC_TIMER0;
+    tmr[1].base = SIM_T1IR; tmr[1].vic = VIC_TIMER1;
+    for (i = 0; i < 8; i++)
+        adc.temp[i] = 25.0;
+}
+
+void sim_set_limit(uint64_t ns)   { limit_ns = ns; }
+void sim_set_uart_file(FILE *f)   { uart_file = f; }
+void sim_set_lcd_file(FILE *f)    { lcd_file = f; }
+
+/* Erased flash, or the contents of an image file that
+   then receives every erase/program */
+int sim_set_flash_file(const char *path)
+{
+    long len;
+
+    if (flash_file)
+        fclose(flash_file);
+    flash_file = NULL;
+    sim_flash_erase_all();
+    if (!path)
+        return 0;
+
+    flash_file = fopen(path, "r+b");
+    if (flash_file)
+    {
+        fseek(flash_file, 0, SEEK_END);
+        len = ftell(flash_file);
+        fseek(flash_file, 0, SEEK_SET);
+        if (len > (long)SIM_FLASH_SIZE)
+            len = SIM_FLASH_SIZE;
+        if (fread(sim_flash, 1, len, flash_file) != (size_t)len)
+            return -1;
+    }
+    else if (!(flash_file = fopen(path, "w+b")))
+    {
+        perror(path);
+        return -1;
+    }
+    flash_save(0, SIM_FLASH_SIZE);
+    return 0;
+}
+
+void sim_flash_erase_all(void)
+{
+    memset(sim_flash, 0xFF, sizeof sim_flash);
+    memset(flash_prepared, 0, sizeof flash_prepared);
+    flash_ready = 1;
+    flash_save(0, SIM_FLASH_SIZE);
+}
+
+void sim_set_temp(int ch, double degc)
+{
+    adc.temp[ch & 7] = degc;
+    adc.t1[ch & 7] = 0;
+}
+
+void sim_set_noise(int ch, double sigma)
+{
+    adc.sigma[ch & 7] = sigma;
+}
+
+/*
+  Alarm latency: times the moment the input of ch (as
+  the ADC converts it, without noise) reaches degc in
+  the direction it has to move from now, the first
+  buzzer rise on P0.25 and the first "[ALERT]" leaving
+  TXD0, in sim_stats() alarm_*_ns. With noise the
+  firmware may see the crossing first. Arming again
+  starts a new measurement.
+*/
+void sim_watch_alarm(int ch, double degc)
+{
+    watch.armed = 1;
+    watch.ch = ch & 7;
+    watch.level = degc;
+    watch.dir = adc_temp(watch.ch) < degc ? 1 : -1;
+    st.alarm_cross_ns = st.alarm_buzzer_ns = st.alarm_alert_ns = 0;
+}
+
+void sim_set_rtc_ppm(double ppm)
+{
+    rtc_step();
+    rtc.ppm = ppm;
+}
+
+void sim_press_key(int key, uint32_t hold_ms)
+{
+    key_down = key & 15;
+    key_release_ns = now_ns + hold_ms * SIM_NS_PER_MS;
+    st.key_presses++;
+}
+
+void sim_press_switch(uint32_t hold_ms)
+{
+    sw_down = 1;
+    sw_release_ns = now_ns + hold_ms * SIM_NS_PER_MS;
+}
+
+void sim_uart_rx(const char *text, uint32_t len)
+{
+    uint32_t left = uart.rx_qlen - uart.rx_qpos;
+    char *q = malloc(left + len);
+
+    if (left)
+        memcpy(q, uart.rx_queue + uart.rx_qpos, left);
+    else
+        uart.rx_next = now_ns + uart_char_ns();
+    memcpy(q + left, text, len);
+    free(uart.rx_queue);
+    uart.rx_queue = q;
+    uart.rx_qlen = left + len;
+    uart.rx_qpos = 0;
+}
+
+const sim_stats_t *sim_stats(void)
+{
+    return &st;
+}
+
+void sim_report(FILE *f)
+{
+    char text[2][17];
+
+    commit_window();
+    lcd_log(1);
+    sim_lcd_text(text);
+    fprintf(f, "sim time           : %.6f s\n", now_ns / 1e9);
+    fprintf(f, "register accesses  : %llu\n", (unsigned long long)st.reg_accesses);
+    fprintf(f, "cpu idle           : %.1f %%\n", now_ns ? 100.0 * st.idle_ns / now_ns : 0.0);
+    fprintf(f, "interrupts         : %llu\n", (unsigned long long)st.irqs);
+    fprintf(f, "lcd cmd/data/reads : %llu / %llu / %llu\n",
+            (unsigned long long)st.lcd_cmds, (unsigned long long)st.lcd_data,
+            (unsigned long long)st.lcd_reads);
+    fprintf(f, "lcd busy violations: %llu\n", (unsigned long long)st.lcd_busy_violations);
+    fprintf(f, "uart tx/rx bytes   : %llu / %llu (overruns %llu / %llu)\n",
+            (unsigned long long)st.uart_tx_bytes, (unsigned long long)st.uart_rx_bytes,
+            (unsigned long long)st.uart_tx_overruns, (unsigned long long)st.uart_rx_overruns);
+    if (st.flash_erases || st.flash_programs)
+        fprintf(f, "flash erase/program: %llu / %llu (%llu bytes, stalled %.3f s)\n",
+                (unsigned long long)st.flash_erases, (unsigned long long)st.flash_programs,
+                (unsigned long long)st.flash_prog_bytes, st.flash_stall_ns / 1e9);
+    fprintf(f, "adc conversions    : %llu (overruns %llu)\n",
+            (unsigned long long)st.adc_conversions, (unsigned long long)st.adc_overruns);
+    if (watch.armed)
+    {
+        fprintf(f, "alarm latency      : ");
+        if (!st.alarm_cross_ns)
+            fprintf(f, "input never crossed %.1f C\n", watch.level);
+        else
+        {
+            fprintf(f, "crossed %.1f C at %.3f s, buzzer ", watch.level, st.alarm_cross_ns / 1e9);
+            if (st.alarm_buzzer_ns)
+                fprintf(f, "%+.1f ms", ((double)st.alarm_buzzer_ns - st.alarm_cross_ns) / 1e6);
+            else
+                fprintf(f, "never");
+            fprintf(f, ", [ALERT] line ");
+            if (st.alarm_alert_ns)
+                fprintf(f, "%+.1f ms\n", ((double)st.alarm_alert_ns - st.alarm_cross_ns) / 1e6);
+            else
+                fprintf(f, "never\n");
+        }
+    }
+    fprintf(f, "lcd                : |%s|\n", text[0]);
+    fprintf(f, "                     |%s|\n", text[1]);
+}
@@ -0,0 +1,78 @@
+/*----------------------------------------------------
+  sim.h
+
+  Host-side LPC21xx simulator interface.
+
+  The firmware only ever sees <LPC21xx.h>; this header
+  is for the Linux harnesses (sim_main.c, bench.c) that
+  drive the simulated board: scripted LM35 inputs, key
+  presses, simulated time and the captured outputs.
+----------------------------------------------------*/
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define SIM_PCLK_HZ    15000000ULL   // CCLK 60 MHz, VPB divider 4
+#define SIM_NS_PER_S   1000000000ULL
+#define SIM_NS_PER_MS  1000000ULL
+#define SIM_NS_PER_US  1000ULL
+#define SIM_FLASH_SIZE 0x80000       // LPC2148, 512 KB
+
+typedef struct
+{
+    uint64_t reg_accesses;        // sim_reg() calls (firmware + ISRs)
+    uint64_t idle_ns;             // time spent in PCON idle mode
+    uint64_t irqs;                // interrupts dispatched
+    uint64_t lcd_cmds;            // HD44780 instruction writes
+    uint64_t lcd_data;            // HD44780 DDRAM/CGRAM data writes
+    uint64_t lcd_reads;           // busy flag / address reads
+    uint64_t lcd_busy_violations; // writes issued while controller busy
+    uint64_t uart_tx_bytes;       // bytes shifted out of TXD0
+    uint64_t uart_tx_overruns;    // bytes written into a full TX FIFO
+    uint64_t uart_rx_bytes;       // bytes delivered to the RX FIFO
+    uint64_t uart_rx_overruns;    // bytes lost on a full RX FIFO
+    uint64_t adc_conversions;     // completed A/D conversions
+    uint64_t adc_overruns;        // results overwritten before read
+    uint64_t key_presses;         // scripted keypad presses
+    uint64_t flash_erases;        // IAP sector erases
+    uint64_t flash_programs;      // IAP copy RAM to flash
+    uint64_t flash_prog_bytes;    // bytes programmed
+    uint64_t flash_reprograms;    // bytes programmed while not erased
+    uint64_t flash_stall_ns;      // CPU stalled in IAP
+    uint64_t flash_sector_erases[27];
+    uint64_t buzzer_on;           // buzzer (P0.25) rising edges
+    uint64_t alarm_cross_ns;      // sim_watch_alarm(): input crossed,
+    uint64_t alarm_buzzer_ns;     //   buzzer on, "[ALERT]" on TXD0
+    uint64_t alarm_alert_ns;      //   (sim time, 0 = not yet)
+} sim_stats_t;
+
+/* Set-up */
+void     sim_reset(void);
+int      sim_load_script(const char *path);
+void     sim_set_limit(uint64_t ns);
+void     sim_set_uart_file(FILE *f);
+void     sim_set_lcd_file(FILE *f);
+int      sim_set_flash_file(const char *path);
+void     sim_flash_erase_all(void);
+
+/* Simulated time */
+uint64_t sim_time_ns(void);
+void     sim_advance_ns(uint64_t ns);
+
+/* Stimulus */
+void     sim_set_temp(int ch, double degc);
+void     sim_set_noise(int ch, double sigma_counts);
+void     sim_set_rtc_ppm(double ppm);
+void     sim_watch_alarm(int ch, double degc);
+void     sim_press_key(int key, uint32_t hold_ms);
+void     sim_press_switch(uint32_t hold_ms);
+void     sim_uart_rx(const char *text, uint32_t len);
+
+/* Observation */
+void     sim_lcd_text(char line[2][17]);
+const sim_stats_t *sim_stats(void);
+void     sim_report(FILE *f);
+
+#endif
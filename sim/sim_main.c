@@ -0,0 +1,73 @@
+/*----------------------------------------------------
+  sim_main.c
+
+  Runs the unmodified firmware main() (renamed fw_main
+  at compile time) on the simulated board.
+
+  Usage: logger_sim [-t seconds] [-s script]
+                    [-u uart.out] [-l lcd.out] [-f flash.bin] [-q]
+
+    -t  stop after this much simulated time (default 70)
+    -s  stimulus script (see sim_load_script() in sim.c)
+    -u  file receiving every byte sent on TXD0 ('-' = stdout)
+    -l  file receiving time-stamped LCD snapshots
+    -f  flash image: loaded at start (created erased if
+        missing) and updated by every erase/program
+    -q  do not print the statistics report at exit
+----------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sim.h"
+
+int fw_main(void);
+
+static int quiet;
+
+static void at_exit(void)
+{
+    fflush(stdout);
+    if (!quiet)
+        sim_report(stderr);
+}
+
+static FILE *open_out(const char *path)
+{
+    FILE *f = strcmp(path, "-") ? fopen(path, "w") : stdout;
+
+    if (!f)
+    {
+        perror(path);
+        exit(2);
+    }
+    return f;
+}
+
+int main(int argc, char **argv)
+{
+    double secs = 70;
+    int opt;
+
+    sim_reset();
+    while ((opt = getopt(argc, argv, "t:s:u:l:f:q")) != -1)
+    {
+        switch (opt)
+        {
+        case 't': secs = atof(optarg); break;
+        case 's': if (sim_load_script(optarg)) return 2; break;
+        case 'u': sim_set_uart_file(open_out(optarg)); break;
+        case 'l': sim_set_lcd_file(open_out(optarg)); break;
+        case 'f': if (sim_set_flash_file(optarg)) return 2; break;
+        case 'q': quiet = 1; break;
+        default:
+            fprintf(stderr, "usage: %s [-t seconds] [-s script] [-u uart.out] [-l lcd.out] [-f flash.bin] [-q]\n", argv[0]);
+            return 2;
+        }
+    }
+    sim_set_limit((unsigned long long)(secs * 1e9));
+    atexit(at_exit);
+
+    fw_main();
+    return 0;
+}
@@ -0,0 +1,253 @@
+#include <LPC21xx.h>        // LPC21xx register definitions
+#include "types.h"          // Custom data types
+#include "timer_defines.h"  // TIMER0_VIC_CHNO
+#include "chan.h"           // ChanOverSp()
+#include "stats.h"          // Summary records
+
+/*----------------------------------------------------
+  Accumulators
+
+  The minute bucket takes the samples as integer sums
+  of the value and of its square (no soft-float in
+  the interrupt, the core has no FPU), both of the
+  distance from the bucket's first value so a steady
+  input keeps them small. When it closes it is merged
+  into the hour, and the hour into the day, by adding
+  the sums moved to the longer bucket's reference, so
+  the long buckets cost one merge per minute. 64 bits
+  hold a day at 10 ms over the whole s16 range.
+
+  StatsAdd() runs in the sampler interrupt; readers
+  copy with the Timer0 interrupt held off.
+----------------------------------------------------*/
+typedef struct
+{
+    u32 start;
+    u32 n;
+    s32 ref;            // First value; the sums are of value - ref
+    s64 sum;
+    s64 sq;             // Sum of squares
+    s32 min, max;
+    u32 minTime, maxTime;
+    u32 overMs;
+} stat_acc_t;
+
+static const u32 spanS[STAT_SPANS] = { 60, 3600, 86400 };
+
+static stat_acc_t statAcc[CHAN_COUNT][STAT_SPANS];
+static stat_rec_t statRing[STAT_RING_RECS];
+static volatile u32 statHead;   // Next sequence number (ISR writes)
+
+/*----------------------------------------------------
+  StatsInit()
+
+  Empties every bucket and the summary ring.
+----------------------------------------------------*/
+void StatsInit(void)
+{
+    u8 ch, s;
+
+    for(ch = 0; ch < CHAN_COUNT; ch++)
+        for(s = 0; s < STAT_SPANS; s++)
+            statAcc[ch][s].n = 0;
+    statHead = 0;
+}
+
+/*----------------------------------------------------
+  StatsMerge()
+
+  Folds bucket b into a (a may be empty); a's start
+  is aligned to span.
+----------------------------------------------------*/
+static void StatsMerge(stat_acc_t *a, const stat_acc_t *b, u8 span)
+{
+    s64 k;
+
+    if(!b->n)
+        return;
+    if(!a->n)
+    {
+        *a = *b;
+        a->start = b->start - b->start % spanS[span];
+        return;
+    }
+
+    k = b->ref - a->ref;                // b's sums moved to a's ref
+    a->sq += b->sq + 2 * k * b->sum + (s64)b->n * k * k;
+    a->sum += b->sum + (s64)b->n * k;
+    a->n += b->n;
+    if(b->min < a->min)
+    {
+        a->min = b->min;
+        a->minTime = b->minTime;
+    }
+    if(b->max > a->max)
+    {
+        a->max = b->max;
+        a->maxTime = b->maxTime;
+    }
+    a->overMs += b->overMs;
+}
+
+/*----------------------------------------------------
+  ISqrt()
+
+  Integer square root, rounded to nearest.
+----------------------------------------------------*/
+static u32 ISqrt(u32 x)
+{
+    u32 r = 0, bit = 1UL << 30;
+
+    while(bit > x)
+        bit >>= 2;
+    while(bit)
+    {
+        if(x >= r + bit)
+        {
+            x -= r + bit;
+            r = (r >> 1) + bit;
+        }
+        else
+            r >>= 1;
+        bit >>= 2;
+    }
+    return x > r ? r + 1 : r;           // x is now the remainder
+}
+
+/*----------------------------------------------------
+  StatsSummary()
+
+  Summary record of an accumulator. The squared sum
+  over n is split at sum / n so that no product of
+  two sums overflows.
+----------------------------------------------------*/
+static void StatsSummary(const stat_acc_t *a, u8 ch, u8 span, stat_rec_t *r)
+{
+    s64 n = a->n, half = a->sum < 0 ? -(n / 2) : n / 2;
+    s64 ss = a->sq - (a->sum / n * a->sum + a->sum % n * a->sum / n);
+    u64 var = n > 1 && ss > 0 ? (u64)ss * 100 / (n - 1) : 0;  // Tenths squared
+
+    if(var > 0xFFFFFFFF)
+        var = 0xFFFFFFFF;
+
+    r->start   = a->start;
+    r->count   = a->n;
+    r->minTime = a->minTime;
+    r->maxTime = a->maxTime;
+    r->overS   = a->overMs / 1000;
+    r->mean    = (s16)(a->ref + (a->sum + half) / n);
+    r->sd      = (u16)((ISqrt((u32)var) + 5) / 10);   // Via tenths
+    r->min     = (s16)a->min;
+    r->max     = (s16)a->max;
+    r->ch      = ch;
+    r->span    = span;
+}
+
+/*----------------------------------------------------
+  StatsAdd()
+
+  One sample of channel ch taken at time (RTC
+  seconds); periodMs is the time it stands for in
+  the time-over-SP total. Buckets the sample no
+  longer falls in are closed first, from the minute
+  up; a minute of fewer than STAT_MIN_SAMPLES only
+  goes into the hour. Interrupt context (sampler).
+----------------------------------------------------*/
+void StatsAdd(u8 ch, s32 value, u32 time, u32 periodMs)
+{
+    stat_acc_t *a = statAcc[ch];
+    s32 d;
+    u8 s;
+
+    for(s = 0; s < STAT_SPANS; s++)
+    {
+        if(!a[s].n || time / spanS[s] == a[s].start / spanS[s])
+            break;                      // Still open: so are the longer ones
+        if(s != STAT_MIN || a[s].n >= STAT_MIN_SAMPLES)
+        {
+            StatsSummary(&a[s], ch, s, &statRing[statHead & (STAT_RING_RECS - 1)]);
+            statHead++;
+        }
+        if(s + 1 < STAT_SPANS)
+            StatsMerge(&a[s + 1], &a[s], s + 1);
+        a[s].n = 0;
+    }
+
+    if(!a->n)
+    {
+        a->start = time - time % spanS[STAT_MIN];
+        a->ref = value;
+        a->sum = 0;
+        a->sq = 0;
+        a->min = a->max = value;
+        a->minTime = a->maxTime = time;
+        a->overMs = 0;
+    }
+    else if(value < a->min)
+    {
+        a->min = value;
+        a->minTime = time;
+    }
+    else if(value > a->max)
+    {
+        a->max = value;
+        a->maxTime = time;
+    }
+
+    a->n++;
+    d = value - a->ref;
+    a->sum += d;
+    a->sq += (s64)d * d;
+
+    if(ChanOverSp(ch, value))
+        a->overMs += periodMs;
+}
+
+/*----------------------------------------------------
+  StatsCurrent()
+
+  Summary of the bucket of span still open, with the
+  shorter buckets it has not absorbed yet. Returns 0
+  if it has no samples.
+----------------------------------------------------*/
+u8 StatsCurrent(u8 ch, u8 span, stat_rec_t *r)
+{
+    stat_acc_t acc[STAT_SPANS], sum;
+    u8 s;
+
+    VICIntEnClr = (1<<TIMER0_VIC_CHNO);
+    for(s = 0; s <= span; s++)
+        acc[s] = statAcc[ch][s];
+    VICIntEnable = (1<<TIMER0_VIC_CHNO);
+
+    sum = acc[span];
+    for(s = 0; s < span; s++)
+        StatsMerge(&sum, &acc[s], span);
+    if(!sum.n)
+        return 0;
+    StatsSummary(&sum, ch, span, r);
+    return 1;
+}
+
+/*----------------------------------------------------
+  StatsRead() / StatsHead() / StatsOldest()
+
+  Closed buckets by sequence number, as LogRead().
+----------------------------------------------------*/
+u8 StatsRead(u32 seq, stat_rec_t *r)
+{
+    if(seq >= statHead || seq < StatsOldest())
+        return 0;
+    *r = statRing[seq & (STAT_RING_RECS - 1)];
+    return seq >= StatsOldest();        // Not overwritten while copying
+}
+
+u32 StatsHead(void)
+{
+    return statHead;
+}
+
+u32 StatsOldest(void)
+{
+    return statHead > STAT_RING_RECS ? statHead - STAT_RING_RECS : 0;
+}
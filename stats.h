@@ -0,0 +1,53 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "types.h"
+#include "chan.h"
+
+/*----------------------------------------------------
+  Per-interval statistics
+
+  Every sample the sampler takes goes into a running
+  accumulator per channel (StatsAdd(), O(1)). Closed
+  1 minute, 1 hour and 1 day buckets become summary
+  records in a small ring; the buckets still open can
+  be read with StatsCurrent(). Buckets follow the RTC:
+  minutes, hours and days start on the clock.
+----------------------------------------------------*/
+#define STAT_MIN        0
+#define STAT_HOUR       1
+#define STAT_DAY        2
+#define STAT_SPANS      3
+
+// A closed minute with fewer samples is not sent: one
+// sample a minute (the default rate) would repeat its
+// own log record; it still counts in the hour and day
+#define STAT_MIN_SAMPLES 2
+
+#ifndef STAT_RING_RECS
+#define STAT_RING_RECS  32      // power of 2
+#endif
+
+typedef struct
+{
+    u32 start;          // Bucket start, RTC seconds
+    u32 count;          // Samples
+    u32 minTime;        // RTC seconds of the (first) minimum
+    u32 maxTime;        // and maximum
+    u32 overS;          // Seconds at or over the set point
+    s16 mean;           // Value units (0.1 C / mV)
+    u16 sd;             // Standard deviation, value units
+    s16 min;
+    s16 max;
+    u8  ch;
+    u8  span;           // STAT_MIN / HOUR / DAY
+} stat_rec_t;
+
+void StatsInit(void);
+void StatsAdd(u8 ch, s32 value, u32 time, u32 periodMs);
+u8 StatsCurrent(u8 ch, u8 span, stat_rec_t *);
+u8 StatsRead(u32 seq, stat_rec_t *);
+u32 StatsHead(void);
+u32 StatsOldest(void);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef TIMER_DEFINES_H
+#define TIMER_DEFINES_H
+
+// System clock and peripheral clock Macros
+#define FOSC 12000000
+#define CCLK (FOSC*5)
+#define PCLK (CCLK/4)
+
+// Timer0 timebase: T0TC counts microseconds, MR0 gives the 1 ms tick
+#define TICK_US_HZ   1000000
+#define T0_PR_VAL    ((PCLK/TICK_US_HZ)-1)
+#define MS_TICK_US   1000
+
+// TCR / MCR / IR bits
+#define TCR_ENABLE   (1<<0)
+#define TCR_RESET    (1<<1)
+#define MCR_MR0I     (1<<0)
+#define MCR_MR0R     (1<<1)
+#define MCR_MR1I     (1<<3)
+#define IR_MR0       (1<<0)
+#define IR_MR1       (1<<1)
+
+// VIC assignment
+#define TIMER0_VIC_CHNO 4
+#define TIMER0_VIC_SLOT 0
+#define TIMER1_VIC_CHNO 5    // keypad scan
+#define TIMER1_VIC_SLOT 2
+
+#endif
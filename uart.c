@@ -2,6 +2,158 @@
 #include "macros.h"       // READBIT macro definition
 #include "pin_connect.h"  // Pin configuration function
 #include "types.h"        // Custom data types (u32, s8, f32 etc.)
+#include "uart_defines.h" // UART0 bits, VIC slot, TX buffer size
+#include "uart.h"         // TX overflow policies
+#include "fmt.h"          // Number formatting
+
+#ifndef UART_TX_POLICY
+#define UART_TX_POLICY UART_TX_BLOCK
+#endif
+
+#define TX_MASK (UART_TX_BUF_SIZE - 1)
+#define RX_MASK (UART_RX_BUF_SIZE - 1)
+
+/*----------------------------------------------------
+  Transmit ring buffer
+
+  UARTTxChar()/UARTTxStr() only queue bytes here; the
+  UART0 THRE interrupt moves them into the 16-byte
+  hardware FIFO. txHead is advanced by the writer,
+  txTail by the ISR. Both sides touch the indices with
+  the UART0 interrupt masked at the VIC.
+----------------------------------------------------*/
+static volatile u8  txBuf[UART_TX_BUF_SIZE];
+static volatile u32 txHead, txTail;
+static volatile u8  txBusy;        // ISR is draining the buffer
+static volatile u32 txDropped;     // bytes lost to the overflow policy
+static u8 txPolicy = UART_TX_POLICY;
+
+#define TX_LOCK()   (VICIntEnClr = (1<<UART0_VIC_CHNO))
+#define TX_UNLOCK() (VICIntEnable = (1<<UART0_VIC_CHNO))
+
+/*----------------------------------------------------
+  Receive ring buffer
+
+  Filled by the UART0 ISR (RDA / character timeout),
+  emptied by UARTRxGet(). rxHead is only written by
+  the ISR and rxTail only by the reader, so no lock
+  is needed. Bytes arriving on a full ring, and
+  hardware FIFO overruns, are counted in rxDropped.
+----------------------------------------------------*/
+static volatile u8  rxBuf[UART_RX_BUF_SIZE];
+static volatile u32 rxHead, rxTail;
+static volatile u32 rxDropped;
+
+/*----------------------------------------------------
+  UARTTxFill()
+
+  Moves up to one FIFO's worth of queued bytes into
+  U0THR. Called from the ISR on THRE, or by a writer
+  (interrupt masked) when the transmitter is idle.
+----------------------------------------------------*/
+static void UARTTxFill(void)
+{
+    u8 n = UART_TX_FIFO;
+
+    if (txTail == txHead)
+    {
+        txBusy = 0;             // nothing left, next byte restarts us
+        return;
+    }
+    while (n-- && txTail != txHead)
+    {
+        U0THR = txBuf[txTail];
+        txTail = (txTail + 1) & TX_MASK;
+    }
+    txBusy = 1;
+}
+
+/*----------------------------------------------------
+  UARTRxDrain()
+
+  Moves every byte in the RX FIFO into the ring.
+----------------------------------------------------*/
+static void UARTRxDrain(void)
+{
+    u32 lsr, next;
+    u8 ch;
+
+    while ((lsr = U0LSR) & (1<<RDR_BIT))
+    {
+        if (lsr & (1<<OE_BIT))
+            rxDropped++;        // hardware FIFO overran
+        ch = U0RBR;
+        next = (rxHead + 1) & RX_MASK;
+        if (next == rxTail)
+            rxDropped++;        // reader too slow
+        else
+        {
+            rxBuf[rxHead] = ch;
+            rxHead = next;
+        }
+    }
+}
+
+/*----------------------------------------------------
+  UART0_ISR()
+
+  UART0 interrupt: empty the RX FIFO on RDA or
+  character timeout, refill the TX FIFO on THRE.
+  RX is reported first; a pending THRE keeps the
+  interrupt asserted and is served on re-entry.
+----------------------------------------------------*/
+void UART0_ISR(void) __irq
+{
+    switch (U0IIR & IIR_ID_MASK)    // reading IIR clears THRE
+    {
+        case IIR_RDA:
+        case IIR_CTI:
+            UARTRxDrain();
+            break;
+        case IIR_THRE:
+            UARTTxFill();
+            break;
+    }
+
+    VICVectAddr = 0;            // End of interrupt
+}
+
+/*----------------------------------------------------
+  UARTTxPut()
+
+  Queues one byte (UART0 interrupt already masked),
+  applying the overflow policy when the ring is full.
+  Returns 0 if the byte was dropped.
+----------------------------------------------------*/
+static u8 UARTTxPut(u8 ch)
+{
+    u32 next = (txHead + 1) & TX_MASK;
+
+    if (next == txTail)
+    {
+        if (txPolicy == UART_TX_DROP_NEWEST)
+        {
+            txDropped++;
+            return 0;
+        }
+        else if (txPolicy == UART_TX_DROP_OLDEST)
+        {
+            txTail = (txTail + 1) & TX_MASK;
+            txDropped++;
+        }
+        else
+        {
+            while (next == txTail)   // let the ISR drain some bytes
+            {
+                TX_UNLOCK();
+                TX_LOCK();
+            }
+        }
+    }
+    txBuf[txHead] = ch;
+    txHead = next;
+    return 1;
+}
 
 /*----------------------------------------------------
   InitUART()
@@ -18,16 +170,53 @@ void InitUART(void)
     // Configure P0.0 as TXD0 (UART0 Transmit)
     CfgPinFunc(0,0,1);
 
-    // If receiving needed:
-    // CfgPinFunc(0,1,1); // P0.1 as RXD0
+    // Configure P0.1 as RXD0 (commands from the PC)
+    CfgPinFunc(0,1,1);
 
     U0LCR = 0x03;      // 8-bit word length, 1 stop bit, no parity
-    U0LCR |= (1<<7);   // Set DLAB = 1 to access DLL & DLM registers
+    UARTSetBaud(UART_BAUD);
+
+    U0FCR = FCR_ENABLE | FCR_RX_RESET | FCR_TX_RESET;   // Enable & reset FIFOs
 
-    U0DLL = 97;        // Set baud rate (depends on PCLK)
-    U0DLM = 0;
+    // UART0 interrupt on a vectored IRQ slot
+    VICIntSelect &= ~(1<<UART0_VIC_CHNO);
+    VICVectAddr1 = (u32)UART0_ISR;
+    VICVectCntl1 = (1<<5) | UART0_VIC_CHNO;
+    VICIntEnable = (1<<UART0_VIC_CHNO);
+
+    rxHead = rxTail = 0;
+    U0IER = IER_RBR | IER_THRE;  // RX fills, THR empty drains the buffers
+}
+
+/*----------------------------------------------------
+  UARTRxGet()
+
+  Takes one received byte from the ring. Returns 0
+  if none is waiting (never blocks).
+----------------------------------------------------*/
+u8 UARTRxGet(u8 *ch)
+{
+    if (rxTail == rxHead)
+        return 0;
+    *ch = rxBuf[rxTail];
+    rxTail = (rxTail + 1) & RX_MASK;
+    return 1;
+}
+
+/*----------------------------------------------------
+  UARTRxAvail() / UARTRxDropped()
+
+  Bytes waiting in the ring, and bytes lost so far
+  (ring full or hardware overrun).
+----------------------------------------------------*/
+u32 UARTRxAvail(void)
+{
+    return (rxHead - rxTail) & RX_MASK;
+}
 
-    U0LCR &= ~(1<<7);  // Clear DLAB (normal operation mode)
+u32 UARTRxDropped(void)
+{
+    return rxDropped;
 }
 
 /*----------------------------------------------------
@@ -38,30 +227,158 @@ void InitUART(void)
 ----------------------------------------------------*/
 s8 UARTRxChar(void)
 {
-    while(!READBIT(U0LSR,0));   // Wait until RDR (Receiver Data Ready) bit = 1
-    return U0RBR;               // Return received byte
+    u8 ch;
+
+    while(!UARTRxGet(&ch));     // Filled by UART0_ISR
+    return ch;
 }
 
 /*----------------------------------------------------
   UARTTxChar()
 
-  Transmits one character via UART.
+  Queues one character for transmission.
+  Returns immediately unless the buffer is full and
+  the policy is UART_TX_BLOCK.
 ----------------------------------------------------*/
 void UARTTxChar(s8 ch)
 {
-    U0THR = ch;                 // Load character into transmit register
-    while(!READBIT(U0LSR,6));   // Wait until THR Empty (transmission complete)
+    TX_LOCK();
+    UARTTxPut(ch);
+    if (!txBusy)
+        UARTTxFill();           // transmitter idle: prime the FIFO
+    TX_UNLOCK();
+}
+
+/*----------------------------------------------------
+  UARTTxBuf()
+
+  Queues len bytes with a single lock/kick.
+----------------------------------------------------*/
+void UARTTxBuf(const u8 *buf, u32 len)
+{
+    TX_LOCK();
+    while (len--)
+        UARTTxPut(*buf++);
+    if (!txBusy)
+        UARTTxFill();
+    TX_UNLOCK();
 }
 
 /*----------------------------------------------------
   UARTTxStr()
 
-  Transmits a null-terminated string.
+  Queues a null-terminated string.
 ----------------------------------------------------*/
 void UARTTxStr(s8 *ptr)
 {
-    while(*ptr)                 // Loop until NULL character
-        UARTTxChar(*ptr++);     // Send character and move pointer
+    u32 len = 0;
+
+    while (ptr[len])            // Find NULL character
+        len++;
+    UARTTxBuf((const u8 *)ptr, len);
+}
+
+/*----------------------------------------------------
+  UARTTxSetPolicy()
+
+  Selects what happens when the TX buffer is full:
+  UART_TX_BLOCK, UART_TX_DROP_OLDEST or
+  UART_TX_DROP_NEWEST.
+----------------------------------------------------*/
+void UARTTxSetPolicy(u8 policy)
+{
+    txPolicy = policy;
+}
+
+/*----------------------------------------------------
+  UARTTxPending() / UARTTxDropped()
+
+  Bytes still queued in RAM, and bytes lost so far
+  to the overflow policy.
+----------------------------------------------------*/
+u32 UARTTxPending(void)
+{
+    return (txHead - txTail) & TX_MASK;
+}
+
+u32 UARTTxDropped(void)
+{
+    return txDropped;
+}
+
+/*----------------------------------------------------
+  UARTTxFlush()
+
+  Waits until every queued byte has left the shift
+  register.
+----------------------------------------------------*/
+void UARTTxFlush(void)
+{
+    while (!READBIT(U0LSR,TEMT_BIT) || txTail != txHead || txBusy);
+}
+
+/*----------------------------------------------------
+  UARTTxFree()
+
+  Bytes that can be queued without blocking or
+  dropping.
+----------------------------------------------------*/
+u32 UARTTxFree(void)
+{
+    return UART_TX_BUF_SIZE - 1 - UARTTxPending();
+}
+
+/*----------------------------------------------------
+  UARTTxIdle()
+
+  1 once everything queued has left the shift
+  register (safe moment to change the baud rate).
+----------------------------------------------------*/
+u8 UARTTxIdle(void)
+{
+    return READBIT(U0LSR,TEMT_BIT) && txTail == txHead && !txBusy;
+}
+
+/*----------------------------------------------------
+  UARTSetBaud()
+
+  Programs DLM:DLL and the fractional divider U0FDR
+  for the closest rate to baud. Every MULVAL 1..15 /
+  DIVADDVAL 0..MULVAL-1 pair is tried with its best
+  divisor (DL >= 3 when the fraction is used, as the
+  user manual requires). 115200 comes out at 0.06 %
+  where the integer divider alone is 1.7 % off.
+  Returns the rate actually set.
+----------------------------------------------------*/
+u32 UARTSetBaud(u32 baud)
+{
+    u32 mul, add, dl, rate, err;
+    u32 bestDl = 1, bestFdr = 0x10, bestRate = 0, bestErr = 0xFFFFFFFF;
+
+    for(mul = 1; mul <= 15; mul++)
+        for(add = 0; add < mul; add++)
+        {
+            // DL = PCLK * mul / (16 * baud * (mul + add)), rounded
+            dl = (UART_PCLK_HZ * mul + 8 * baud * (mul + add)) / (16 * baud * (mul + add));
+            if(dl < 1 || dl > 0xFFFF || (add && dl < 3))
+                continue;
+            rate = UART_PCLK_HZ * mul / (16 * dl * (mul + add));
+            err = (rate > baud) ? rate - baud : baud - rate;
+            if(err < bestErr)
+            {
+                bestErr = err;
+                bestRate = rate;
+                bestDl = dl;
+                bestFdr = (mul << 4) | add;
+            }
+        }
+
+    U0LCR |= LCR_DLAB;          // Set DLAB = 1 to access DLL & DLM registers
+    U0DLL = bestDl & 0xFF;
+    U0DLM = bestDl >> 8;
+    U0LCR &= ~LCR_DLAB;         // Clear DLAB (normal operation mode)
+    U0FDR = bestFdr;
+    return bestRate;
 }
 
 /*----------------------------------------------------
@@ -72,24 +389,22 @@ void UARTTxStr(s8 *ptr)
 ----------------------------------------------------*/
 void UARTTxU32(u32 num)
 {
-    u8 a[10];   // Temporary array to store digits
-    s8 i = 0;
+    u8 a[10];
 
-    if(num == 0)
-        UARTTxChar('0');
-    else
-    {
-        // Extract digits in reverse order
-        while(num > 0)
-        {
-            a[i++] = (num % 10) + 48;  // Convert digit to ASCII
-            num = num / 10;
-        }
+    UARTTxBuf(a, FmtU32(a, num) - a);
+}
 
-        // Send digits in correct order
-        for(--i; i >= 0; i--)
-            UARTTxChar(a[i]);
-    }
+/*----------------------------------------------------
+  UARTTxDeci()
+
+  Transmits a value in tenths as a signed decimal
+  with one fraction digit (305 -> "30.5").
+----------------------------------------------------*/
+void UARTTxDeci(s32 deci)
+{
+    u8 a[13];
+
+    UARTTxBuf(a, FmtDeci(a, deci) - a);
 }
 
 /*----------------------------------------------------
@@ -100,24 +415,7 @@ void UARTTxU32(u32 num)
 ----------------------------------------------------*/
 void UARTTxF32(f32 fnum)
 {
-    u32 num, i;
-
-    // Handle negative numbers
-    if(fnum < 0)
-    {
-        UARTTxChar('-');
-        fnum = -fnum;
-    }
-
-    num = fnum;          // Extract integer part
-    UARTTxU32(num);      // Send integer part
-    UARTTxChar('.');     // Decimal point
+    u8 a[18];
 
-    // Send 6 digits after decimal
-    for(i = 0; i < 6; i++)
-    {
-        fnum = (fnum - num) * 10;
-        num = fnum;
-        UARTTxChar(num + 48);
-    }
+    UARTTxBuf(a, FmtF32(a, fnum) - a);
 }
\ No newline at end of file
@@ -1,7 +1,27 @@
 #include"types.h"
+
+// TX ring buffer overflow policy
+#define UART_TX_BLOCK       0   // wait for the ISR to make room
+#define UART_TX_DROP_OLDEST 1   // overwrite the oldest queued byte
+#define UART_TX_DROP_NEWEST 2   // discard the byte being queued
+
 void InitUART(void);
 void UARTTxChar(s8);
 void UARTTxStr(s8 *);
+void UARTTxBuf(const u8 *, u32);
 s8 UARTRxChar(void);
+u8 UARTRxGet(u8 *);
+u32 UARTRxAvail(void);
+u32 UARTRxDropped(void);
 void UARTTxU32(u32);
+void UARTTxDeci(s32);
 void UARTTxF32(f32);
+
+void UARTTxSetPolicy(u8);
+u32 UARTTxPending(void);
+u32 UARTTxDropped(void);
+void UARTTxFlush(void);
+u32 UARTTxFree(void);
+
+u32 UARTSetBaud(u32);
+u8 UARTTxIdle(void);
@@ -0,0 +1,45 @@
+#ifndef UART_DEFINES_H
+#define UART_DEFINES_H
+
+// UART0 register bits
+#define RDR_BIT       0      // U0LSR: receive data ready
+#define OE_BIT        1      // U0LSR: overrun error
+#define TEMT_BIT      6      // U0LSR: transmitter empty
+
+#define IER_RBR       (1<<0) // U0IER: receive data available interrupt
+#define IER_THRE      (1<<1) // U0IER: THR empty interrupt
+
+#define FCR_ENABLE    (1<<0) // U0FCR: enable FIFOs
+#define FCR_RX_RESET  (1<<1)
+#define FCR_TX_RESET  (1<<2)
+
+#define IIR_ID_MASK   0x0E   // U0IIR: interrupt identification
+#define IIR_THRE      0x02
+#define IIR_RDA       0x04
+#define IIR_CTI       0x0C
+
+#define UART_TX_FIFO  16     // hardware TX FIFO depth
+
+#define LCR_DLAB      (1<<7) // U0LCR: divisor latch access
+
+// Baud rate: PCLK / (16 * DL * (1 + DIVADDVAL / MULVAL))
+#define UART_PCLK_HZ  15000000   // CCLK 60 MHz, VPB divider 4
+#ifndef UART_BAUD
+#define UART_BAUD     9600
+#endif
+
+// VIC assignment
+#define UART0_VIC_CHNO 6     // UART0 interrupt source number
+#define UART0_VIC_SLOT 1     // vectored slot (priority)
+
+// Software TX ring buffer (power of 2)
+#ifndef UART_TX_BUF_SIZE
+#define UART_TX_BUF_SIZE 256
+#endif
+
+// Software RX ring buffer (power of 2)
+#ifndef UART_RX_BUF_SIZE
+#define UART_RX_BUF_SIZE 64
+#endif
+
+#endif